@@ -0,0 +1,88 @@
+#include "AverageBackgroundModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "SimdBytes.h"
+
+namespace {
+constexpr int kAverageFraction = 7;     // fractional bits of the average
+constexpr int kMinDifference = 12 * 4;  // quarter levels
+constexpr int kInitialDeviation = 4 * 4;
+constexpr int kForegroundSlowdown = 3;  // foreground learns 2^3 times slower
+constexpr int kMaxRateShift = 13;       // 13 + 3 still fits 16 bits
+
+// diff / 2^shift rounded to nearest, but at least one unit towards the
+// frame while they differ. A plain shift rounds down, so the average
+// stalled up to 2^shift units below a brighter frame (16 levels for
+// foreground at the default rate) and drifted dark. Shifting by one less
+// first keeps the rounding in 16 bits.
+template <typename V>
+V scaledStep(V diff, int shift) {
+    V rounded = ((diff >> (shift - 1)) + V::set(1)) >> 1;
+    V one = V::set(1);
+    V minusOne = V::set(-1);
+    return rounded + simd::min(simd::max(diff, minusOne), one) - simd::min(simd::max(rounded, minusOne), one);
+}
+} // namespace
+
+void AverageBackgroundModel::setLearningRate(float rate) {
+    if (rate <= 0.0f) {
+        rate = kDefaultLearningRate;
+    }
+    int shift = static_cast<int>(std::lround(-std::log2(rate)));
+    rateShift = std::min(std::max(shift, 1), kMaxRateShift);
+}
+
+void AverageBackgroundModel::apply(const cv::Mat &rgb, cv::Mat &mask, bool learn) {
+    int samples = rgb.cols * 3;
+    if (rgb.size() != size) {
+        size = rgb.size();
+        average.resize(static_cast<size_t>(samples) * rgb.rows);
+        deviation.assign(average.size(), kInitialDeviation);
+        for (int y = 0; y < rgb.rows; ++y) {
+            const uint8_t *pixels = rgb.ptr<uint8_t>(y);
+            int16_t *row = average.data() + static_cast<size_t>(y) * samples;
+            for (int i = 0; i < samples; ++i) {
+                row[i] = static_cast<int16_t>(pixels[i] << kAverageFraction);
+            }
+        }
+    }
+    flags.resize(static_cast<size_t>(samples));
+
+    int fastShift = rateShift;
+    int slowShift = rateShift + kForegroundSlowdown;
+    for (int y = 0; y < rgb.rows; ++y) {
+        const uint8_t *pixels = rgb.ptr<uint8_t>(y);
+        int16_t *averageRow = average.data() + static_cast<size_t>(y) * samples;
+        uint8_t *deviationRow = deviation.data() + static_cast<size_t>(y) * samples;
+        uint8_t *flagRow = flags.data();
+        simd::forEachShort(0, samples, [&](auto lanes, int i) {
+            using V = decltype(lanes);
+            V mean = V::load(averageRow + i);
+            V diff = (V::widen(pixels + i) << kAverageFraction) - mean;
+            V distance = simd::abs(diff) >> (kAverageFraction - 2); // quarter levels
+            V spread = V::widen(deviationRow + i);
+            V limit = simd::max(V::set(kMinDifference), spread + spread + spread);
+            V foreground = simd::min(simd::max(distance - limit, V::set(0)), V::set(1));
+            ((foreground << 8) - foreground).narrow(flagRow + i);
+            if (!learn) {
+                return;
+            }
+
+            // All bits set in background lanes.
+            V background = foreground - V::set(1);
+            V fast = scaledStep(diff, fastShift);
+            V slow = scaledStep(diff, slowShift);
+            (mean + slow + ((fast - slow) & background)).store(averageRow + i);
+            // The median moves one step towards the distance.
+            V step = simd::min(simd::max(simd::min(distance, V::set(255)) - spread, V::set(-1)), V::set(1));
+            (spread + (step & background)).narrow(deviationRow + i);
+        });
+
+        uint8_t *dst = mask.ptr<uint8_t>(y);
+        for (int x = 0; x < rgb.cols; ++x) {
+            dst[x] = flagRow[x * 3] | flagRow[x * 3 + 1] | flagRow[x * 3 + 2];
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Background model for a fixed camera under steady light, much cheaper than
+// MOG2's per-pixel Gaussian mixtures. Each colour sample keeps a running
+// average of the background (16-bit, 7 fractional bits) and a running
+// median of its absolute deviation (8-bit, quarter levels), as two planes
+// in frame order updated with SimdBytes.h vectors. A sample is foreground
+// when it is more than three deviations (and at least 12 levels) from the
+// average, and a pixel when any of its channels is. Background samples move
+// towards the frame at the learning rate, foreground ones eight times
+// slower, so someone standing still fades in gradually. There is no shadow
+// detection.
+class AverageBackgroundModel {
+public:
+    static constexpr float kDefaultLearningRate = 1.0f / 256.0f;
+
+    // Rounded to a power of two between 1/2 and 1/8192; 0 = the default.
+    void setLearningRate(float rate);
+    float getLearningRate() const { return 1.0f / static_cast<float>(1 << rateShift); }
+    void reset() { size = cv::Size(); }
+
+    // rgb is 8-bit, 3 channels; mask is 8-bit of the same size and gets 255
+    // for foreground and 0 for background. The first frame (and any size
+    // change) restarts the model from it. With learn false the background
+    // stays as it is.
+    void apply(const cv::Mat &rgb, cv::Mat &mask, bool learn);
+
+private:
+    int rateShift = 8;
+    cv::Size size;
+    std::vector<int16_t> average;
+    std::vector<uint8_t> deviation;
+    std::vector<uint8_t> flags; // per-sample foreground of the current row
+};
@@ -0,0 +1,460 @@
+#include "BackgroundSegmenter.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#include "SimdBytes.h"
+
+namespace {
+// How far the refine reads around a pixel: erode 1 + dilate 2 + median 2.
+constexpr int kRefineRadius = 5;
+// A 5x5 median of a 0/1 mask is set when at least 13 of the 25 are.
+constexpr int kMedianMajority = 13;
+// Colour distance (sum over RGB) at which an upsampling tap's weight falls
+// to 0.6 of a perfect match.
+constexpr float kGuideSigma = 30.0f;
+constexpr int kUpsampleRowGrain = 16;
+
+struct MinOp {
+    template <typename V>
+    V operator()(V a, V b) const { return simd::min(a, b); }
+};
+struct MaxOp {
+    template <typename V>
+    V operator()(V a, V b) const { return simd::max(a, b); }
+};
+
+// Min/max over [x - R, x + R] of each row, skipping pixels outside the
+// image (OpenCV's default border for erode/dilate).
+template <int R, typename Op>
+void horizontalExtreme(const uint8_t *src, uint8_t *dst, int w, int h, Op op) {
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *s = src + static_cast<size_t>(y) * w;
+        uint8_t *d = dst + static_cast<size_t>(y) * w;
+        auto clipped = [&](int x) {
+            simd::Byte v = simd::Byte::load(s + x);
+            for (int i = std::max(0, x - R); i <= std::min(w - 1, x + R); ++i) {
+                v = op(v, simd::Byte::load(s + i));
+            }
+            v.store(d + x);
+        };
+        int edge = std::min(R, w);
+        for (int x = 0; x < edge; ++x) {
+            clipped(x);
+        }
+        simd::forEachByte(R, w - R, [&](auto lanes, int x) {
+            using V = decltype(lanes);
+            V v = V::load(s + x - R);
+            for (int i = 1 - R; i <= R; ++i) {
+                v = op(v, V::load(s + x + i));
+            }
+            v.store(d + x);
+        });
+        for (int x = std::max(edge, w - R); x < w; ++x) {
+            clipped(x);
+        }
+    }
+}
+
+// Same over [y - R, y + R] of each column.
+template <int R, typename Op>
+void verticalExtreme(const uint8_t *src, uint8_t *dst, int w, int h, Op op) {
+    for (int y = 0; y < h; ++y) {
+        int y0 = std::max(0, y - R);
+        int y1 = std::min(h - 1, y + R);
+        uint8_t *d = dst + static_cast<size_t>(y) * w;
+        simd::forEachByte(0, w, [&](auto lanes, int x) {
+            using V = decltype(lanes);
+            V v = V::load(src + static_cast<size_t>(y0) * w + x);
+            for (int yy = y0 + 1; yy <= y1; ++yy) {
+                v = op(v, V::load(src + static_cast<size_t>(yy) * w + x));
+            }
+            v.store(d + x);
+        });
+    }
+}
+
+// Sum over [x - 2, x + 2] of each row, repeating the edge pixels
+// (medianBlur's border).
+void horizontalSum5(const uint8_t *src, uint8_t *dst, int w, int h) {
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *s = src + static_cast<size_t>(y) * w;
+        uint8_t *d = dst + static_cast<size_t>(y) * w;
+        auto clipped = [&](int x) {
+            int sum = 0;
+            for (int i = x - 2; i <= x + 2; ++i) {
+                sum += s[std::min(std::max(i, 0), w - 1)];
+            }
+            d[x] = static_cast<uint8_t>(sum);
+        };
+        int edge = std::min(2, w);
+        for (int x = 0; x < edge; ++x) {
+            clipped(x);
+        }
+        simd::forEachByte(2, w - 2, [&](auto lanes, int x) {
+            using V = decltype(lanes);
+            V sum = V::load(s + x - 2) + V::load(s + x - 1) + V::load(s + x) + V::load(s + x + 1) + V::load(s + x + 2);
+            sum.store(d + x);
+        });
+        for (int x = std::max(edge, w - 2); x < w; ++x) {
+            clipped(x);
+        }
+    }
+}
+
+// Upsampling weight (1-256) per colour distance.
+const std::array<int, 3 * 255 + 1> &guideWeights() {
+    static const std::array<int, 3 * 255 + 1> weights = [] {
+        std::array<int, 3 * 255 + 1> table{};
+        for (size_t d = 0; d < table.size(); ++d) {
+            float x = static_cast<float>(d) / kGuideSigma;
+            table[d] = std::max(1, static_cast<int>(std::lround(256.0f * std::exp(-0.5f * x * x))));
+        }
+        return table;
+    }();
+    return weights;
+}
+
+// Bilinear taps from fullSize pixel centres onto modelSize ones.
+void computeTaps(int fullSize, int modelSize, std::vector<int> &index, std::vector<int> &weight) {
+    index.resize(static_cast<size_t>(fullSize));
+    weight.resize(static_cast<size_t>(fullSize));
+    float ratio = static_cast<float>(modelSize) / static_cast<float>(fullSize);
+    for (int i = 0; i < fullSize; ++i) {
+        float position = ofClamp((i + 0.5f) * ratio - 0.5f, 0.0f, static_cast<float>(modelSize - 1));
+        int first = static_cast<int>(position);
+        index[static_cast<size_t>(i)] = first;
+        weight[static_cast<size_t>(i)] = static_cast<int>(std::lround((position - first) * 256.0f));
+    }
+}
+} // namespace
+
+BackgroundSegmenter::BackgroundSegmenter(WorkerPool *pool)
+: pool(pool) {}
+
+void BackgroundSegmenter::setTileGrid(int columns, int rows) {
+    gridColumns = std::max(1, columns);
+    gridRows = std::max(1, rows);
+}
+
+void BackgroundSegmenter::setModelScale(int scale) {
+    scale = std::max(1, scale);
+    if (scale != modelScale) {
+        modelScale = scale;
+        tiles.clear();
+        frameSize = cv::Size();
+    }
+}
+
+void BackgroundSegmenter::setModelType(BackgroundModelType type) {
+    if (type != modelType) {
+        modelType = type;
+        tiles.clear();
+        frameSize = cv::Size();
+    }
+}
+
+void BackgroundSegmenter::setLearningRate(float rate) {
+    learningRate = std::max(0.0f, std::min(rate, 1.0f));
+    for (auto &tile : tiles) {
+        tile.average.setLearningRate(learningRate);
+    }
+}
+
+void BackgroundSegmenter::reset(const BackgroundMaskSettings &settings) {
+    detectShadows = settings.detectShadows;
+    tiles.clear();
+    frameSize = cv::Size();
+}
+
+void BackgroundSegmenter::buildTiles(int width, int height) {
+    tiles.clear();
+    frameSize = cv::Size(width, height);
+    int columns = std::min(gridColumns, width);
+    int rows = std::min(gridRows, height);
+    cv::Rect frame(0, 0, width, height);
+    for (int row = 0; row < rows; ++row) {
+        int y0 = height * row / rows;
+        int y1 = height * (row + 1) / rows;
+        for (int column = 0; column < columns; ++column) {
+            int x0 = width * column / columns;
+            int x1 = width * (column + 1) / columns;
+            Tile tile;
+            tile.core = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+            tile.halo = cv::Rect(x0 - kRefineRadius, y0 - kRefineRadius,
+                                 tile.core.width + 2 * kRefineRadius,
+                                 tile.core.height + 2 * kRefineRadius) & frame;
+            if (modelType == BackgroundModelType::Mog2) {
+                tile.mog2 = cv::createBackgroundSubtractorMOG2();
+                tile.mog2->setDetectShadows(detectShadows);
+            }
+            tile.average.setLearningRate(learningRate);
+            tiles.push_back(std::move(tile));
+        }
+    }
+}
+
+bool BackgroundSegmenter::apply(const cv::Mat &rgb, const BackgroundMaskSettings &settings, cv::Mat &mask) {
+    if (rgb.empty()) {
+        return false;
+    }
+    lastDownscaleMicros = 0;
+    lastUpsampleMicros = 0;
+    if (modelScale == 1) {
+        segment(rgb, settings, mask);
+        return true;
+    }
+
+    uint64_t start = ofGetElapsedTimeMicros();
+    cv::Size modelSize(std::max(1, rgb.cols / modelScale), std::max(1, rgb.rows / modelScale));
+    cv::resize(rgb, smallRgb, modelSize, 0, 0, cv::INTER_AREA);
+    lastDownscaleMicros = ofGetElapsedTimeMicros() - start;
+
+    segment(smallRgb, settings, smallMask);
+
+    start = ofGetElapsedTimeMicros();
+    upsample(rgb, mask);
+    lastUpsampleMicros = ofGetElapsedTimeMicros() - start;
+    return true;
+}
+
+void BackgroundSegmenter::segment(const cv::Mat &rgb, const BackgroundMaskSettings &settings, cv::Mat &mask) {
+    if (tiles.empty() || rgb.size() != frameSize) {
+        buildTiles(rgb.cols, rgb.rows);
+    }
+    raw.create(rgb.size(), CV_8UC1);
+    mask.create(rgb.size(), CV_8UC1);
+
+    int count = static_cast<int>(tiles.size());
+    auto forEachTile = [&](const std::function<void(int, int)> &fn) {
+        if (pool) {
+            pool->parallelFor(count, 1, fn);
+        } else {
+            fn(0, count);
+        }
+    };
+
+    // MOG2 takes -1 for its automatic rate.
+    double mog2Rate = frozen ? 0.0 : learningRate > 0.0f ? learningRate : -1.0;
+    uint64_t start = ofGetElapsedTimeMicros();
+    forEachTile([&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            Tile &tile = tiles[static_cast<size_t>(i)];
+            cv::Mat tileMask = raw(tile.core);
+            if (tile.mog2) {
+                tile.mog2->apply(rgb(tile.core), tileMask, mog2Rate);
+            } else {
+                tile.average.apply(rgb(tile.core), tileMask, !frozen);
+            }
+        }
+    });
+    // The refine reads across tile edges, so it waits for every model.
+    uint64_t modelled = ofGetElapsedTimeMicros();
+    forEachTile([&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            refineTile(tiles[static_cast<size_t>(i)], settings, mask);
+        }
+    });
+    lastModelMicros = modelled - start;
+    lastRefineMicros = ofGetElapsedTimeMicros() - modelled;
+}
+
+void BackgroundSegmenter::refineTile(Tile &tile, const BackgroundMaskSettings &settings, cv::Mat &mask) {
+    // Works on 0/1 values over the halo. Pixels within kRefineRadius of a
+    // halo edge inside the frame come out wrong, but those belong to other
+    // tiles and are never written.
+    const cv::Rect &halo = tile.halo;
+    int w = halo.width;
+    int h = halo.height;
+    size_t size = static_cast<size_t>(w) * h;
+    tile.scratchA.resize(size);
+    tile.scratchB.resize(size);
+    uint8_t *a = tile.scratchA.data();
+    uint8_t *b = tile.scratchB.data();
+
+    // 0/1 for raw > threshold.
+    uint8_t threshold = static_cast<uint8_t>(std::min(std::max(settings.threshold, 0), 255));
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *src = raw.ptr<uint8_t>(halo.y + y) + halo.x;
+        uint8_t *dst = a + static_cast<size_t>(y) * w;
+        simd::forEachByte(0, w, [&](auto lanes, int x) {
+            using V = decltype(lanes);
+            simd::min(simd::subSaturate(V::load(src + x), V::set(threshold)), V::set(1)).store(dst + x);
+        });
+    }
+
+    if (settings.morph) {
+        horizontalExtreme<1>(a, b, w, h, MinOp());
+        verticalExtreme<1>(b, a, w, h, MinOp());
+        // Two 3x3 dilations are one 5x5.
+        horizontalExtreme<2>(a, b, w, h, MaxOp());
+        verticalExtreme<2>(b, a, w, h, MaxOp());
+    }
+
+    const cv::Rect &core = tile.core;
+    int offsetX = core.x - halo.x;
+    int offsetY = core.y - halo.y;
+    if (!settings.blur) {
+        for (int y = 0; y < core.height; ++y) {
+            const uint8_t *src = a + static_cast<size_t>(offsetY + y) * w + offsetX;
+            uint8_t *dst = mask.ptr<uint8_t>(core.y + y) + core.x;
+            simd::forEachByte(0, core.width, [&](auto lanes, int x) {
+                using V = decltype(lanes);
+                (V::set(0) - V::load(src + x)).store(dst + x);
+            });
+        }
+        return;
+    }
+
+    // The median of a 0/255 mask is 0 or 255, which the second threshold
+    // keeps as is (a threshold of 255 already cleared everything).
+    horizontalSum5(a, b, w, h);
+    for (int y = 0; y < core.height; ++y) {
+        int ly = offsetY + y;
+        const uint8_t *rows[5];
+        for (int i = 0; i < 5; ++i) {
+            int sy = std::min(std::max(ly + i - 2, 0), h - 1);
+            rows[i] = b + static_cast<size_t>(sy) * w + offsetX;
+        }
+        uint8_t *dst = mask.ptr<uint8_t>(core.y + y) + core.x;
+        simd::forEachByte(0, core.width, [&](auto lanes, int x) {
+            using V = decltype(lanes);
+            V sum = V::load(rows[0] + x) + V::load(rows[1] + x) + V::load(rows[2] + x) +
+                    V::load(rows[3] + x) + V::load(rows[4] + x);
+            V set = simd::min(simd::subSaturate(sum, V::set(kMedianMajority - 1)), V::set(1));
+            (V::set(0) - set).store(dst + x);
+        });
+    }
+}
+
+void BackgroundSegmenter::upsample(const cv::Mat &rgb, cv::Mat &mask) {
+    mask.create(rgb.size(), CV_8UC1);
+    computeTaps(rgb.cols, smallRgb.cols, columnIndex, columnWeight);
+    computeTaps(rgb.rows, smallRgb.rows, rowIndex, rowWeight);
+    columnBegin.assign(static_cast<size_t>(smallRgb.cols), 0);
+    columnEnd.assign(static_cast<size_t>(smallRgb.cols), 0);
+    for (int x = rgb.cols - 1; x >= 0; --x) {
+        size_t column = static_cast<size_t>(columnIndex[static_cast<size_t>(x)]);
+        columnBegin[column] = x;
+        columnEnd[column] = std::max(columnEnd[column], x + 1);
+    }
+    const auto &guide = guideWeights();
+    int lastColumn = smallRgb.cols - 1;
+    int lastRow = smallRgb.rows - 1;
+
+    auto rows = [&](int y0, int y1) {
+        // Both depend only on the first model row, which several full-res
+        // rows share.
+        std::vector<uint8_t> nearest(static_cast<size_t>(rgb.cols));
+        std::vector<uint8_t> edges(static_cast<size_t>(smallRgb.cols) + 8, 0); // padded for the 8-byte scan
+        int cachedRow = -1;
+        for (int y = y0; y < y1; ++y) {
+            int row0 = rowIndex[static_cast<size_t>(y)];
+            int row1 = std::min(row0 + 1, lastRow);
+            int fy = rowWeight[static_cast<size_t>(y)];
+            const uint8_t *mask0 = smallMask.ptr<uint8_t>(row0);
+            const uint8_t *mask1 = smallMask.ptr<uint8_t>(row1);
+            if (row0 != cachedRow) {
+                cachedRow = row0;
+                // The nearest model pixel is the answer wherever the four
+                // taps agree: away from mask edges, most of the frame.
+                for (int x = 0; x < rgb.cols; ++x) {
+                    nearest[static_cast<size_t>(x)] = mask0[columnIndex[static_cast<size_t>(x)]];
+                }
+                // Non-zero where they don't.
+                uint8_t *edge = edges.data();
+                simd::forEachByte(0, lastColumn, [&](auto lanes, int c) {
+                    using V = decltype(lanes);
+                    V a0 = V::load(mask0 + c);
+                    V a1 = V::load(mask0 + c + 1);
+                    V b0 = V::load(mask1 + c);
+                    V b1 = V::load(mask1 + c + 1);
+                    V high = simd::max(simd::max(a0, a1), simd::max(b0, b1));
+                    V low = simd::min(simd::min(a0, a1), simd::min(b0, b1));
+                    (high - low).store(edge + c);
+                });
+                edge[lastColumn] = static_cast<uint8_t>(mask0[lastColumn] != mask1[lastColumn]);
+            }
+
+            const uint8_t *guide0 = smallRgb.ptr<uint8_t>(row0);
+            const uint8_t *guide1 = smallRgb.ptr<uint8_t>(row1);
+            const uint8_t *pixels = rgb.ptr<uint8_t>(y);
+            uint8_t *dst = mask.ptr<uint8_t>(y);
+            std::memcpy(dst, nearest.data(), nearest.size());
+            for (int column0 = 0; column0 <= lastColumn; ++column0) {
+                if ((column0 & 7) == 0) {
+                    uint64_t chunk;
+                    std::memcpy(&chunk, edges.data() + column0, sizeof(chunk));
+                    if (chunk == 0) {
+                        column0 += 7;
+                        continue;
+                    }
+                }
+                if (edges[static_cast<size_t>(column0)] == 0) {
+                    continue;
+                }
+
+                int column1 = std::min(column0 + 1, lastColumn);
+                uint8_t m00 = mask0[column0];
+                uint8_t m01 = mask0[column1];
+                uint8_t m10 = mask1[column0];
+                uint8_t m11 = mask1[column1];
+                const uint8_t *q00 = guide0 + column0 * 3;
+                const uint8_t *q01 = guide0 + column1 * 3;
+                const uint8_t *q10 = guide1 + column0 * 3;
+                const uint8_t *q11 = guide1 + column1 * 3;
+                int end = columnEnd[static_cast<size_t>(column0)];
+                for (int x = columnBegin[static_cast<size_t>(column0)]; x < end; ++x) {
+                    const uint8_t *p = pixels + x * 3;
+                    auto weight = [&](const uint8_t *q, int spatial) {
+                        int distance = std::abs(p[0] - q[0]) + std::abs(p[1] - q[1]) + std::abs(p[2] - q[2]);
+                        return spatial * guide[static_cast<size_t>(distance)];
+                    };
+                    int fx = columnWeight[static_cast<size_t>(x)];
+                    int w00 = weight(q00, (256 - fx) * (256 - fy));
+                    int w01 = weight(q01, fx * (256 - fy));
+                    int w10 = weight(q10, (256 - fx) * fy);
+                    int w11 = weight(q11, fx * fy);
+                    int total = w00 + w01 + w10 + w11;
+                    int foreground = (m00 ? w00 : 0) + (m01 ? w01 : 0) + (m10 ? w10 : 0) + (m11 ? w11 : 0);
+                    dst[x] = 2 * foreground > total ? 255 : 0;
+                }
+            }
+        }
+    };
+    if (pool) {
+        pool->parallelFor(rgb.rows, kUpsampleRowGrain, rows);
+    } else {
+        rows(0, rgb.rows);
+    }
+}
+
+const char *describeBackgroundModel(BackgroundModelType type) {
+    switch (type) {
+    case BackgroundModelType::Mog2:
+        return "mog2";
+    case BackgroundModelType::Average:
+        return "average";
+    }
+    return "?";
+}
+
+void refineBackgroundMaskReference(cv::Mat &mask, const BackgroundMaskSettings &settings) {
+    cv::threshold(mask, mask, settings.threshold, 255, cv::THRESH_BINARY);
+
+    if (settings.morph) {
+        cv::erode(mask, mask, cv::Mat(), cv::Point(-1, -1), 1);
+        cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+    }
+
+    if (settings.blur) {
+        cv::medianBlur(mask, mask, 5);
+        cv::threshold(mask, mask, settings.threshold, 255, cv::THRESH_BINARY);
+    }
+}
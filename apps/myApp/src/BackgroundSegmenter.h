@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/video/background_segm.hpp>
+
+#include <vector>
+
+#include "AverageBackgroundModel.h"
+#include "WorkerPool.h"
+
+// Clean-up applied to the raw background model output (the bg-sub keys).
+struct BackgroundMaskSettings {
+    int threshold = 200;       // model values above this are foreground
+    bool morph = true;         // erode 3x3, then dilate 3x3 twice
+    bool blur = true;          // 5x5 median, then the threshold again
+    bool detectShadows = true; // takes effect on reset()
+};
+
+enum class BackgroundModelType {
+    Mog2,    // OpenCV's Gaussian mixtures; copes with changing light, detects shadows
+    Average, // AverageBackgroundModel; for a fixed camera and steady light
+};
+
+// Foreground mask for the bg-sub composite. The frame is cut into a grid of
+// tiles, each with its own background model; both models are per pixel, so
+// this gives the same result as one full-frame model. Once every tile has
+// been modelled, each tile's mask is cleaned up in one task that reads a
+// halo of neighbouring pixels and runs threshold, morphology and median on
+// a cache-sized scratch copy, writing only its own pixels. Both steps run
+// on the worker pool.
+//
+// With a model scale of n > 1 all of that runs on the frame shrunk n times,
+// and the mask is brought back to full size by joint bilateral upsampling:
+// each full-res pixel weighs its four nearest model pixels by distance and
+// by how close their (shrunk) colour is to its own, so mask edges snap to
+// edges in the full-res frame instead of coming out blocky.
+class BackgroundSegmenter {
+public:
+    // A null pool runs on the calling thread only.
+    explicit BackgroundSegmenter(WorkerPool *pool = &WorkerPool::shared());
+
+    void setPool(WorkerPool *newPool) { pool = newPool; }
+    // Takes effect on the next reset() or frame size change.
+    void setTileGrid(int columns, int rows);
+    // Model at 1/scale of the frame size (1, 2 or 4). Changing it drops the
+    // learned background.
+    void setModelScale(int scale);
+    int getModelScale() const { return modelScale; }
+    // Changing the type drops the learned background.
+    void setModelType(BackgroundModelType type);
+    BackgroundModelType getModelType() const { return modelType; }
+    // Fraction of the background replaced per frame; 0 = the model's
+    // default (MOG2 picks it from its history length).
+    void setLearningRate(float rate);
+    float getLearningRate() const { return learningRate; }
+    // A frozen model keeps the background it has learned so far.
+    void setFrozen(bool frozen) { this->frozen = frozen; }
+    bool isFrozen() const { return frozen; }
+    // Drops the learned background.
+    void reset(const BackgroundMaskSettings &settings);
+
+    // Updates the model with rgb (8-bit, 3 channels) and writes the cleaned
+    // 0/255 mask. Returns false if the frame is empty.
+    bool apply(const cv::Mat &rgb, const BackgroundMaskSettings &settings, cv::Mat &mask);
+
+    int getTileCount() const { return static_cast<int>(tiles.size()); }
+    // Wall time of the last apply() per step, in microseconds; downscale
+    // and upsample are 0 at model scale 1.
+    uint64_t getLastDownscaleMicros() const { return lastDownscaleMicros; }
+    uint64_t getLastModelMicros() const { return lastModelMicros; }
+    uint64_t getLastRefineMicros() const { return lastRefineMicros; }
+    uint64_t getLastUpsampleMicros() const { return lastUpsampleMicros; }
+
+private:
+    struct Tile {
+        cv::Rect core;
+        cv::Rect halo; // core grown by the refine radius, clipped to the frame
+        cv::Ptr<cv::BackgroundSubtractorMOG2> mog2; // null for the other types
+        AverageBackgroundModel average;
+        std::vector<uint8_t> scratchA;
+        std::vector<uint8_t> scratchB;
+    };
+
+    void buildTiles(int width, int height);
+    void segment(const cv::Mat &rgb, const BackgroundMaskSettings &settings, cv::Mat &mask);
+    void refineTile(Tile &tile, const BackgroundMaskSettings &settings, cv::Mat &mask);
+    void upsample(const cv::Mat &rgb, cv::Mat &mask);
+
+    WorkerPool *pool = nullptr;
+    int gridColumns = 4;
+    int gridRows = 4;
+    int modelScale = 1;
+    BackgroundModelType modelType = BackgroundModelType::Mog2;
+    float learningRate = 0.0f;
+    bool frozen = false;
+    bool detectShadows = true;
+    std::vector<Tile> tiles;
+    cv::Size frameSize;
+    cv::Mat raw;
+    cv::Mat smallRgb;
+    cv::Mat smallMask;
+    // Per full-res column/row: first model pixel and the weight (0-256) of
+    // the one after it.
+    std::vector<int> columnIndex;
+    std::vector<int> columnWeight;
+    // Per model column: the full-res columns whose first tap it is.
+    std::vector<int> columnBegin;
+    std::vector<int> columnEnd;
+    std::vector<int> rowIndex;
+    std::vector<int> rowWeight;
+    uint64_t lastDownscaleMicros = 0;
+    uint64_t lastModelMicros = 0;
+    uint64_t lastRefineMicros = 0;
+    uint64_t lastUpsampleMicros = 0;
+};
+
+const char *describeBackgroundModel(BackgroundModelType type);
+
+// The serial OpenCV clean-up the tiled refine replaces, in place; the
+// baseline for --bench bgsub.
+void refineBackgroundMaskReference(cv::Mat &mask, const BackgroundMaskSettings &settings);
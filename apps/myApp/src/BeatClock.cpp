@@ -0,0 +1,114 @@
+#include "BeatClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Loop gains per tick: the share of the phase error corrected at once, and
+// the share of the rate that would cancel it over one tick taken into the
+// tempo. Together they settle in about two beats without ringing and
+// average jitter over roughly ten ticks.
+constexpr double kPhaseGain = 0.1;
+constexpr double kRateGain = 0.005;
+// Ticks used to measure the tempo directly before the loop takes over.
+constexpr int kBootstrapTicks = 24;
+// A phase error past this means the sender jumped; re-anchor instead.
+constexpr double kMaxErrorBeats = 0.5;
+// No tick for this long and the clock counts as gone.
+constexpr double kClockTimeoutSeconds = 0.5;
+constexpr double kMinBpm = 20.0;
+constexpr double kMaxBpm = 300.0;
+} // namespace
+
+void BeatClock::setTempo(float bpm, double now) {
+    tempo = bpm;
+    if (isFollowingClock(now) || bpm <= 0.0f) {
+        return;
+    }
+    anchor(now, beatAt(now));
+    beatsPerSecond = bpm / 60.0;
+}
+
+double BeatClock::beatAt(double now) const {
+    return anchorBeat + (now - anchorTime) * beatsPerSecond;
+}
+
+void BeatClock::anchor(double time, double beat) {
+    anchorTime = time;
+    anchorBeat = beat;
+}
+
+void BeatClock::clockTick(double time) {
+    bool wasFollowing = isFollowingClock(time);
+    if (resyncNextTick) {
+        nextTick = songTick;
+    } else if (!wasFollowing) {
+        // Clock without a start message: keep the beat where it is and count
+        // ticks from the nearest one.
+        nextTick = static_cast<int64_t>(std::llround(beatAt(time) * kTicksPerBeat));
+    }
+    double expected = static_cast<double>(nextTick) / kTicksPerBeat;
+
+    if (!wasFollowing) {
+        intervalCount = 0;
+        tickInterval = 0.0;
+        jitterSeconds = 0.0;
+        anchor(time, expected);
+    } else {
+        double interval = time - lastTickTime;
+        if (intervalCount < kBootstrapTicks) {
+            // Plain average of the first beat's intervals.
+            tickInterval = (tickInterval * intervalCount + interval) / (intervalCount + 1);
+            ++intervalCount;
+            double bpm = 60.0 / (tickInterval * kTicksPerBeat);
+            beatsPerSecond = std::min(kMaxBpm, std::max(kMinBpm, bpm)) / 60.0;
+        }
+        double error = expected - beatAt(time);
+        if (resyncNextTick || std::abs(error) > kMaxErrorBeats) {
+            anchor(time, expected);
+        } else {
+            anchor(time, beatAt(time) + kPhaseGain * error);
+            if (intervalCount >= kBootstrapTicks) {
+                double tickSeconds = 1.0 / (beatsPerSecond * kTicksPerBeat);
+                beatsPerSecond += kRateGain * error / tickSeconds;
+                beatsPerSecond = std::min(kMaxBpm / 60.0, std::max(kMinBpm / 60.0, beatsPerSecond));
+            }
+            jitterSeconds += (std::abs(error) / beatsPerSecond - jitterSeconds) * 0.05;
+        }
+    }
+
+    following = true;
+    resyncNextTick = false;
+    lastTickTime = time;
+    ++nextTick;
+    if (running) {
+        ++songTick;
+    }
+}
+
+void BeatClock::start() {
+    running = true;
+    songTick = 0;
+    resyncNextTick = true;
+}
+
+void BeatClock::stop() {
+    running = false;
+}
+
+void BeatClock::resume() {
+    running = true;
+    resyncNextTick = true;
+}
+
+void BeatClock::setSongPosition(int sixteenths) {
+    songTick = static_cast<int64_t>(std::max(0, sixteenths)) * (kTicksPerBeat / 4);
+    // Normally sent while stopped and applied on continue.
+    if (running) {
+        resyncNextTick = true;
+    }
+}
+
+bool BeatClock::isFollowingClock(double now) const {
+    return following && now - lastTickTime < kClockTimeoutSeconds;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+// The app's one beat position, shared by the shader pulse, the control
+// oscillators and the beat dot. Times are seconds on the app clock
+// (ofGetElapsedTimef(), or the offline time when rendering headless).
+//
+// It runs free at the tempo control's BPM, and a tempo change keeps the
+// phase where it is. When MIDI clock arrives it follows that instead: each
+// clock tick (24 per beat) is compared with where the clock expected it,
+// and a phase-locked loop nudges the phase and tempo by a fraction of the
+// error. Single ticks that land early or late (USB and driver jitter) move
+// the beat by very little, while a real tempo change is tracked within a
+// few beats. The sender's song position only advances while its transport
+// runs: start begins at tick 0, and continue at the tick where stop left off
+// (or the last song position pointer), so beat 0 of a bar lines up with the
+// sender's downbeat. While stopped the clock keeps following the ticks'
+// tempo and phase. Clock without any start keeps the beat where it was.
+class BeatClock {
+public:
+    static constexpr int kTicksPerBeat = 24;
+
+    // Free-running tempo. Ignored while MIDI clock is being followed; after
+    // the clock goes away the beat keeps its last tempo until this is called.
+    void setTempo(float bpm, double now);
+    float getTempo() const { return tempo; }
+
+    // Beats since the clock started; continuous.
+    double beatAt(double now) const;
+    // The tempo the beat is advancing at (the MIDI clock's, when following).
+    float getBpm() const { return static_cast<float>(beatsPerSecond * 60.0); }
+
+    // MIDI clock input, in event order. Times are when each message was sent.
+    void clockTick(double time);
+    void start();
+    void stop();
+    void resume();
+    // In MIDI beats (sixteenth notes), as sent by song position pointer.
+    void setSongPosition(int sixteenths);
+
+    // True while MIDI clock ticks keep arriving.
+    bool isFollowingClock(double now) const;
+    bool isTransportRunning() const { return running; }
+    // Mean absolute phase error of recent ticks, in milliseconds.
+    float getJitterMillis() const { return static_cast<float>(jitterSeconds * 1000.0); }
+
+private:
+    void anchor(double time, double beat);
+
+    float tempo = 60.0f;
+    double anchorTime = 0.0;
+    double anchorBeat = 0.0;
+    double beatsPerSecond = 1.0;
+
+    // MIDI clock state.
+    bool following = false;
+    bool running = false;
+    bool resyncNextTick = false; // set by start, continue and a position change
+    int64_t nextTick = 0;        // tick the loop expects next
+    int64_t songTick = 0;        // sender's song position, in ticks
+    double lastTickTime = 0.0;
+    double tickInterval = 0.0; // filtered seconds per tick
+    int intervalCount = 0;
+    double jitterSeconds = 0.0;
+};
@@ -0,0 +1,532 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BackgroundSegmenter.h"
+#include "CounterRandom.h"
+#include "FrameSource.h"
+#include "KeyEffectCpu.h"
+#include "PixelInterleave.h"
+#include "SparkPool.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template <typename Fn>
+double averageMillis(int iterations, Fn &&fn) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    return millisSince(start) / iterations;
+}
+
+// Matches the ofApp defaults for the key and pulse settings.
+KeyEffectParams defaultKeyParams(int width, int height) {
+    KeyEffectParams params;
+    params.texWidth = static_cast<float>(width);
+    params.texHeight = static_cast<float>(height);
+    params.keyHue = 120.0f / 360.0f;
+    params.keyHueRange = 60.0f / 360.0f;
+    params.keyMinSat = 0.25f;
+    params.keyMinVal = 0.2f;
+    params.levels = 6.0f;
+    params.edgeStrength = 1.1f;
+    params.time = 12.3f;
+    params.beat = 24.6f;
+    params.pulseAmount = 0.25f;
+    params.pulseColorize = 0.4f;
+    params.wetMix = 0.6f;
+    return params;
+}
+
+struct KeyPreset {
+    const char *name;
+    std::function<void(KeyEffectParams &)> apply;
+};
+
+int benchKeyEffect(const AppConfig &config) {
+    // A level of difference is expected from the polynomial approximations;
+    // floor()/mod() steps may flip a few more pixels.
+    constexpr int kTolerance = 2;
+    constexpr double kMaxOverFraction = 0.001;
+    constexpr int kIterations = 30;
+
+    SyntheticSource source(config.camWidth, config.camHeight);
+    if (!source.open() || !source.update()) {
+        ofLogWarning() << "Bench: cannot create synthetic frame";
+        return 1;
+    }
+    const ofPixels &pixels = source.getPixels();
+    cv::Mat rgb(static_cast<int>(pixels.getHeight()), static_cast<int>(pixels.getWidth()), CV_8UC3,
+                const_cast<unsigned char *>(pixels.getData()), pixels.getBytesStride());
+
+    const std::vector<KeyPreset> presets = {
+        {"plain", [](KeyEffectParams &) {}},
+        {"kaleido+woofer", [](KeyEffectParams &p) {
+             p.kaleidoOn = true;
+             p.kaleidoSegments = 6.0f;
+             p.kaleidoSpin = 0.25f;
+             p.kaleidoZoom = 0.7f;
+             p.wooferOn = true;
+             p.wooferStrength = 0.22f;
+             p.wooferFalloff = 1.5f;
+         }},
+        {"halftone+sat+hue", [](KeyEffectParams &p) {
+             p.halftoneOn = true;
+             p.satOn = true;
+             p.satScale = 0.45f;
+             p.pulseHueMode = 1.0f;
+             p.pulseHueShift = 18.0f;
+         }},
+        {"all", [](KeyEffectParams &p) {
+             p.kaleidoOn = true;
+             p.kaleidoSegments = 8.0f;
+             p.kaleidoZoom = 0.5f;
+             p.wooferOn = true;
+             p.wooferStrength = 0.22f;
+             p.wooferFalloff = 1.5f;
+             p.halftoneOn = true;
+             p.satOn = true;
+             p.satScale = 0.7f;
+             p.pulseHueMode = -1.0f;
+             p.pulseHueShift = 18.0f;
+         }},
+    };
+
+    KeyEffectCpu single(nullptr);
+    KeyEffectCpu threaded(&WorkerPool::shared());
+    ofPixels reference;
+    ofPixels output;
+    bool passed = true;
+    ofLogNotice() << "Bench key: " << rgb.cols << "x" << rgb.rows
+                  << " simd=" << KeyEffectCpu::getBackendName()
+                  << " threads=" << WorkerPool::shared().getConcurrency();
+
+    for (const auto &preset : presets) {
+        KeyEffectParams params = defaultKeyParams(rgb.cols, rgb.rows);
+        preset.apply(params);
+
+        double referenceMs = averageMillis(1, [&] { renderKeyEffectReference(rgb, params, reference); });
+        double singleMs = averageMillis(kIterations, [&] { single.render(rgb, params, output); });
+        double threadedMs = averageMillis(kIterations, [&] { threaded.render(rgb, params, output); });
+
+        KeyEffectDiff diff = compareKeyEffect(reference, output, kTolerance);
+        double overFraction = diff.pixelCount > 0
+            ? static_cast<double>(diff.pixelsOverTolerance) / diff.pixelCount
+            : 1.0;
+        bool ok = !diff.sizeMismatch && overFraction <= kMaxOverFraction;
+        passed = passed && ok;
+
+        ofLogNotice() << "  " << preset.name
+                      << ": reference=" << ofToString(referenceMs, 1) << "ms"
+                      << " simd=" << ofToString(singleMs, 2) << "ms"
+                      << " simd+threads=" << ofToString(threadedMs, 2) << "ms"
+                      << " (" << ofToString(1000.0 / threadedMs, 0) << " fps)"
+                      << " maxDiff=" << diff.maxDiff
+                      << " meanDiff=" << ofToString(diff.meanDiff, 4)
+                      << " over=" << diff.pixelsOverTolerance
+                      << (ok ? " ok" : " FAIL");
+    }
+    return passed ? 0 : 1;
+}
+
+bool samePixels(const ofPixels &a, const unsigned char *b, size_t size) {
+    return a.isAllocated() && a.size() == size && std::memcmp(a.getData(), b, size) == 0;
+}
+
+int benchInterleave(const AppConfig &config) {
+    constexpr int kIterations = 200;
+
+    SyntheticSource source(config.camWidth, config.camHeight);
+    if (!source.open() || !source.update()) {
+        ofLogWarning() << "Bench: cannot create synthetic frame";
+        return 1;
+    }
+    const ofPixels &pixels = source.getPixels();
+    cv::Mat rgb(static_cast<int>(pixels.getHeight()), static_cast<int>(pixels.getWidth()), CV_8UC3,
+                const_cast<unsigned char *>(pixels.getData()), pixels.getBytesStride());
+    // Blocky mask so every alpha value shows up somewhere.
+    cv::Mat mask(rgb.rows, rgb.cols, CV_8UC1);
+    for (int y = 0; y < mask.rows; ++y) {
+        unsigned char *row = mask.ptr<unsigned char>(y);
+        for (int x = 0; x < mask.cols; ++x) {
+            row[x] = static_cast<unsigned char>(((x / 7) ^ (y / 5)) * 37);
+        }
+    }
+
+    ofPixels reference;
+    ofPixels single;
+    ofPixels threaded;
+    cv::Mat merged;
+    std::vector<cv::Mat> channels;
+
+    double scalarMs = averageMillis(kIterations, [&] { interleaveRgbMaskScalar(rgb, mask, reference); });
+    double mergeMs = averageMillis(kIterations, [&] {
+        cv::split(rgb, channels);
+        channels.push_back(mask);
+        cv::merge(channels, merged);
+    });
+    double singleMs = averageMillis(kIterations, [&] { interleaveRgbMask(rgb, mask, single, nullptr); });
+    double threadedMs = averageMillis(kIterations, [&] { interleaveRgbMask(rgb, mask, threaded); });
+
+    size_t bytes = static_cast<size_t>(rgb.cols) * rgb.rows * 4;
+    bool ok = samePixels(single, reference.getData(), bytes) &&
+              samePixels(threaded, reference.getData(), bytes) &&
+              merged.isContinuous() && samePixels(reference, merged.data, bytes);
+
+    ofLogNotice() << "Bench interleave: " << rgb.cols << "x" << rgb.rows
+                  << " simd=" << getInterleaveBackendName()
+                  << " threads=" << WorkerPool::shared().getConcurrency();
+    ofLogNotice() << "  scalar loop=" << ofToString(scalarMs, 3) << "ms"
+                  << " cv::split+merge=" << ofToString(mergeMs, 3) << "ms"
+                  << " simd=" << ofToString(singleMs, 3) << "ms"
+                  << " simd+threads=" << ofToString(threadedMs, 3) << "ms"
+                  << (ok ? " ok" : " FAIL (outputs differ)");
+    return ok ? 0 : 1;
+}
+
+// --source if it is a recording, else the synthetic pattern.
+std::unique_ptr<FrameSource> openBenchSource(const AppConfig &config) {
+    FrameSourceSettings settings;
+    settings.width = config.camWidth;
+    settings.height = config.camHeight;
+    settings.loop = false;
+    std::string spec = config.source == "cam" ? "synthetic" : config.source;
+    auto source = createFrameSource(spec, settings);
+    if (!source || !source->open()) {
+        ofLogWarning() << "Bench: cannot open source " << spec;
+        return nullptr;
+    }
+    return source;
+}
+
+int benchBackground(const AppConfig &config) {
+    // Tiling doesn't change the model, so the masks should match; allow a
+    // stray pixel or two in case the library's vector paths round differently.
+    constexpr double kMaxDiffFraction = 0.0001;
+    int frameLimit = config.maxFrames > 0 ? config.maxFrames : 300;
+
+    auto source = openBenchSource(config);
+    if (!source) {
+        return 1;
+    }
+
+    // The tiled segmenter per model type and scale, each compared with the
+    // serial MOG2 mask; only tiled MOG2 at full size is expected to match.
+    struct Variant {
+        BackgroundModelType type = BackgroundModelType::Mog2;
+        int scale = 1;
+        BackgroundSegmenter segmenter;
+        cv::Mat mask;
+        double totalMs = 0.0;
+        double downscaleMs = 0.0;
+        double modelMs = 0.0;
+        double refineMs = 0.0;
+        double upsampleMs = 0.0;
+        double diffSum = 0.0;
+        double worstDiff = 0.0;
+        double iouSum = 0.0;
+    };
+    const std::pair<BackgroundModelType, int> kVariants[] = {
+        {BackgroundModelType::Mog2, 1},
+        {BackgroundModelType::Mog2, 2},
+        {BackgroundModelType::Mog2, 4},
+        {BackgroundModelType::Average, 1},
+        {BackgroundModelType::Average, 2},
+    };
+    BackgroundMaskSettings settings;
+    std::vector<std::unique_ptr<Variant>> variants;
+    for (const auto &spec : kVariants) {
+        variants.push_back(std::make_unique<Variant>());
+        Variant &variant = *variants.back();
+        variant.type = spec.first;
+        variant.scale = spec.second;
+        variant.segmenter.setModelType(spec.first);
+        variant.segmenter.setModelScale(spec.second);
+        variant.segmenter.reset(settings);
+    }
+    cv::Ptr<cv::BackgroundSubtractorMOG2> serial = cv::createBackgroundSubtractorMOG2();
+    serial->setDetectShadows(settings.detectShadows);
+
+    cv::Mat serialMask;
+    cv::Mat diff;
+    cv::Mat overlap;
+    double serialMs = 0.0;
+    int frames = 0;
+    while (frames < frameLimit && !source->isFinished()) {
+        if (!source->update()) {
+            continue;
+        }
+        const ofPixels &pixels = source->getPixels();
+        cv::Mat rgb(static_cast<int>(pixels.getHeight()), static_cast<int>(pixels.getWidth()), CV_8UC3,
+                    const_cast<unsigned char *>(pixels.getData()), pixels.getBytesStride());
+
+        auto start = Clock::now();
+        serial->apply(rgb, serialMask);
+        refineBackgroundMaskReference(serialMask, settings);
+        serialMs += millisSince(start);
+
+        for (auto &variant : variants) {
+            start = Clock::now();
+            variant->segmenter.apply(rgb, settings, variant->mask);
+            variant->totalMs += millisSince(start);
+            variant->downscaleMs += variant->segmenter.getLastDownscaleMicros() / 1000.0;
+            variant->modelMs += variant->segmenter.getLastModelMicros() / 1000.0;
+            variant->refineMs += variant->segmenter.getLastRefineMicros() / 1000.0;
+            variant->upsampleMs += variant->segmenter.getLastUpsampleMicros() / 1000.0;
+
+            cv::compare(serialMask, variant->mask, diff, cv::CMP_NE);
+            double fraction = static_cast<double>(cv::countNonZero(diff)) / diff.total();
+            variant->diffSum += fraction;
+            variant->worstDiff = std::max(variant->worstDiff, fraction);
+            // Foreground intersection over union; 1 when both are empty.
+            cv::bitwise_and(serialMask, variant->mask, overlap);
+            int intersection = cv::countNonZero(overlap);
+            cv::bitwise_or(serialMask, variant->mask, overlap);
+            int unionCount = cv::countNonZero(overlap);
+            variant->iouSum += unionCount > 0 ? static_cast<double>(intersection) / unionCount : 1.0;
+        }
+        frames++;
+    }
+    if (frames == 0) {
+        ofLogWarning() << "Bench: no frames from " << source->describe();
+        return 1;
+    }
+
+    bool ok = variants.front()->worstDiff <= kMaxDiffFraction;
+    ofLogNotice() << "Bench bgsub: " << source->describe() << " " << serialMask.cols << "x" << serialMask.rows
+                  << " frames=" << frames << " tiles=" << variants.front()->segmenter.getTileCount()
+                  << " threads=" << WorkerPool::shared().getConcurrency();
+    ofLogNotice() << "  serial MOG2+cleanup=" << ofToString(serialMs / frames, 2) << "ms";
+    for (const auto &variant : variants) {
+        bool exact = variant.get() == variants.front().get();
+        ofLogNotice() << "  " << describeBackgroundModel(variant->type) << " 1/" << variant->scale
+                      << "=" << ofToString(variant->totalMs / frames, 2) << "ms"
+                      << " (downscale " << ofToString(variant->downscaleMs / frames, 2) << "ms"
+                      << ", model " << ofToString(variant->modelMs / frames, 2) << "ms"
+                      << ", refine " << ofToString(variant->refineMs / frames, 2) << "ms"
+                      << ", upsample " << ofToString(variant->upsampleMs / frames, 2) << "ms)"
+                      << " vs serial MOG2: mean diff=" << ofToString(variant->diffSum / frames * 100.0, 3) << "%"
+                      << " worst=" << ofToString(variant->worstDiff * 100.0, 3) << "%"
+                      << " IoU=" << ofToString(variant->iouSum / frames, 3)
+                      << (exact ? (ok ? " ok" : " FAIL") : "");
+    }
+    return ok ? 0 : 1;
+}
+
+// The array-of-structs store SparkPool replaced: erase the oldest when
+// full, compact with remove_if after each step.
+struct LegacySpark {
+    ofVec2f pos;
+    ofVec2f prev;
+    ofVec2f vel;
+    ofFloatColor color;
+    float age = 0.0f;
+    float life = 1.0f;
+    float size = 2.0f;
+};
+
+struct SparkBenchEmitter {
+    uint64_t streams = 0;
+
+    template <typename AddFn>
+    void emit(int count, AddFn &&add) {
+        for (int i = 0; i < count; ++i) {
+            CounterRandom random(1234, streams++);
+            float angle = random.next() * TWO_PI;
+            float speed = 2400.0f * random.range(0.4f, 1.0f);
+            ofVec2f pos(random.range(640.0f, 680.0f), random.range(360.0f, 400.0f));
+            ofVec2f vel(std::cos(angle) * speed, std::sin(angle) * speed);
+            ofFloatColor color(random.next(), random.next(), random.next(), 1.0f);
+            add(pos, vel, color, 1.4f * random.range(0.6f, 1.2f), random.range(1.5f, 4.5f));
+        }
+    }
+};
+
+// FNV-1a over every live spark's attributes.
+uint64_t hashSparks(const SparkPool &sparks) {
+    uint64_t hash = 1469598103934665603ull;
+    for (int f = 0; f < SparkPool::kFieldCount; ++f) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(sparks.field(static_cast<SparkPool::Field>(f)));
+        for (size_t i = 0; i < sparks.size() * sizeof(float); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void addLegacySpark(std::vector<LegacySpark> &sparks, size_t capacity, const ofVec2f &pos, const ofVec2f &vel,
+                    const ofFloatColor &color, float life, float size) {
+    if (sparks.size() >= capacity) {
+        sparks.erase(sparks.begin());
+    }
+    LegacySpark spark;
+    spark.pos = pos;
+    spark.prev = pos;
+    spark.vel = vel;
+    spark.color = color;
+    spark.life = life;
+    spark.size = size;
+    sparks.push_back(spark);
+}
+
+void integrateLegacySparks(std::vector<LegacySpark> &sparks, float dt, float drag, float gravity) {
+    for (auto &spark : sparks) {
+        spark.prev = spark.pos;
+        spark.age += dt;
+        spark.vel *= drag;
+        spark.vel.y += gravity * dt;
+        spark.pos += spark.vel * dt;
+    }
+    sparks.erase(std::remove_if(sparks.begin(), sparks.end(),
+                                [](const LegacySpark &s) { return s.age >= s.life; }),
+                 sparks.end());
+}
+
+int benchSparks(const AppConfig &config) {
+    constexpr int kCapacity = 50000;
+    constexpr float kDt = 1.0f / 60.0f;
+    constexpr float kDrag = 0.93f;
+    constexpr float kGravity = 220.0f;
+    // Below capacity, so both stores hold the same sparks.
+    constexpr int kCheckFrames = 120;
+    constexpr int kCheckEmit = 200;
+    // Far more than the capacity can hold, so both evict every frame. The
+    // old store's erase per spark is too slow to run for long.
+    constexpr int kFullEmit = 2000;
+    constexpr int kFullFrames = 120;
+    constexpr int kLegacyFullFrames = 5;
+    constexpr float kMaxPosError = 0.01f;
+
+    std::vector<LegacySpark> legacy;
+    SparkPool pool;
+    pool.setCapacity(kCapacity);
+    SparkBenchEmitter legacyEmitter;
+    SparkBenchEmitter poolEmitter;
+    for (int frame = 0; frame < kCheckFrames; ++frame) {
+        legacyEmitter.emit(kCheckEmit, [&](const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &c, float life,
+                                           float size) { addLegacySpark(legacy, kCapacity, pos, vel, c, life, size); });
+        poolEmitter.emit(kCheckEmit, [&](const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &c, float life,
+                                         float size) { pool.add(pos, vel, c, life, size); });
+        integrateLegacySparks(legacy, kDt, kDrag, kGravity);
+        pool.integrate(kDt, kDrag, kGravity);
+    }
+    // Swap-remove reorders the pool, so compare sorted positions.
+    std::vector<std::pair<float, float>> expected;
+    std::vector<std::pair<float, float>> actual;
+    for (const auto &spark : legacy) {
+        expected.emplace_back(spark.pos.x, spark.pos.y);
+    }
+    for (int i = 0; i < pool.size(); ++i) {
+        actual.emplace_back(pool.getPos(i).x, pool.getPos(i).y);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    float worstError = 0.0f;
+    bool ok = expected.size() == actual.size();
+    for (size_t i = 0; ok && i < expected.size(); ++i) {
+        worstError = std::max(worstError, std::max(std::abs(expected[i].first - actual[i].first),
+                                                    std::abs(expected[i].second - actual[i].second)));
+    }
+    ok = ok && worstError <= kMaxPosError;
+
+    auto runLegacy = [&] {
+        legacyEmitter.emit(kFullEmit, [&](const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &c, float life,
+                                          float size) { addLegacySpark(legacy, kCapacity, pos, vel, c, life, size); });
+        integrateLegacySparks(legacy, kDt, kDrag, kGravity);
+    };
+    double integrateMs = 0.0;
+    auto runPool = [&] {
+        poolEmitter.emit(kFullEmit, [&](const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &c, float life,
+                                        float size) { pool.add(pos, vel, c, life, size); });
+        auto start = Clock::now();
+        pool.integrate(kDt, kDrag, kGravity);
+        integrateMs += millisSince(start);
+    };
+    // Fill both before timing.
+    while (static_cast<int>(legacy.size()) < kCapacity - kFullEmit) {
+        runLegacy();
+    }
+    while (pool.size() < kCapacity - kFullEmit) {
+        runPool();
+    }
+    double legacyMs = averageMillis(kLegacyFullFrames, runLegacy);
+    integrateMs = 0.0;
+    double poolMs = averageMillis(kFullFrames, runPool);
+
+    // The same sparks stepped on 1, 2 and 4 threads and the shared pool must
+    // come out bit-identical.
+    struct ThreadRun {
+        std::unique_ptr<WorkerPool> ownPool;
+        WorkerPool *workers = nullptr;
+        double stepMs = 0.0;
+        uint64_t hash = 0;
+    };
+    std::vector<ThreadRun> threadRuns(4);
+    for (int i = 0; i < 3; ++i) {
+        threadRuns[i].ownPool = std::make_unique<WorkerPool>((1 << i) - 1);
+        threadRuns[i].workers = threadRuns[i].ownPool.get();
+    }
+    threadRuns[3].workers = &WorkerPool::shared();
+    for (auto &run : threadRuns) {
+        SparkPool threaded;
+        threaded.setCapacity(kCapacity);
+        SparkBenchEmitter emitter;
+        for (int frame = 0; frame < kFullFrames; ++frame) {
+            emitter.emit(kFullEmit, [&](const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &c, float life,
+                                        float size) { threaded.add(pos, vel, c, life, size); });
+            auto start = Clock::now();
+            threaded.integrate(kDt, kDrag, kGravity, run.workers);
+            run.stepMs += millisSince(start);
+        }
+        run.hash = hashSparks(threaded);
+    }
+    bool deterministic = true;
+    for (const auto &run : threadRuns) {
+        deterministic = deterministic && run.hash == threadRuns.front().hash;
+    }
+    ok = ok && deterministic;
+
+    ofLogNotice() << "Bench sparks: capacity=" << kCapacity << " emit=" << kFullEmit << "/frame";
+    ofLogNotice() << "  check after " << kCheckFrames << " frames: sparks=" << actual.size()
+                  << " (reference " << expected.size() << ") worst pos error=" << worstError << "px"
+                  << (ok ? " ok" : " FAIL");
+    ofLogNotice() << "  emit+step per frame: vector of structs=" << ofToString(legacyMs, 3) << "ms"
+                  << " SparkPool=" << ofToString(poolMs, 3) << "ms"
+                  << " (step " << ofToString(integrateMs / kFullFrames, 3) << "ms at " << pool.size() << " sparks)";
+    ofLogNotice() << "  step per frame by threads:";
+    for (const auto &run : threadRuns) {
+        ofLogNotice() << "    " << run.workers->getConcurrency() << "=" << ofToString(run.stepMs / kFullFrames, 3) << "ms";
+    }
+    ofLogNotice() << "  same sparks on every thread count: " << (deterministic ? "yes ok" : "no FAIL");
+    (void)config;
+    return ok ? 0 : 1;
+}
+} // namespace
+
+int runBenchmark(const std::string &name, const AppConfig &config) {
+    if (name == "key") {
+        return benchKeyEffect(config);
+    }
+    if (name == "interleave") {
+        return benchInterleave(config);
+    }
+    if (name == "bgsub") {
+        return benchBackground(config);
+    }
+    if (name == "sparks") {
+        return benchSparks(config);
+    }
+    ofLogWarning() << "Unknown benchmark \"" << name << "\" (available: key, interleave, bgsub, sparks)";
+    return 1;
+}
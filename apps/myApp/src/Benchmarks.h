@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "ofApp.h"
+
+// Command line benchmarks (--bench <name>). They run on synthetic frames at
+// the configured --width/--height, log timings and correctness checks, and
+// return the process exit code (non-zero when a check fails).
+//   key         CPU key effect: scalar reference vs SIMD, single vs multi-threaded.
+//   interleave  bg-sub RGB + mask to RGBA: byte loop vs cv::merge vs SIMD.
+//   bgsub       bg-sub mask: serial MOG2 + OpenCV cleanup vs the tiled segmenter
+//               with MOG2 at model scales 1, 2 and 4 and the running average at
+//               1 and 2, on --source (a recording) or the synthetic pattern.
+//   sparks      spark store: vector of structs vs SparkPool at 50k sparks, and
+//               the SparkPool step on 1, 2, 4 and all threads (must match bit for bit).
+int runBenchmark(const std::string &name, const AppConfig &config);
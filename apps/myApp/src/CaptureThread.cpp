@@ -0,0 +1,101 @@
+#include "CaptureThread.h"
+
+#include <algorithm>
+
+namespace {
+constexpr auto kPollInterval = std::chrono::milliseconds(1);
+constexpr auto kFastPollInterval = std::chrono::microseconds(100);
+}
+
+CaptureThread::~CaptureThread() {
+    stop();
+}
+
+bool CaptureThread::start(std::unique_ptr<FrameSource> newSource, FramePacing newPacing, int fps) {
+    stop();
+    if (!newSource) {
+        return false;
+    }
+    if (!newSource->open()) {
+        ofLogWarning() << "Capture: failed to open " << newSource->describe();
+        return false;
+    }
+
+    source = std::move(newSource);
+    pacing = newPacing;
+    framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / std::max(1, fps)));
+    finished = false;
+    running = true;
+    thread = std::thread(&CaptureThread::run, this);
+    ofLogNotice() << "Capture: " << source->describe()
+                  << " pacing=" << (pacing == FramePacing::Fast ? "fast" : "realtime");
+    return true;
+}
+
+void CaptureThread::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (source) {
+        source->close();
+        source.reset();
+    }
+}
+
+void CaptureThread::waitForNextFrame(std::chrono::steady_clock::time_point &due) {
+    if (source->isDevicePaced()) {
+        return;
+    }
+    if (pacing == FramePacing::Fast) {
+        while (running && !ring.isLatestSeen()) {
+            std::this_thread::sleep_for(kFastPollInterval);
+        }
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (due > now) {
+        std::this_thread::sleep_until(due);
+        due += framePeriod;
+    } else {
+        // Running behind: restart the schedule rather than bursting to catch up.
+        due = now + framePeriod;
+    }
+}
+
+void CaptureThread::run() {
+    auto due = std::chrono::steady_clock::now();
+    while (running) {
+        waitForNextFrame(due);
+        if (!running) {
+            break;
+        }
+        if (!source->update()) {
+            if (source->isFinished()) {
+                finished = true;
+                break;
+            }
+            std::this_thread::sleep_for(kPollInterval);
+            continue;
+        }
+
+        float captureTime = ofGetElapsedTimef();
+        CameraFrame *frame = ring.beginWrite();
+        if (!frame) {
+            // Every slot is borrowed; counted as an overrun by the ring.
+            continue;
+        }
+
+        const ofPixels &pixels = source->getPixels();
+        frame->pixels.setFromPixels(pixels.getData(),
+                                    pixels.getWidth(),
+                                    pixels.getHeight(),
+                                    pixels.getNumChannels());
+        frame->preprocessor.setScale(visionScale);
+        if (!frame->preprocessor.update(frame->pixels)) {
+            ofLogWarning() << "Preprocess: " << frame->preprocessor.getLastError();
+        }
+        ring.commitWrite(frame, captureTime);
+    }
+}
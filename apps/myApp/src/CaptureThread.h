@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "FrameRing.h"
+#include "FrameSource.h"
+
+enum class FramePacing {
+    Realtime, // non-device sources are delivered at the configured fps
+    Fast      // deliver the next frame as soon as the previous one was picked up
+};
+
+// Polls a FrameSource on a dedicated thread. Each new frame is copied once
+// into a FrameRing slot and preprocessed there, so the render, motion,
+// composite and detector stages can borrow it without copying.
+class CaptureThread {
+public:
+    ~CaptureThread();
+
+    bool start(std::unique_ptr<FrameSource> source, FramePacing pacing, int fps);
+    void stop();
+    bool isRunning() const { return running; }
+    // A non-looping file source has delivered its last frame.
+    bool isFinished() const { return finished; }
+
+    void setVisionScale(float scale) { visionScale = scale; }
+    FrameRef acquireLatest() { return ring.acquireLatest(); }
+
+    uint64_t getCapturedCount() const { return ring.getPublishedCount(); }
+    uint64_t getDroppedCount() const { return ring.getDroppedCount(); }
+    uint64_t getOverrunCount() const { return ring.getOverrunCount(); }
+
+private:
+    void run();
+    void waitForNextFrame(std::chrono::steady_clock::time_point &due);
+
+    std::unique_ptr<FrameSource> source;
+    FramePacing pacing = FramePacing::Realtime;
+    std::chrono::steady_clock::duration framePeriod{};
+    FrameRing ring;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> finished{false};
+    std::atomic<float> visionScale{0.5f};
+};
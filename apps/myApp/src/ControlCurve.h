@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// The recent timestamped values of a continuous control (a knob), so it
+// can be read at any time between them instead of only at its latest value.
+// A fast knob sweep sends a CC every millisecond or two, often bunched into
+// a few bursts per frame; sampling the curve a fixed delay behind the clock
+// turns that into even per-frame steps however the messages arrived.
+class ControlCurve {
+public:
+    // The longest delay callers sample behind the newest point.
+    static constexpr uint64_t kMaxDelayMicros = 100000;
+    // Enough for kMaxDelayMicros at one CC per millisecond, plus the point
+    // added when the knob starts moving.
+    static constexpr int kPoints = 128;
+    static_assert(kPoints > kMaxDelayMicros / 1000, "history shorter than the longest delay");
+    // Points further apart than this are taken as the knob resting, then
+    // moving for this long, rather than one slow ramp.
+    static constexpr uint64_t kMaxGapMicros = 50000;
+
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+
+    // Times are expected in order; an earlier time is moved up to the newest.
+    void add(uint64_t timeMicros, float value) {
+        if (count > 0 && timeMicros < times[newest()]) {
+            timeMicros = times[newest()];
+        }
+        if (count > 0 && timeMicros - times[newest()] > kMaxGapMicros) {
+            push(timeMicros - kMaxGapMicros, values[newest()]);
+        }
+        push(timeMicros, value);
+    }
+
+    uint64_t getLastTime() const { return count > 0 ? times[newest()] : 0; }
+    float getLastValue() const { return count > 0 ? values[newest()] : 0.0f; }
+
+    // Linear between points; clamped to the first and last.
+    float sample(uint64_t timeMicros) const {
+        if (count == 0) {
+            return 0.0f;
+        }
+        int i = newest();
+        if (timeMicros >= times[i]) {
+            return values[i];
+        }
+        for (int n = 1; n < count; ++n) {
+            int older = (i + kPoints - 1) % kPoints;
+            if (timeMicros >= times[older]) {
+                uint64_t span = times[i] - times[older];
+                if (span == 0) {
+                    return values[i];
+                }
+                float t = static_cast<float>(timeMicros - times[older]) / static_cast<float>(span);
+                return values[older] + (values[i] - values[older]) * t;
+            }
+            i = older;
+        }
+        return values[i];
+    }
+
+private:
+    int newest() const { return next; }
+
+    void push(uint64_t timeMicros, float value) {
+        next = (next + 1) % kPoints;
+        times[next] = timeMicros;
+        values[next] = value;
+        if (count < kPoints) {
+            ++count;
+        }
+    }
+
+    std::array<uint64_t, kPoints> times{};
+    std::array<float, kPoints> values{};
+    int count = 0;
+    int next = kPoints - 1;
+};
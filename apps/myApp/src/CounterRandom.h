@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers: draw n of a stream is a hash (SplitMix64) of
+// the seed, the stream number and n, with no state shared between streams.
+// Giving each particle (or each chunk of work) its own stream makes the
+// numbers independent of which thread draws them and in what order, so a
+// seed and the same input always give the same output.
+class CounterRandom {
+public:
+    CounterRandom(uint64_t seed, uint64_t stream) : key(mix(seed + mix(stream + kGolden))) {}
+
+    uint64_t nextBits() { return mix(key + ++counter * kGolden); }
+    // Uniform in [0, 1).
+    float next() { return static_cast<float>(nextBits() >> 40) * (1.0f / 16777216.0f); }
+    // Uniform in [lo, hi).
+    float range(float lo, float hi) { return lo + (hi - lo) * next(); }
+
+private:
+    static constexpr uint64_t kGolden = 0x9e3779b97f4a7c15ull;
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key;
+    uint64_t counter = 0;
+};
@@ -0,0 +1,194 @@
+#include "DetectionScheduler.h"
+
+namespace {
+constexpr auto kIdleWait = std::chrono::milliseconds(5);
+}
+
+DetectionScheduler::~DetectionScheduler() {
+    close();
+}
+
+void DetectionScheduler::setup(bool threaded) {
+    close();
+    faceDetector.setup();
+    handDetector.setup();
+    face.dueTime = 0.0f;
+    hand.dueTime = 0.0f;
+    if (!threaded) {
+        return;
+    }
+    running = true;
+    face.thread = std::thread(&DetectionScheduler::runFaceWorker, this);
+    hand.thread = std::thread(&DetectionScheduler::runHandWorker, this);
+}
+
+void DetectionScheduler::close() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wake.notify_all();
+    if (face.thread.joinable()) {
+        face.thread.join();
+    }
+    if (hand.thread.joinable()) {
+        hand.thread.join();
+    }
+}
+
+void DetectionScheduler::setFaceEnabled(bool enabled) {
+    face.enabled = enabled;
+}
+
+void DetectionScheduler::setFaceRate(float rateHz) {
+    face.rateHz = rateHz;
+}
+
+void DetectionScheduler::setHandEnabled(bool enabled) {
+    hand.enabled = enabled;
+}
+
+void DetectionScheduler::setHandRate(float rateHz) {
+    hand.rateHz = rateHz;
+}
+
+void DetectionScheduler::setHandFingers(const std::array<bool, 5> &fingers) {
+    uint8_t mask = 0;
+    for (size_t i = 0; i < fingers.size(); ++i) {
+        if (fingers[i]) {
+            mask |= static_cast<uint8_t>(1u << i);
+        }
+    }
+    handFingerMask = mask;
+}
+
+void DetectionScheduler::submitFrame(const FrameRef &frame) {
+    if (!running || !frame || !frame->pyramid().valid()) {
+        return;
+    }
+    if (face.enabled) {
+        submitTo(face, frame);
+    }
+    if (hand.enabled) {
+        submitTo(hand, frame);
+    }
+    wake.notify_all();
+}
+
+void DetectionScheduler::detectFrame(const FrameRef &frame, float time) {
+    if (running || !frame || !frame->pyramid().valid()) {
+        return;
+    }
+    if (takeIfDue(face, time)) {
+        detectFaces(frame, time);
+    }
+    if (takeIfDue(hand, time)) {
+        detectHands(frame, time);
+    }
+}
+
+bool DetectionScheduler::takeIfDue(Worker &worker, float time) {
+    if (!worker.enabled || time < worker.dueTime) {
+        return false;
+    }
+    float rateHz = worker.rateHz;
+    worker.dueTime = rateHz > 0.0f ? time + 1.0f / rateHz : time;
+    return true;
+}
+
+bool DetectionScheduler::consumeFaces(FaceResult &out) {
+    if (!faceResults.consume()) {
+        return false;
+    }
+    out = faceResults.read();
+    return true;
+}
+
+bool DetectionScheduler::consumeHands(HandResult &out) {
+    if (!handResults.consume()) {
+        return false;
+    }
+    out = handResults.read();
+    return true;
+}
+
+void DetectionScheduler::submitTo(Worker &worker, const FrameRef &frame) {
+    worker.input.writeSlot() = frame;
+    worker.input.publish();
+    // The slot handed back is stale; drop its borrow so the ring can reuse it.
+    worker.input.writeSlot().reset();
+}
+
+std::chrono::steady_clock::time_point DetectionScheduler::nextDue(const Worker &worker,
+                                                                  std::chrono::steady_clock::time_point start) {
+    float rateHz = worker.rateHz;
+    if (rateHz <= 0.0f) {
+        return start;
+    }
+    auto period = std::chrono::duration<float>(1.0f / rateHz);
+    return start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+}
+
+bool DetectionScheduler::waitForFrame(Worker &worker, std::chrono::steady_clock::time_point due) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wake.wait_until(lock, due, [&] { return !running; });
+    while (running) {
+        if (worker.enabled && worker.input.consume()) {
+            return true;
+        }
+        wake.wait_for(lock, kIdleWait);
+    }
+    return false;
+}
+
+void DetectionScheduler::runFaceWorker() {
+    auto due = std::chrono::steady_clock::now();
+    while (waitForFrame(face, due)) {
+        auto start = std::chrono::steady_clock::now();
+        FrameRef &frame = face.input.read();
+        detectFaces(frame, frame->captureTime);
+        frame.reset();
+        due = nextDue(face, start);
+    }
+}
+
+void DetectionScheduler::runHandWorker() {
+    auto due = std::chrono::steady_clock::now();
+    while (waitForFrame(hand, due)) {
+        auto start = std::chrono::steady_clock::now();
+        FrameRef &frame = hand.input.read();
+        detectHands(frame, frame->captureTime);
+        frame.reset();
+        due = nextDue(hand, start);
+    }
+}
+
+void DetectionScheduler::detectFaces(const FrameRef &frame, float frameTime) {
+    const FramePyramid &pyramid = frame->pyramid();
+    FaceResult &result = faceResults.writeSlot();
+    result.error.clear();
+    if (!faceDetector.detect(pyramid.bgraHalf, pyramid.width, pyramid.height, result.faces)) {
+        result.error = faceDetector.getLastError();
+    }
+    result.frameNumber = frame->sequence;
+    result.frameTime = frameTime;
+    faceResults.publish();
+}
+
+void DetectionScheduler::detectHands(const FrameRef &frame, float frameTime) {
+    const FramePyramid &pyramid = frame->pyramid();
+    std::array<bool, 5> fingers;
+    uint8_t mask = handFingerMask;
+    for (size_t i = 0; i < fingers.size(); ++i) {
+        fingers[i] = (mask & (1u << i)) != 0;
+    }
+
+    HandResult &result = handResults.writeSlot();
+    handDetector.setEnabledFingers(fingers);
+    result.error.clear();
+    if (!handDetector.detect(pyramid.bgraHalf, pyramid.width, pyramid.height, result.points)) {
+        result.error = handDetector.getLastError();
+    }
+    result.frameNumber = frame->sequence;
+    result.frameTime = frameTime;
+    handResults.publish();
+}
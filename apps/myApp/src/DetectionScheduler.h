@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameRing.h"
+#include "LatestValue.h"
+#include "VisionFaceDetector.h"
+#include "VisionHandPoseDetector.h"
+
+// Runs the Vision face and hand detectors on their own worker threads.
+// The render thread submits borrowed camera frames and picks up the newest
+// results without ever waiting on a detector. Headless renders set it up
+// without threads and call detectFrame() instead, so every frame sees the
+// results a given input always gives.
+class DetectionScheduler {
+public:
+    struct FaceResult {
+        std::vector<ofRectangle> faces;
+        uint64_t frameNumber = 0;
+        float frameTime = 0.0f;
+        std::string error;
+    };
+
+    struct HandResult {
+        std::vector<VisionHandPoseDetector::HandPoint> points;
+        uint64_t frameNumber = 0;
+        float frameTime = 0.0f;
+        std::string error;
+    };
+
+    ~DetectionScheduler();
+
+    // Without threads, frames go through detectFrame() only.
+    void setup(bool threaded = true);
+    void close();
+
+    void setFaceEnabled(bool enabled);
+    void setFaceRate(float rateHz);
+    void setHandEnabled(bool enabled);
+    void setHandRate(float rateHz);
+    void setHandFingers(const std::array<bool, 5> &fingers);
+
+    void submitFrame(const FrameRef &frame);
+    // Runs the enabled detectors that are due at time (seconds, on the
+    // caller's clock) on the calling thread and publishes their results.
+    void detectFrame(const FrameRef &frame, float time);
+    bool consumeFaces(FaceResult &out);
+    bool consumeHands(HandResult &out);
+
+private:
+    struct Worker {
+        std::thread thread;
+        LatestValue<FrameRef> input;
+        std::atomic<bool> enabled{true};
+        std::atomic<float> rateHz{10.0f};
+        float dueTime = 0.0f; // detectFrame() only
+    };
+
+    void runFaceWorker();
+    void runHandWorker();
+    void detectFaces(const FrameRef &frame, float frameTime);
+    void detectHands(const FrameRef &frame, float frameTime);
+    static bool takeIfDue(Worker &worker, float time);
+    bool waitForFrame(Worker &worker, std::chrono::steady_clock::time_point due);
+    static std::chrono::steady_clock::time_point nextDue(const Worker &worker,
+                                                         std::chrono::steady_clock::time_point start);
+    static void submitTo(Worker &worker, const FrameRef &frame);
+
+    Worker face;
+    Worker hand;
+    VisionFaceDetector faceDetector;
+    VisionHandPoseDetector handDetector;
+    LatestValue<FaceResult> faceResults;
+    LatestValue<HandResult> handResults;
+    std::atomic<uint8_t> handFingerMask{0x1f};
+
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
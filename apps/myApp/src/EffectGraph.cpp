@@ -0,0 +1,204 @@
+#include "EffectGraph.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "KeyShaderSource.h"
+
+void EffectGraph::setup(const std::string &vertexSource) {
+    programs.setup(vertexSource);
+    plans.clear();
+    fbos.clear();
+
+    upscaleReady = upscaleShader.setupShaderFromSource(GL_VERTEX_SHADER, vertexSource) &&
+                   upscaleShader.setupShaderFromSource(GL_FRAGMENT_SHADER, getKeyUpscaleShaderSource());
+    if (upscaleReady) {
+        upscaleShader.bindDefaults();
+        upscaleReady = upscaleShader.linkProgram();
+    }
+    if (!upscaleReady) {
+        ofLogWarning() << "Effect graph: failed to compile the upscale shader; shading at output size.";
+    }
+}
+
+void EffectGraph::setProcessingScale(float scale) {
+    processingScale = scale > 0.0f ? ofClamp(scale, 0.1f, 1.0f) : 0.0f;
+}
+
+void EffectGraph::addNode(const EffectNode &node) {
+    nodes.push_back(node);
+    plans.clear();
+}
+
+bool EffectGraph::setNodeScale(const std::string &name, float scale) {
+    for (auto &node : nodes) {
+        if (node.name == name) {
+            scale = ofClamp(scale, 0.1f, 1.0f);
+            if (node.scale != scale) {
+                node.scale = scale;
+                plans.clear();
+            }
+            return true;
+        }
+    }
+    ofLogWarning() << "Effect graph: no node named " << name;
+    return false;
+}
+
+void EffectGraph::prewarm(const std::vector<uint32_t> &featureSets) {
+    uint64_t start = ofGetElapsedTimeMillis();
+    for (uint32_t features : featureSets) {
+        getPlan(features);
+    }
+    ofLogNotice() << "Effect graph: prewarmed " << featureSets.size() << " feature sets ("
+                  << programs.getCompiledCount() << " programs) in "
+                  << (ofGetElapsedTimeMillis() - start) << "ms";
+}
+
+const std::vector<EffectGraph::Pass> &EffectGraph::getPlan(uint32_t features) {
+    features &= KeyFeature::All;
+    auto found = plans.find(features);
+    if (found != plans.end()) {
+        return found->second;
+    }
+    return plans[features] = buildPlan(features);
+}
+
+std::vector<EffectGraph::Pass> EffectGraph::buildPlan(uint32_t features) {
+    std::vector<Pass> passes;
+    bool colorWritten = false; // by an earlier node of the current pass
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const EffectNode &node = nodes[i];
+        if (node.features != 0 && (node.features & features) == 0) {
+            continue;
+        }
+        bool fuse = !passes.empty() && passes.back().scale == node.scale;
+        if (node.input == NodeInput::Neighbourhood) {
+            fuse = fuse && !colorWritten;
+        } else if (node.input == NodeInput::Resample) {
+            fuse = false;
+        }
+        if (!fuse) {
+            passes.emplace_back();
+            passes.back().scale = node.scale;
+            colorWritten = false;
+        }
+        passes.back().nodes.push_back(i);
+        colorWritten = colorWritten || node.writesColor;
+    }
+
+    for (auto &pass : passes) {
+        std::vector<std::string> functions;
+        std::string label = describeKeyFeatures(features) + " [";
+        for (size_t index : pass.nodes) {
+            functions.push_back(nodes[index].function);
+            label += (index == pass.nodes.front() ? "" : "+") + nodes[index].name;
+        }
+        label += "]";
+        pass.shader = programs.get(getKeyPassShaderSource(functions, features), label);
+        if (!pass.shader) {
+            return {};
+        }
+    }
+    return passes;
+}
+
+void EffectGraph::setPassUniforms(ofShader &shader, ofTexture &input, ofTexture &source, float time,
+                                  float beat) {
+    shader.setUniformTexture("passInput", input, 0);
+    shader.setUniformTexture("rawInput", source, 1);
+    shader.setUniform2f("inputToSource",
+                        source.getWidth() / input.getWidth(),
+                        source.getHeight() / input.getHeight());
+    shader.setUniform1f("time", time);
+    shader.setUniform1f("beat", beat);
+    lastUniformCalls += 5;
+}
+
+bool EffectGraph::render(uint32_t features, ofTexture &source, float time, float beat, uint64_t outputPixels,
+                         const std::function<void(ofTexture &)> &drawFinal) {
+    lastPassCount = 0;
+    lastUniformCalls = 0;
+    lastEffectPixels = 0;
+    lastUpscalePixels = 0;
+    const std::vector<Pass> &plan = getPlan(features);
+    if (plan.empty()) {
+        return false;
+    }
+
+    bool atOutput = processingScale <= 0.0f || !upscaleReady;
+    float baseScale = atOutput ? 1.0f : processingScale;
+    ofTexture *input = &source;
+    ofFbo *inputFbo = nullptr;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const Pass &pass = plan[i];
+        lastPassCount++;
+        if (atOutput && i + 1 == plan.size()) {
+            pass.shader->begin();
+            setPassUniforms(*pass.shader, *input, source, time, beat);
+            drawFinal(*input);
+            pass.shader->end();
+            lastEffectPixels += outputPixels;
+            break;
+        }
+
+        int w = std::max(1, static_cast<int>(std::round(source.getWidth() * baseScale * pass.scale)));
+        int h = std::max(1, static_cast<int>(std::round(source.getHeight() * baseScale * pass.scale)));
+        ofFbo &output = fbos.acquire(w, h, GL_RGBA8);
+        output.begin();
+        ofPushStyle();
+        // Straight copy: the key alpha must land in the target, not blend.
+        ofDisableBlendMode();
+        ofClear(0, 0, 0, 0);
+        pass.shader->begin();
+        setPassUniforms(*pass.shader, *input, source, time, beat);
+        input->draw(0, 0, w, h);
+        pass.shader->end();
+        ofPopStyle();
+        output.end();
+        lastEffectPixels += static_cast<uint64_t>(w) * h;
+
+        if (inputFbo) {
+            fbos.release(*inputFbo);
+        }
+        inputFbo = &output;
+        input = &output.getTexture();
+    }
+
+    if (!atOutput) {
+        upscaleShader.begin();
+        upscaleShader.setUniformTexture("tex0", *input, 0);
+        upscaleShader.setUniform1f("sharpness", upscaleSharpness);
+        lastUniformCalls += 2;
+        drawFinal(*input);
+        upscaleShader.end();
+        lastUpscalePixels = outputPixels;
+    }
+    if (inputFbo) {
+        fbos.release(*inputFbo);
+    }
+    return true;
+}
+
+std::string EffectGraph::describePlan(uint32_t features) {
+    const std::vector<Pass> &plan = getPlan(features);
+    if (plan.empty()) {
+        return "unavailable";
+    }
+    std::string description;
+    for (const auto &pass : plan) {
+        if (!description.empty()) {
+            description += " | ";
+        }
+        for (size_t index : pass.nodes) {
+            description += (index == pass.nodes.front() ? "" : "+") + nodes[index].name;
+        }
+        if (pass.scale != 1.0f) {
+            description += "@" + ofToString(pass.scale, 2);
+        }
+    }
+    if (processingScale > 0.0f && upscaleReady) {
+        description += " | upscale from " + ofToString(processingScale, 2);
+    }
+    return description;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FboPool.h"
+#include "KeyShaderCache.h"
+
+// How a node reads the image it is given.
+enum class NodeInput {
+    Pointwise,     // only the pixel being shaded
+    Neighbourhood, // also nearby pixels of the colour it was given
+    Resample,      // arbitrary positions; the incoming value is discarded
+};
+
+// One stage of the key effect. function names a GLSL node function in
+// KeyShaderSource.cpp: vec4 function(vec4 value, vec2 sourceCoord).
+struct EffectNode {
+    std::string name;
+    std::string function;
+    uint32_t features = 0;      // active if any of these KeyFeature bits is on; 0 = always
+    NodeInput input = NodeInput::Pointwise;
+    bool writesColor = true;    // false if only alpha changes
+    float scale = 1.0f;         // output resolution relative to the source
+};
+
+// Multi-pass version of the key effect. Nodes run in the order they were
+// added; a plan per KeyFeature mask groups the active nodes into passes,
+// fusing a node into the previous pass when it runs at the same scale and
+// can read that pass's value directly:
+//   - pointwise nodes always fuse;
+//   - a neighbourhood node fuses if nothing earlier in the pass changed the
+//     colour, so the pass input still holds it;
+//   - a resampling node only starts a pass.
+// Passes render into FBOs from a pool at the processing resolution (a
+// fraction of the source size, times each node's scale), and the result is
+// upscaled to wherever the caller draws it with an edge-aware sharpen. With
+// processing scale 0 the last pass instead shades straight at the output
+// size, as the single-pass key shader used to.
+class EffectGraph {
+public:
+    struct Pass {
+        std::vector<size_t> nodes; // indices into the node list
+        float scale = 1.0f;
+        ofShader *shader = nullptr;
+    };
+
+    void setup(const std::string &vertexSource);
+    void addNode(const EffectNode &node);
+    // Returns false for an unknown node name.
+    bool setNodeScale(const std::string &name, float scale);
+    void prewarm(const std::vector<uint32_t> &featureSets);
+
+    // Processing resolution relative to the source (1 = camera native), or
+    // 0 to shade the last pass at output size.
+    void setProcessingScale(float scale);
+    float getProcessingScale() const { return processingScale; }
+    // 0 = plain bilinear upscale.
+    void setUpscaleSharpness(float sharpness) { upscaleSharpness = sharpness; }
+
+    // Built and compiled on first use; empty if any pass failed to compile.
+    const std::vector<Pass> &getPlan(uint32_t features);
+
+    // Runs the plan for features on source and calls drawFinal with a
+    // texture while the shader that finishes it (the upscale, or the last
+    // pass at output size) is bound, so drawing the texture anywhere applies
+    // it. beat is the beat clock position the pulse follows. outputPixels
+    // is the area drawFinal covers, for the fill stats.
+    // Returns false (drawing nothing) if the plan could not be built.
+    bool render(uint32_t features, ofTexture &source, float time, float beat, uint64_t outputPixels,
+                const std::function<void(ofTexture &)> &drawFinal);
+
+    // "warp+key | stylize+colour", with "@0.5" after a reduced-scale pass.
+    std::string describePlan(uint32_t features);
+    size_t getCompiledCount() const { return programs.getCompiledCount(); }
+    size_t getPooledFboCount() const { return fbos.size(); }
+    uint64_t getFboAllocationCount() const { return fbos.getAllocationCount(); }
+    int getLastPassCount() const { return lastPassCount; }
+    int getLastUniformCalls() const { return lastUniformCalls; }
+    // Fragments shaded by effect passes last frame, and by the upscale.
+    uint64_t getLastEffectPixels() const { return lastEffectPixels; }
+    uint64_t getLastUpscalePixels() const { return lastUpscalePixels; }
+
+private:
+    std::vector<Pass> buildPlan(uint32_t features);
+    void setPassUniforms(ofShader &shader, ofTexture &input, ofTexture &source, float time, float beat);
+
+    std::vector<EffectNode> nodes;
+    std::map<uint32_t, std::vector<Pass>> plans;
+    KeyShaderCache programs;
+    FboPool fbos;
+    ofShader upscaleShader;
+    bool upscaleReady = false;
+    float processingScale = 1.0f;
+    float upscaleSharpness = 0.4f;
+    int lastPassCount = 0;
+    int lastUniformCalls = 0;
+    uint64_t lastEffectPixels = 0;
+    uint64_t lastUpscalePixels = 0;
+};
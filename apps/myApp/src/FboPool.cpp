@@ -0,0 +1,35 @@
+#include "FboPool.h"
+
+ofFbo &FboPool::acquire(int width, int height, int internalFormat) {
+    for (auto &entry : entries) {
+        if (!entry.inUse && entry.width == width && entry.height == height &&
+            entry.internalFormat == internalFormat) {
+            entry.inUse = true;
+            return *entry.fbo;
+        }
+    }
+
+    Entry entry;
+    entry.fbo = std::make_unique<ofFbo>();
+    entry.fbo->allocate(width, height, internalFormat);
+    entry.width = width;
+    entry.height = height;
+    entry.internalFormat = internalFormat;
+    entry.inUse = true;
+    entries.push_back(std::move(entry));
+    allocations++;
+    return *entries.back().fbo;
+}
+
+void FboPool::release(const ofFbo &fbo) {
+    for (auto &entry : entries) {
+        if (entry.fbo.get() == &fbo) {
+            entry.inUse = false;
+            return;
+        }
+    }
+}
+
+void FboPool::clear() {
+    entries.clear();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <memory>
+#include <vector>
+
+// Render targets for intermediate passes. A released FBO goes back to the
+// pool and is handed out again to the next request with the same size and
+// format, so a multi-pass chain settles on a fixed set of allocations.
+class FboPool {
+public:
+    ofFbo &acquire(int width, int height, int internalFormat);
+    void release(const ofFbo &fbo);
+    void clear();
+
+    size_t size() const { return entries.size(); }
+    // Total allocations since setup; stays flat once the pool is warm.
+    uint64_t getAllocationCount() const { return allocations; }
+
+private:
+    struct Entry {
+        std::unique_ptr<ofFbo> fbo;
+        int width = 0;
+        int height = 0;
+        int internalFormat = 0;
+        bool inUse = false;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t allocations = 0;
+};
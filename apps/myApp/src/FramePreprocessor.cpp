@@ -0,0 +1,54 @@
+#include "FramePreprocessor.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+void FramePreprocessor::setScale(float scale) {
+    this->scale = std::max(0.1f, std::min(scale, 1.0f));
+}
+
+bool FramePreprocessor::update(const ofPixels &pixels) {
+    lastError.clear();
+
+    if (!pixels.isAllocated()) {
+        lastError = "pixels not allocated";
+        return false;
+    }
+
+    int width = pixels.getWidth();
+    int height = pixels.getHeight();
+    int channels = pixels.getNumChannels();
+    if (width <= 0 || height <= 0) {
+        lastError = "invalid pixel size";
+        return false;
+    }
+
+    if (channels == 3) {
+        pyramid.rgb = cv::Mat(height, width, CV_8UC3,
+                              const_cast<unsigned char *>(pixels.getData()),
+                              pixels.getBytesStride());
+    } else if (channels == 4) {
+        cv::Mat rgba(height, width, CV_8UC4,
+                     const_cast<unsigned char *>(pixels.getData()),
+                     pixels.getBytesStride());
+        cv::cvtColor(rgba, rgbConverted, cv::COLOR_RGBA2RGB);
+        pyramid.rgb = rgbConverted;
+    } else {
+        lastError = "unsupported pixel format";
+        return false;
+    }
+
+    pyramid.width = width;
+    pyramid.height = height;
+
+    // One full-res conversion and one full-res resize; everything else works
+    // on the scaled copy.
+    cv::cvtColor(pyramid.rgb, pyramid.grayFull, cv::COLOR_RGB2GRAY);
+
+    int targetW = std::max(64, static_cast<int>(width * scale));
+    int targetH = std::max(64, static_cast<int>(height * scale));
+    cv::resize(pyramid.rgb, rgbScaled, cv::Size(targetW, targetH), 0, 0, cv::INTER_LINEAR);
+    cv::cvtColor(rgbScaled, pyramid.bgraHalf, cv::COLOR_RGB2BGRA);
+    return true;
+}
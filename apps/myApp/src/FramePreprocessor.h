@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <opencv2/core.hpp>
+
+#include <string>
+
+// Per-frame image pyramid shared by every vision consumer. All mats are
+// owned by the preprocessor and stay valid until the next update().
+struct FramePyramid {
+    cv::Mat rgb;       // full-res RGB (a view of the camera pixels when possible)
+    cv::Mat grayFull;  // full-res luma
+    cv::Mat bgraHalf;  // scaled BGRA for the Vision detectors
+    int width = 0;
+    int height = 0;
+
+    bool valid() const { return width > 0 && height > 0 && !grayFull.empty(); }
+};
+
+class FramePreprocessor {
+public:
+    void setScale(float scale);
+    float getScale() const { return scale; }
+    bool update(const ofPixels &pixels);
+    const FramePyramid &getPyramid() const { return pyramid; }
+    const std::string &getLastError() const { return lastError; }
+
+private:
+    float scale = 0.5f;
+    FramePyramid pyramid;
+    cv::Mat rgbConverted;
+    cv::Mat rgbScaled;
+    std::string lastError;
+};
@@ -0,0 +1,138 @@
+#include "FrameRing.h"
+
+FrameRef::FrameRef(const FrameRef &other)
+: ring(other.ring),
+  index(other.index) {
+    if (ring) {
+        ring->retain(index);
+    }
+}
+
+FrameRef::FrameRef(FrameRef &&other) noexcept
+: ring(other.ring),
+  index(other.index) {
+    other.ring = nullptr;
+    other.index = -1;
+}
+
+FrameRef &FrameRef::operator=(const FrameRef &other) {
+    if (this != &other) {
+        if (other.ring) {
+            other.ring->retain(other.index);
+        }
+        reset();
+        ring = other.ring;
+        index = other.index;
+    }
+    return *this;
+}
+
+FrameRef &FrameRef::operator=(FrameRef &&other) noexcept {
+    if (this != &other) {
+        reset();
+        ring = other.ring;
+        index = other.index;
+        other.ring = nullptr;
+        other.index = -1;
+    }
+    return *this;
+}
+
+FrameRef::~FrameRef() {
+    reset();
+}
+
+void FrameRef::reset() {
+    if (ring) {
+        ring->release(index);
+    }
+    ring = nullptr;
+    index = -1;
+}
+
+const CameraFrame &FrameRef::operator*() const {
+    return ring->slots[static_cast<size_t>(index)].frame;
+}
+
+const CameraFrame *FrameRef::operator->() const {
+    return &ring->slots[static_cast<size_t>(index)].frame;
+}
+
+CameraFrame *FrameRing::beginWrite() {
+    int newest = latest.load(std::memory_order_acquire);
+    int oldest = -1;
+    uint64_t oldestSequence = 0;
+    for (int i = 0; i < kCapacity; ++i) {
+        if (i == newest) {
+            continue;
+        }
+        Slot &slot = slots[static_cast<size_t>(i)];
+        if (slot.refs.load(std::memory_order_acquire) != 0) {
+            continue;
+        }
+        if (oldest < 0 || slot.frame.sequence < oldestSequence) {
+            oldest = i;
+            oldestSequence = slot.frame.sequence;
+        }
+    }
+
+    if (oldest >= 0) {
+        Slot &slot = slots[static_cast<size_t>(oldest)];
+        int expected = 0;
+        if (slot.refs.compare_exchange_strong(expected, -1, std::memory_order_acq_rel)) {
+            if (!slot.seen.load(std::memory_order_relaxed)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            writing = oldest;
+            return &slot.frame;
+        }
+    }
+
+    overruns.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void FrameRing::commitWrite(CameraFrame *frame, float captureTime) {
+    if (writing < 0 || frame != &slots[static_cast<size_t>(writing)].frame) {
+        return;
+    }
+    Slot &slot = slots[static_cast<size_t>(writing)];
+    slot.frame.sequence = nextSequence++;
+    slot.frame.captureTime = captureTime;
+    slot.seen.store(false, std::memory_order_relaxed);
+    slot.refs.store(0, std::memory_order_release);
+    latest.store(writing, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_relaxed);
+    writing = -1;
+}
+
+FrameRef FrameRing::acquireLatest() {
+    while (true) {
+        int index = latest.load(std::memory_order_acquire);
+        if (index < 0) {
+            return FrameRef();
+        }
+        Slot &slot = slots[static_cast<size_t>(index)];
+        int refs = slot.refs.load(std::memory_order_acquire);
+        while (refs >= 0) {
+            if (slot.refs.compare_exchange_weak(refs, refs + 1, std::memory_order_acq_rel)) {
+                slot.seen.store(true, std::memory_order_relaxed);
+                return FrameRef(this, index);
+            }
+        }
+        // The producer reclaimed the slot after publishing a newer frame; retry.
+    }
+}
+
+bool FrameRing::isLatestSeen() const {
+    int index = latest.load(std::memory_order_acquire);
+    return index < 0 || slots[static_cast<size_t>(index)].seen.load(std::memory_order_relaxed);
+}
+
+void FrameRing::retain(int index) {
+    slots[static_cast<size_t>(index)].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameRing::release(int index) {
+    slots[static_cast<size_t>(index)].refs.fetch_sub(1, std::memory_order_release);
+}
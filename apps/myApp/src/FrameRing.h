@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "FramePreprocessor.h"
+
+// One captured camera frame plus everything derived from it. Slots are
+// preallocated by the ring and reused; consumers only ever see them const.
+struct CameraFrame {
+    ofPixels pixels;
+    FramePreprocessor preprocessor;
+    uint64_t sequence = 0;
+    float captureTime = 0.0f;
+
+    const FramePyramid &pyramid() const { return preprocessor.getPyramid(); }
+};
+
+class FrameRing;
+
+// Borrowed reference to a ring slot. The slot cannot be reused by the
+// capture thread while any FrameRef to it is alive.
+class FrameRef {
+public:
+    FrameRef() = default;
+    FrameRef(const FrameRef &other);
+    FrameRef(FrameRef &&other) noexcept;
+    FrameRef &operator=(const FrameRef &other);
+    FrameRef &operator=(FrameRef &&other) noexcept;
+    ~FrameRef();
+
+    void reset();
+    explicit operator bool() const { return ring != nullptr; }
+    const CameraFrame &operator*() const;
+    const CameraFrame *operator->() const;
+
+private:
+    friend class FrameRing;
+    FrameRef(FrameRing *ring, int index) : ring(ring), index(index) {}
+
+    FrameRing *ring = nullptr;
+    int index = -1;
+};
+
+// Fixed ring of reference-counted frame buffers filled by a single producer.
+// Under back-pressure the oldest unborrowed slot is overwritten; if every
+// slot is borrowed the incoming frame is dropped instead.
+class FrameRing {
+public:
+    static constexpr int kCapacity = 8;
+
+    CameraFrame *beginWrite();
+    void commitWrite(CameraFrame *frame, float captureTime);
+    FrameRef acquireLatest();
+    // True once the newest published frame has been borrowed at least once.
+    bool isLatestSeen() const;
+
+    uint64_t getPublishedCount() const { return published.load(std::memory_order_relaxed); }
+    uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t getOverrunCount() const { return overruns.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameRef;
+
+    struct Slot {
+        CameraFrame frame;
+        // >= 0: number of borrowers, -1: being written by the producer.
+        std::atomic<int> refs{0};
+        std::atomic<bool> seen{true};
+    };
+
+    void retain(int index);
+    void release(int index);
+
+    std::array<Slot, kCapacity> slots;
+    std::atomic<int> latest{-1};
+    int writing = -1;
+    uint64_t nextSequence = 1;
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> overruns{0};
+};
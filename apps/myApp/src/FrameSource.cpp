@@ -0,0 +1,211 @@
+#include "FrameSource.h"
+
+#include <algorithm>
+#include <cmath>
+
+WebcamSource::WebcamSource(int deviceId, int width, int height, int fps)
+: deviceId(deviceId),
+  width(width),
+  height(height),
+  fps(fps) {}
+
+std::vector<ofVideoDevice> WebcamSource::listDevices() {
+    ofVideoGrabber lister;
+    return lister.listDevices();
+}
+
+bool WebcamSource::open() {
+    // Textures are uploaded by the render thread from the borrowed frame.
+    grabber.setUseTexture(false);
+    grabber.setDeviceID(deviceId);
+    grabber.setDesiredFrameRate(fps);
+    grabber.setPixelFormat(OF_PIXELS_RGB);
+    return grabber.setup(width, height, false);
+}
+
+void WebcamSource::close() {
+    if (grabber.isInitialized()) {
+        grabber.close();
+    }
+}
+
+bool WebcamSource::update() {
+    grabber.update();
+    if (!grabber.isFrameNew()) {
+        return false;
+    }
+    const ofPixels &src = grabber.getPixels();
+    pixels.setFromPixels(src.getData(), src.getWidth(), src.getHeight(), src.getNumChannels());
+    return true;
+}
+
+std::string WebcamSource::describe() const {
+    return "cam:" + ofToString(deviceId);
+}
+
+VideoFileSource::VideoFileSource(const std::string &path, bool loop)
+: path(path),
+  loop(loop) {}
+
+bool VideoFileSource::open() {
+    player.setUseTexture(false);
+    if (!player.load(path)) {
+        return false;
+    }
+    player.setLoopState(loop ? OF_LOOP_NORMAL : OF_LOOP_NONE);
+    // Frames are stepped explicitly so pacing is owned by the capture thread.
+    player.play();
+    player.setPaused(true);
+    player.setFrame(0);
+    finished = false;
+    lastFrame = -1;
+    stepPending = false;
+    return true;
+}
+
+void VideoFileSource::close() {
+    player.close();
+}
+
+bool VideoFileSource::update() {
+    if (finished) {
+        return false;
+    }
+    if (!stepPending) {
+        if (lastFrame >= 0) {
+            int total = player.getTotalNumFrames();
+            if (total > 0 && lastFrame + 1 >= total) {
+                if (!loop) {
+                    finished = true;
+                    return false;
+                }
+                player.setFrame(0);
+            } else {
+                player.nextFrame();
+            }
+        }
+        stepPending = true;
+    }
+    player.update();
+    if (!player.isFrameNew()) {
+        // The step hasn't been decoded yet; poll again rather than step past it.
+        return false;
+    }
+    stepPending = false;
+    lastFrame = player.getCurrentFrame();
+    const ofPixels &src = player.getPixels();
+    if (!src.isAllocated()) {
+        return false;
+    }
+    pixels.setFromPixels(src.getData(), src.getWidth(), src.getHeight(), src.getNumChannels());
+    return true;
+}
+
+ImageSequenceSource::ImageSequenceSource(const std::string &directory, bool loop)
+: directory(directory),
+  loop(loop) {}
+
+bool ImageSequenceSource::open() {
+    ofDirectory dir(directory);
+    dir.allowExt("png");
+    dir.allowExt("jpg");
+    dir.allowExt("jpeg");
+    dir.allowExt("tif");
+    dir.allowExt("bmp");
+    dir.listDir();
+    dir.sort();
+    files.clear();
+    for (size_t i = 0; i < dir.size(); ++i) {
+        files.push_back(dir.getPath(i));
+    }
+    nextIndex = 0;
+    finished = false;
+    return !files.empty();
+}
+
+bool ImageSequenceSource::update() {
+    if (finished || files.empty()) {
+        return false;
+    }
+    if (nextIndex >= files.size()) {
+        if (!loop) {
+            finished = true;
+            return false;
+        }
+        nextIndex = 0;
+    }
+    const std::string &file = files[nextIndex++];
+    if (!ofLoadImage(pixels, file)) {
+        ofLogWarning() << "Image sequence: failed to load " << file;
+        return false;
+    }
+    if (pixels.getNumChannels() == 1) {
+        ofLogWarning() << "Image sequence: skipping grayscale frame " << file;
+        return false;
+    }
+    return true;
+}
+
+SyntheticSource::SyntheticSource(int width, int height)
+: width(width),
+  height(height) {}
+
+bool SyntheticSource::open() {
+    pixels.allocate(width, height, OF_PIXELS_RGB);
+    frameIndex = 0;
+    return width > 0 && height > 0;
+}
+
+bool SyntheticSource::update() {
+    float t = static_cast<float>(frameIndex++) / 30.0f;
+    int blockW = width / 5;
+    int blockH = height / 3;
+    int blockX = static_cast<int>((0.5f + 0.4f * std::sin(t * 0.7f)) * (width - blockW));
+    int blockY = height / 3;
+    float discX = (0.5f + 0.45f * std::cos(t * 1.3f)) * width;
+    float discY = (0.5f + 0.35f * std::sin(t * 0.9f)) * height;
+    float discR2 = static_cast<float>(height * height) / 64.0f;
+
+    unsigned char *data = pixels.getData();
+    size_t stride = pixels.getBytesStride();
+    for (int y = 0; y < height; ++y) {
+        unsigned char *row = data + stride * y;
+        bool inBlockRow = y >= blockY && y < blockY + blockH;
+        for (int x = 0; x < width; ++x) {
+            unsigned char *px = row + x * 3;
+            float dx = x - discX;
+            float dy = y - discY;
+            if (dx * dx + dy * dy < discR2) {
+                px[0] = 250;
+                px[1] = 220;
+                px[2] = 120;
+            } else if (inBlockRow && x >= blockX && x < blockX + blockW) {
+                px[0] = 30;
+                px[1] = 200;
+                px[2] = 40;
+            } else {
+                px[0] = static_cast<unsigned char>((x * 255) / std::max(1, width - 1));
+                px[1] = static_cast<unsigned char>((y * 160) / std::max(1, height - 1));
+                px[2] = static_cast<unsigned char>(128 + 100 * std::sin(t + x * 0.01f));
+            }
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<FrameSource> createFrameSource(const std::string &spec, const FrameSourceSettings &settings) {
+    auto value = [&](const std::string &prefix) { return spec.substr(prefix.size()); };
+    if (spec.empty() || spec == "cam") {
+        return std::make_unique<WebcamSource>(settings.camDeviceId, settings.width, settings.height, settings.fps);
+    }
+    if (spec.rfind("video:", 0) == 0) {
+        return std::make_unique<VideoFileSource>(value("video:"), settings.loop);
+    }
+    if (spec.rfind("images:", 0) == 0) {
+        return std::make_unique<ImageSequenceSource>(value("images:"), settings.loop);
+    }
+    if (spec == "synthetic") {
+        return std::make_unique<SyntheticSource>(settings.width, settings.height);
+    }
+    return nullptr;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Where camera frames come from. update()/getPixels() are called from the
+// capture thread only; open() runs on the thread that starts the capture.
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    virtual bool open() = 0;
+    virtual void close() {}
+    // Advances the source; returns true when getPixels() holds a new frame.
+    virtual bool update() = 0;
+    virtual const ofPixels &getPixels() const = 0;
+    // Device sources deliver frames on their own clock and are never paced.
+    virtual bool isDevicePaced() const { return false; }
+    virtual bool isFinished() const { return false; }
+    virtual std::string describe() const = 0;
+};
+
+class WebcamSource : public FrameSource {
+public:
+    WebcamSource(int deviceId, int width, int height, int fps);
+
+    static std::vector<ofVideoDevice> listDevices();
+
+    bool open() override;
+    void close() override;
+    bool update() override;
+    const ofPixels &getPixels() const override { return pixels; }
+    bool isDevicePaced() const override { return true; }
+    std::string describe() const override;
+
+private:
+    ofVideoGrabber grabber;
+    ofPixels pixels;
+    int deviceId = 0;
+    int width = 0;
+    int height = 0;
+    int fps = 30;
+};
+
+class VideoFileSource : public FrameSource {
+public:
+    VideoFileSource(const std::string &path, bool loop);
+
+    bool open() override;
+    void close() override;
+    bool update() override;
+    const ofPixels &getPixels() const override { return pixels; }
+    bool isFinished() const override { return finished; }
+    std::string describe() const override { return "video:" + path; }
+
+private:
+    ofVideoPlayer player;
+    ofPixels pixels;
+    std::string path;
+    bool loop = true;
+    bool finished = false;
+    int lastFrame = -1;
+    bool stepPending = false; // stepped, waiting for isFrameNew()
+};
+
+class ImageSequenceSource : public FrameSource {
+public:
+    ImageSequenceSource(const std::string &directory, bool loop);
+
+    bool open() override;
+    bool update() override;
+    const ofPixels &getPixels() const override { return pixels; }
+    bool isFinished() const override { return finished; }
+    std::string describe() const override { return "images:" + directory; }
+
+private:
+    std::vector<std::string> files;
+    ofPixels pixels;
+    std::string directory;
+    bool loop = true;
+    bool finished = false;
+    size_t nextIndex = 0;
+};
+
+// Deterministic moving test pattern: a colour gradient, a green key block
+// and a bright disc crossing the frame, so every stage has work to do.
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(int width, int height);
+
+    bool open() override;
+    bool update() override;
+    const ofPixels &getPixels() const override { return pixels; }
+    std::string describe() const override { return "synthetic"; }
+
+private:
+    ofPixels pixels;
+    int width = 0;
+    int height = 0;
+    uint64_t frameIndex = 0;
+};
+
+struct FrameSourceSettings {
+    int camDeviceId = 0;
+    int width = 1280;
+    int height = 720;
+    int fps = 30;
+    bool loop = true;
+};
+
+// spec is "cam", "video:<path>", "images:<dir>" or "synthetic".
+std::unique_ptr<FrameSource> createFrameSource(const std::string &spec, const FrameSourceSettings &settings);
@@ -0,0 +1,80 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+
+namespace {
+// Exponential smoothing over roughly the last 20 frames.
+constexpr double kAverageWeight = 0.05;
+}
+
+FrameStats::Id FrameStats::addCounter(const std::string &name) {
+    return addEntry(name, Kind::Counter);
+}
+
+FrameStats::Id FrameStats::addTimer(const std::string &name) {
+    return addEntry(name, Kind::Timer);
+}
+
+FrameStats::Id FrameStats::addLatency(const std::string &name) {
+    Id id = addEntry(name, Kind::Latency);
+    entries[id].samples.reserve(kWindow);
+    return id;
+}
+
+FrameStats::Id FrameStats::addEntry(const std::string &name, Kind kind) {
+    Entry entry;
+    entry.name = name;
+    entry.kind = kind;
+    entries.push_back(entry);
+    return entries.size() - 1;
+}
+
+void FrameStats::addSample(Id id, uint64_t micros) {
+    Entry &entry = entries[id];
+    if (entry.samples.size() < kWindow) {
+        entry.samples.push_back(micros);
+    } else {
+        entry.samples[entry.nextSample] = micros;
+    }
+    entry.nextSample = (entry.nextSample + 1) % kWindow;
+}
+
+uint64_t FrameStats::getPercentile(Id id, double p) const {
+    std::vector<uint64_t> sorted = entries[id].samples;
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(std::min(1.0, std::max(0.0, p)) * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+void FrameStats::endFrame() {
+    for (auto &entry : entries) {
+        entry.last = entry.current;
+        entry.average += (static_cast<double>(entry.current) - entry.average) * kAverageWeight;
+        entry.current = 0;
+    }
+}
+
+std::vector<std::string> FrameStats::describe() const {
+    std::vector<std::string> lines;
+    lines.reserve(entries.size());
+    for (size_t id = 0; id < entries.size(); ++id) {
+        const Entry &entry = entries[id];
+        if (entry.kind == Kind::Latency) {
+            if (!entry.samples.empty()) {
+                lines.push_back(entry.name + ": p50 " + ofToString(getPercentile(id, 0.5) / 1000.0, 1) + "ms p95 " +
+                                ofToString(getPercentile(id, 0.95) / 1000.0, 1) + "ms p99 " +
+                                ofToString(getPercentile(id, 0.99) / 1000.0, 1) + "ms");
+            }
+        } else if (entry.kind == Kind::Timer) {
+            lines.push_back(entry.name + ": " + ofToString(entry.last / 1000.0, 2) + "ms (avg " +
+                            ofToString(entry.average / 1000.0, 2) + ")");
+        } else {
+            lines.push_back(entry.name + ": " + ofToString(entry.last) + " (avg " +
+                            ofToString(entry.average, 1) + ")");
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <string>
+#include <vector>
+
+// Per-frame counters and stage timings for the stats overlay (`i`) and the
+// settings log. Stats are registered once and then addressed by id, so the
+// per-frame cost is an add. Render thread only.
+class FrameStats {
+public:
+    using Id = size_t;
+
+    Id addCounter(const std::string &name);
+    // Accumulates microseconds; shown in milliseconds.
+    Id addTimer(const std::string &name);
+    // Keeps the last kWindow microsecond samples, across frames, and shows
+    // their percentiles in milliseconds.
+    Id addLatency(const std::string &name);
+
+    void add(Id id, uint64_t amount = 1) { entries[id].current += amount; }
+    void addSample(Id id, uint64_t micros);
+
+    // Latches this frame's values and starts the next frame at zero.
+    void endFrame();
+
+    uint64_t getLast(Id id) const { return entries[id].last; }
+    double getAverage(Id id) const { return entries[id].average; }
+    // p in [0, 1]; 0 if nothing was sampled.
+    uint64_t getPercentile(Id id, double p) const;
+    size_t getSampleCount(Id id) const { return entries[id].samples.size(); }
+    // "name: last (avg)" per stat.
+    std::vector<std::string> describe() const;
+
+    class ScopedTimer {
+    public:
+        ScopedTimer(FrameStats &stats, Id id)
+        : stats(stats),
+          id(id),
+          start(ofGetElapsedTimeMicros()) {}
+        ~ScopedTimer() { stats.add(id, ofGetElapsedTimeMicros() - start); }
+
+    private:
+        FrameStats &stats;
+        Id id;
+        uint64_t start;
+    };
+
+    static constexpr size_t kWindow = 256;
+
+private:
+    enum class Kind {
+        Counter,
+        Timer,
+        Latency
+    };
+
+    struct Entry {
+        std::string name;
+        Kind kind = Kind::Counter;
+        uint64_t current = 0;
+        uint64_t last = 0;
+        double average = 0.0;
+        std::vector<uint64_t> samples; // latency only, a ring once full
+        size_t nextSample = 0;
+    };
+
+    Id addEntry(const std::string &name, Kind kind);
+
+    std::vector<Entry> entries;
+};
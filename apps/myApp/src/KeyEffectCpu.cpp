@@ -0,0 +1,703 @@
+#include "KeyEffectCpu.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+
+#include "SimdFloat.h"
+
+namespace {
+struct Vec3 {
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b) { return {a.r + b.r, a.g + b.g, a.b + b.b}; }
+Vec3 operator+(Vec3 a, float s) { return {a.r + s, a.g + s, a.b + s}; }
+Vec3 operator*(Vec3 a, Vec3 b) { return {a.r * b.r, a.g * b.g, a.b * b.b}; }
+Vec3 operator*(Vec3 a, float s) { return {a.r * s, a.g * s, a.b * s}; }
+
+float clampf(float v, float lo, float hi) { return std::min(std::max(v, lo), hi); }
+float fract(float v) { return v - std::floor(v); }
+float mixf(float a, float b, float t) { return a + (b - a) * t; }
+Vec3 mix(Vec3 a, Vec3 b, float t) { return {mixf(a.r, b.r, t), mixf(a.g, b.g, t), mixf(a.b, b.b, t)}; }
+float stepf(float edge, float x) { return x < edge ? 0.0f : 1.0f; }
+float glslMod(float x, float y) { return x - y * std::floor(x / y); }
+
+float smoothstep(float e0, float e1, float x) {
+    float t = clampf((x - e0) / (e1 - e0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+float luma(Vec3 c) {
+    return c.r * 0.299f + c.g * 0.587f + c.b * 0.114f;
+}
+
+// Same branch-free formulation as the shader's rgb2hsv/hsv2rgb.
+Vec3 rgb2hsv(Vec3 c) {
+    float kx = 0.0f, ky = -1.0f / 3.0f, kz = 2.0f / 3.0f, kw = -1.0f;
+    float s1 = stepf(c.b, c.g);
+    float px = mixf(c.b, c.g, s1);
+    float py = mixf(c.g, c.b, s1);
+    float pz = mixf(kw, kx, s1);
+    float pw = mixf(kz, ky, s1);
+    float s2 = stepf(px, c.r);
+    float qx = mixf(px, c.r, s2);
+    float qy = mixf(py, py, s2);
+    float qz = mixf(pw, pz, s2);
+    float qw = mixf(c.r, px, s2);
+    float d = qx - std::min(qw, qy);
+    float e = 1e-10f;
+    return {std::abs(qz + (qw - qy) / (6.0f * d + e)), d / (qx + e), qx};
+}
+
+Vec3 hsv2rgb(Vec3 c) {
+    auto channel = [&](float k) {
+        float p = std::abs(fract(c.r + k) * 6.0f - 3.0f);
+        return c.b * mixf(1.0f, clampf(p - 1.0f, 0.0f, 1.0f), c.g);
+    };
+    return {channel(1.0f), channel(2.0f / 3.0f), channel(1.0f / 3.0f)};
+}
+
+// GL_LINEAR lookup in a rectangle texture with clamp-to-edge addressing.
+Vec3 sample(const cv::Mat &rgb, float x, float y) {
+    float fx = x - 0.5f;
+    float fy = y - 0.5f;
+    float x0f = std::floor(fx);
+    float y0f = std::floor(fy);
+    float tx = fx - x0f;
+    float ty = fy - y0f;
+    int maxX = rgb.cols - 1;
+    int maxY = rgb.rows - 1;
+    int x0 = std::min(std::max(static_cast<int>(x0f), 0), maxX);
+    int y0 = std::min(std::max(static_cast<int>(y0f), 0), maxY);
+    int x1 = std::min(std::max(static_cast<int>(x0f) + 1, 0), maxX);
+    int y1 = std::min(std::max(static_cast<int>(y0f) + 1, 0), maxY);
+    const unsigned char *r0 = rgb.ptr<unsigned char>(y0);
+    const unsigned char *r1 = rgb.ptr<unsigned char>(y1);
+    auto texel = [](const unsigned char *row, int x) {
+        const unsigned char *p = row + x * 3;
+        return Vec3{p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f};
+    };
+    Vec3 top = mix(texel(r0, x0), texel(r0, x1), tx);
+    Vec3 bottom = mix(texel(r1, x0), texel(r1, x1), tx);
+    return mix(top, bottom, ty);
+}
+
+unsigned char toByte(float v) {
+    return static_cast<unsigned char>(clampf(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void allocateOutput(ofPixels &dst, int w, int h) {
+    if (static_cast<int>(dst.getWidth()) != w ||
+        static_cast<int>(dst.getHeight()) != h ||
+        dst.getNumChannels() != 4) {
+        dst.allocate(w, h, OF_PIXELS_RGBA);
+    }
+}
+
+// Per-frame values the shader recomputes for every fragment.
+struct FrameConstants {
+    float texW;
+    float texH;
+    float boostedKick;
+    float pulse;
+    float mixAmount;
+    float centerX;
+    float centerY;
+    float zoom;
+    float sector;
+    float spinAngle;
+    float maxR;
+    float cell;
+    float safeLevels;
+
+    FrameConstants(const KeyEffectParams &p, int w, int h) {
+        texW = static_cast<float>(w);
+        texH = static_cast<float>(h);
+        float phase = fract(p.beat);
+        float attack = std::max(0.001f, p.pulseAttack);
+        float decay = std::max(0.001f, p.pulseDecay);
+        float ramp = smoothstep(0.0f, attack, phase);
+        float fall = (phase <= attack) ? 1.0f : std::exp(-(phase - attack) * decay);
+        float kick = ramp * fall;
+        boostedKick = std::min(1.0f, kick * p.pulseHueBoost);
+        pulse = 1.0f + (p.pulseAmount * boostedKick);
+        mixAmount = clampf(p.wetMix, 0.0f, 1.0f);
+        centerX = texW * 0.5f;
+        centerY = texH * 0.5f;
+        zoom = clampf(p.kaleidoZoom, 0.1f, 1.0f);
+        sector = 6.2831853f / std::max(1.0f, p.kaleidoSegments);
+        spinAngle = p.kaleidoSpin * p.time;
+        maxR = std::max(1.0f, std::min(texW, texH) * 0.5f);
+        cell = std::max(2.0f, p.halftoneScale);
+        safeLevels = std::max(p.levels, 2.0f);
+    }
+};
+} // namespace
+
+void renderKeyEffectReference(const cv::Mat &rgb, const KeyEffectParams &params, ofPixels &dst) {
+    int w = rgb.cols;
+    int h = rgb.rows;
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    allocateOutput(dst, w, h);
+
+    const KeyEffectParams &p = params;
+    FrameConstants k(p, w, h);
+
+    auto texel = [&](int x, int y) {
+        const unsigned char *px = rgb.ptr<unsigned char>(y) + x * 3;
+        return Vec3{px[0] / 255.0f, px[1] / 255.0f, px[2] / 255.0f};
+    };
+
+    // Warp node: its own pass, so the nodes after it see the warped image.
+    std::vector<Vec3> warped;
+    bool warp = p.kaleidoOn || p.wooferOn;
+    if (warp) {
+        warped.resize(static_cast<size_t>(w) * h);
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                float cx = x + 0.5f;
+                float cy = y + 0.5f;
+
+                if (p.kaleidoOn) {
+                    float px = (cx - k.centerX) * k.zoom;
+                    float py = (cy - k.centerY) * k.zoom;
+                    float r = std::sqrt(px * px + py * py);
+                    float angle = std::atan2(py, px) + k.spinAngle;
+                    angle = glslMod(angle, k.sector);
+                    angle = std::abs(angle - k.sector * 0.5f);
+                    cx = std::cos(angle) * r + k.centerX;
+                    cy = std::sin(angle) * r + k.centerY;
+                }
+
+                if (p.wooferOn) {
+                    float px = cx - k.centerX;
+                    float py = cy - k.centerY;
+                    float rNorm = std::sqrt(px * px + py * py) / k.maxR;
+                    float falloff = std::pow(clampf(1.0f - rNorm, 0.0f, 1.0f), p.wooferFalloff);
+                    float bulge = 1.0f + (p.wooferStrength * k.boostedKick * falloff);
+                    cx = k.centerX + px * bulge;
+                    cy = k.centerY + py * bulge;
+                }
+
+                cx = clampf(cx, 0.0f, k.texW - 1.0f);
+                cy = clampf(cy, 0.0f, k.texH - 1.0f);
+                warped[static_cast<size_t>(y) * w + x] = sample(rgb, cx, cy);
+            }
+        }
+    }
+    // The pass input at a texel centre, clamped to the edge.
+    auto input = [&](int x, int y) {
+        x = std::min(x, w - 1);
+        y = std::min(y, h - 1);
+        return warp ? warped[static_cast<size_t>(y) * w + x] : texel(x, y);
+    };
+
+    unsigned char *out = dst.getData();
+    for (int y = 0; y < h; ++y) {
+        unsigned char *row = out + static_cast<size_t>(y) * w * 4;
+        for (int x = 0; x < w; ++x) {
+            float cx = x + 0.5f;
+            float cy = y + 0.5f;
+            Vec3 color = input(x, y);
+            Vec3 rawColor = texel(x, y);
+
+            // Key node.
+            Vec3 hsv = rgb2hsv(color);
+            float hueDist = std::abs(hsv.r - p.keyHue);
+            hueDist = std::min(hueDist, 1.0f - hueDist);
+            float hueOk = 1.0f - smoothstep(p.keyHueRange, p.keyHueRange + 0.02f, hueDist);
+            float satOk = smoothstep(p.keyMinSat, p.keyMinSat + 0.05f, hsv.g);
+            float valOk = smoothstep(p.keyMinVal, p.keyMinVal + 0.05f, hsv.b);
+            float alpha = 1.0f - hueOk * satOk * valOk;
+
+            // Stylize node.
+            float dotMask = 1.0f;
+            if (p.halftoneOn) {
+                float cellX = (std::floor(cx / k.cell) + 0.5f) * k.cell;
+                float cellY = (std::floor(cy / k.cell) + 0.5f) * k.cell;
+                float ox = cx - cellX;
+                float oy = cy - cellY;
+                float radius = (1.0f - luma(color)) * 0.5f * k.cell;
+                float edge = std::max(0.001f, radius * p.halftoneEdge);
+                float dist = std::sqrt(ox * ox + oy * oy);
+                dotMask = 1.0f - smoothstep(radius - edge, radius + edge, dist);
+            }
+
+            Vec3 poster = {std::floor(color.r * k.safeLevels) / (k.safeLevels - 1.0f),
+                           std::floor(color.g * k.safeLevels) / (k.safeLevels - 1.0f),
+                           std::floor(color.b * k.safeLevels) / (k.safeLevels - 1.0f)};
+
+            float lumC = luma(color);
+            float lumR = luma(input(x + 1, y));
+            float lumU = luma(input(x, y + 1));
+            float edge = std::abs(lumC - lumR) + std::abs(lumC - lumU);
+
+            Vec3 c = mix(color, poster, 0.85f);
+            c = c + p.edgeStrength * edge;
+
+            // Colour node.
+            c = c * k.pulse;
+            c = mix(c, c * Vec3{1.1f, 0.85f, 1.2f}, p.pulseColorize * k.boostedKick);
+            if (std::abs(p.pulseHueMode) > 0.5f) {
+                Vec3 hsvOut = rgb2hsv(c);
+                float shift = (p.pulseHueShift / 360.0f) * k.boostedKick;
+                hsvOut.r = p.pulseHueMode > 0.0f ? fract(hsvOut.r - shift) : fract(hsvOut.r + shift);
+                c = hsv2rgb(hsvOut);
+            }
+            if (p.satOn) {
+                Vec3 hsvSat = rgb2hsv(c);
+                hsvSat.g = clampf(hsvSat.g * p.satScale, 0.0f, 1.0f);
+                c = hsv2rgb(hsvSat);
+            }
+            c = {clampf(c.r, 0.0f, 1.0f), clampf(c.g, 0.0f, 1.0f), clampf(c.b, 0.0f, 1.0f)};
+
+            float processedAlpha = alpha * dotMask;
+            Vec3 processedPremul = c * processedAlpha;
+            Vec3 outColor = mix(rawColor, processedPremul, k.mixAmount);
+            float outAlpha = mixf(1.0f, processedAlpha, k.mixAmount);
+
+            unsigned char *px = row + x * 4;
+            px[0] = toByte(outColor.r);
+            px[1] = toByte(outColor.g);
+            px[2] = toByte(outColor.b);
+            px[3] = toByte(outAlpha);
+        }
+    }
+}
+
+namespace {
+using simd::Float;
+using simd::Mask;
+
+struct Rgb {
+    Float r;
+    Float g;
+    Float b;
+};
+
+struct Planes {
+    const float *r;
+    const float *g;
+    const float *b;
+    const float *luma;
+    int width;
+    int height;
+};
+
+struct WarpTarget {
+    float *r;
+    float *g;
+    float *b;
+    float *luma;
+};
+
+Rgb mix(const Rgb &a, const Rgb &b, Float t) {
+    return {simd::mix(a.r, b.r, t), simd::mix(a.g, b.g, t), simd::mix(a.b, b.b, t)};
+}
+
+Float luma(const Rgb &c) {
+    return c.r * simd::set(0.299f) + c.g * simd::set(0.587f) + c.b * simd::set(0.114f);
+}
+
+Rgb rgb2hsv(const Rgb &c) {
+    Float s1 = simd::step(c.b, c.g);
+    Float px = simd::mix(c.b, c.g, s1);
+    Float py = simd::mix(c.g, c.b, s1);
+    Float pz = simd::mix(simd::set(-1.0f), simd::set(0.0f), s1);
+    Float pw = simd::mix(simd::set(2.0f / 3.0f), simd::set(-1.0f / 3.0f), s1);
+    Float s2 = simd::step(px, c.r);
+    Float qx = simd::mix(px, c.r, s2);
+    Float qy = py;
+    Float qz = simd::mix(pw, pz, s2);
+    Float qw = simd::mix(c.r, px, s2);
+    Float d = qx - simd::min(qw, qy);
+    Float e = simd::set(1e-10f);
+    return {simd::abs(qz + (qw - qy) / (simd::set(6.0f) * d + e)), d / (qx + e), qx};
+}
+
+Rgb hsv2rgb(const Rgb &c) {
+    auto channel = [&](float k) {
+        Float p = simd::abs(simd::fract(c.r + simd::set(k)) * simd::set(6.0f) - simd::set(3.0f));
+        Float q = simd::clamp(p - simd::set(1.0f), simd::set(0.0f), simd::set(1.0f));
+        return c.b * simd::mix(simd::set(1.0f), q, c.g);
+    };
+    return {channel(1.0f), channel(2.0f / 3.0f), channel(1.0f / 3.0f)};
+}
+
+struct Taps {
+    simd::Int i00;
+    simd::Int i10;
+    simd::Int i01;
+    simd::Int i11;
+    Float tx;
+    Float ty;
+};
+
+// Indices and weights of the GL_LINEAR footprint, as in sample() above.
+Taps bilinearTaps(const Planes &planes, Float x, Float y) {
+    Float fx = x - simd::set(0.5f);
+    Float fy = y - simd::set(0.5f);
+    Float x0f = simd::floor(fx);
+    Float y0f = simd::floor(fy);
+    Float maxX = simd::set(static_cast<float>(planes.width - 1));
+    Float maxY = simd::set(static_cast<float>(planes.height - 1));
+    Float zero = simd::set(0.0f);
+    Float one = simd::set(1.0f);
+    Float x0 = simd::clamp(x0f, zero, maxX);
+    Float x1 = simd::clamp(x0f + one, zero, maxX);
+    Float w = simd::set(static_cast<float>(planes.width));
+    // Offsets stay well inside float's exact integer range.
+    Float row0 = simd::clamp(y0f, zero, maxY) * w;
+    Float row1 = simd::clamp(y0f + one, zero, maxY) * w;
+    return {simd::toInt(row0 + x0), simd::toInt(row0 + x1),
+            simd::toInt(row1 + x0), simd::toInt(row1 + x1),
+            fx - x0f, fy - y0f};
+}
+
+Float samplePlane(const float *plane, const Taps &t) {
+    Float top = simd::mix(simd::gather(plane, t.i00), simd::gather(plane, t.i10), t.tx);
+    Float bottom = simd::mix(simd::gather(plane, t.i01), simd::gather(plane, t.i11), t.tx);
+    return simd::mix(top, bottom, t.ty);
+}
+
+Rgb sample(const Planes &planes, Float x, Float y) {
+    Taps t = bilinearTaps(planes, x, y);
+    return {samplePlane(planes.r, t), samplePlane(planes.g, t), samplePlane(planes.b, t)};
+}
+
+// Texel (x + lane, y), clamped to the image like GL_CLAMP_TO_EDGE at texel
+// centres. A plain load unless the block runs off the end of the row.
+Float loadTexels(const float *plane, const Planes &planes, int x, int y) {
+    const float *row = plane + static_cast<size_t>(std::min(y, planes.height - 1)) * planes.width;
+    if (x + simd::kLanes <= planes.width) {
+        return simd::load(row + x);
+    }
+    Float xs = simd::min(simd::set(static_cast<float>(x)) + simd::iota(),
+                         simd::set(static_cast<float>(planes.width - 1)));
+    return simd::gather(row, simd::toInt(xs));
+}
+
+Rgb loadTexels(const Planes &planes, int x, int y) {
+    return {loadTexels(planes.r, planes, x, y), loadTexels(planes.g, planes, x, y),
+            loadTexels(planes.b, planes, x, y)};
+}
+
+// Stores the first count lanes of v at dst.
+void storeLanes(float *dst, Float v, int count) {
+    if (count == simd::kLanes) {
+        simd::store(dst, v);
+        return;
+    }
+    float lanes[simd::kLanes];
+    simd::store(lanes, v);
+    std::copy(lanes, lanes + count, dst);
+}
+
+constexpr uint32_t kWarpFeatures = KeyFeature::Kaleido | KeyFeature::Woofer;
+
+// Warp node: resamples the source at the kaleidoscope/woofer coordinate of
+// simd::kLanes pixels of row y starting at x, into the warped planes.
+// Features (KeyFeature bits) selects the stages at compile time, like the
+// shader's KEY_* defines.
+template <uint32_t Features>
+void warpBlock(const Planes &source, const WarpTarget &warped, const KeyEffectParams &p,
+               const FrameConstants &k, int x, int y, int count) {
+    using simd::set;
+    Float zero = set(0.0f);
+    Float one = set(1.0f);
+
+    Float cx = set(x + 0.5f) + simd::iota();
+    Float cy = set(y + 0.5f);
+    Float centerX = set(k.centerX);
+    Float centerY = set(k.centerY);
+
+    if constexpr ((Features & KeyFeature::Kaleido) != 0) {
+        Float px = (cx - centerX) * set(k.zoom);
+        Float py = (cy - centerY) * set(k.zoom);
+        Float r = simd::sqrt(px * px + py * py);
+        Float angle = simd::atan2(py, px) + set(k.spinAngle);
+        angle = simd::mod(angle, set(k.sector));
+        angle = simd::abs(angle - set(k.sector * 0.5f));
+        Float s;
+        Float c;
+        simd::sincos(angle, s, c);
+        cx = c * r + centerX;
+        cy = s * r + centerY;
+    }
+
+    if constexpr ((Features & KeyFeature::Woofer) != 0) {
+        Float px = cx - centerX;
+        Float py = cy - centerY;
+        Float rNorm = simd::sqrt(px * px + py * py) / set(k.maxR);
+        Float falloff = simd::pow(simd::clamp(one - rNorm, zero, one), set(p.wooferFalloff));
+        Float bulge = one + set(p.wooferStrength * k.boostedKick) * falloff;
+        cx = centerX + px * bulge;
+        cy = centerY + py * bulge;
+    }
+
+    cx = simd::clamp(cx, zero, set(k.texW - 1.0f));
+    cy = simd::clamp(cy, zero, set(k.texH - 1.0f));
+    Rgb color = sample(source, cx, cy);
+
+    size_t offset = static_cast<size_t>(y) * source.width + x;
+    storeLanes(warped.r + offset, color.r, count);
+    storeLanes(warped.g + offset, color.g, count);
+    storeLanes(warped.b + offset, color.b, count);
+    storeLanes(warped.luma + offset, luma(color), count);
+}
+
+// Key, stylize and colour nodes for simd::kLanes pixels of row y starting at
+// x, reading the pass input (source or warped planes) at texel centres and
+// the source for the wet/dry mix. Only count pixels are written.
+template <uint32_t Features>
+void shadeBlock(const Planes &input, const Planes &source, const KeyEffectParams &p,
+                const FrameConstants &k, int x, int y, int count, unsigned char *out) {
+    using simd::set;
+    Float zero = set(0.0f);
+    Float one = set(1.0f);
+
+    Rgb color = loadTexels(input, x, y);
+    Rgb rawColor = loadTexels(source, x, y);
+
+    Rgb hsv = rgb2hsv(color);
+    Float hueDist = simd::abs(hsv.r - set(p.keyHue));
+    hueDist = simd::min(hueDist, one - hueDist);
+    Float hueOk = one - simd::smoothstep(set(p.keyHueRange), set(p.keyHueRange + 0.02f), hueDist);
+    Float satOk = simd::smoothstep(set(p.keyMinSat), set(p.keyMinSat + 0.05f), hsv.g);
+    Float valOk = simd::smoothstep(set(p.keyMinVal), set(p.keyMinVal + 0.05f), hsv.b);
+    Float alpha = one - hueOk * satOk * valOk;
+
+    Float dotMask = one;
+    if constexpr ((Features & KeyFeature::Halftone) != 0) {
+        Float cx = set(x + 0.5f) + simd::iota();
+        Float cy = set(y + 0.5f);
+        Float cell = set(k.cell);
+        Float cellX = (simd::floor(cx / cell) + set(0.5f)) * cell;
+        Float cellY = (simd::floor(cy / cell) + set(0.5f)) * cell;
+        Float ox = cx - cellX;
+        Float oy = cy - cellY;
+        Float radius = (one - luma(color)) * set(0.5f) * cell;
+        Float edge = simd::max(set(0.001f), radius * set(p.halftoneEdge));
+        Float dist = simd::sqrt(ox * ox + oy * oy);
+        dotMask = one - simd::smoothstep(radius - edge, radius + edge, dist);
+    }
+
+    Float levels = set(k.safeLevels);
+    Float levelsDiv = set(k.safeLevels - 1.0f);
+    Rgb poster = {simd::floor(color.r * levels) / levelsDiv,
+                  simd::floor(color.g * levels) / levelsDiv,
+                  simd::floor(color.b * levels) / levelsDiv};
+
+    Float lumC = luma(color);
+    Float lumR = loadTexels(input.luma, input, std::min(x + 1, input.width - 1), y);
+    Float lumU = loadTexels(input.luma, input, x, y + 1);
+    Float edge = set(p.edgeStrength) * (simd::abs(lumC - lumR) + simd::abs(lumC - lumU));
+
+    Rgb c = mix(color, poster, set(0.85f));
+    Float pulse = set(k.pulse);
+    c = {(c.r + edge) * pulse, (c.g + edge) * pulse, (c.b + edge) * pulse};
+    Rgb tinted = {c.r * set(1.1f), c.g * set(0.85f), c.b * set(1.2f)};
+    c = mix(c, tinted, set(p.pulseColorize * k.boostedKick));
+    if constexpr ((Features & KeyFeature::HuePulse) != 0) {
+        Rgb hsvOut = rgb2hsv(c);
+        float shift = (p.pulseHueShift / 360.0f) * k.boostedKick;
+        hsvOut.r = simd::fract(hsvOut.r + set(p.pulseHueMode > 0.0f ? -shift : shift));
+        c = hsv2rgb(hsvOut);
+    }
+    if constexpr ((Features & KeyFeature::Saturation) != 0) {
+        Rgb hsvSat = rgb2hsv(c);
+        hsvSat.g = simd::clamp(hsvSat.g * set(p.satScale), zero, one);
+        c = hsv2rgb(hsvSat);
+    }
+
+    Float mixAmount = set(k.mixAmount);
+    Float premul = dotMask * alpha;
+    Rgb outColor = mix(rawColor,
+                       {simd::clamp(c.r, zero, one) * premul,
+                        simd::clamp(c.g, zero, one) * premul,
+                        simd::clamp(c.b, zero, one) * premul},
+                       mixAmount);
+    Float outAlpha = simd::mix(one, premul, mixAmount);
+
+    auto toBytes = [&](Float v, int32_t *dst) {
+        simd::store(dst, simd::toInt(simd::clamp(v, zero, one) * set(255.0f) + set(0.5f)));
+    };
+    int32_t lanes[4][simd::kLanes];
+    toBytes(outColor.r, lanes[0]);
+    toBytes(outColor.g, lanes[1]);
+    toBytes(outColor.b, lanes[2]);
+    toBytes(outAlpha, lanes[3]);
+    for (int i = 0; i < count; ++i) {
+        out[i * 4 + 0] = static_cast<unsigned char>(lanes[0][i]);
+        out[i * 4 + 1] = static_cast<unsigned char>(lanes[1][i]);
+        out[i * 4 + 2] = static_cast<unsigned char>(lanes[2][i]);
+        out[i * 4 + 3] = static_cast<unsigned char>(lanes[3][i]);
+    }
+}
+
+template <uint32_t Features>
+void warpRows(const Planes &source, const WarpTarget &warped, const KeyEffectParams &p,
+              const FrameConstants &k, int y0, int y1) {
+    int w = source.width;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = 0; x < w; x += simd::kLanes) {
+            warpBlock<Features>(source, warped, p, k, x, y, std::min(simd::kLanes, w - x));
+        }
+    }
+}
+
+template <uint32_t Features>
+void shadeRows(const Planes &input, const Planes &source, const KeyEffectParams &p,
+               const FrameConstants &k, int y0, int y1, unsigned char *out) {
+    int w = input.width;
+    for (int y = y0; y < y1; ++y) {
+        unsigned char *row = out + static_cast<size_t>(y) * w * 4;
+        for (int x = 0; x < w; x += simd::kLanes) {
+            shadeBlock<Features>(input, source, p, k, x, y, std::min(simd::kLanes, w - x), row + x * 4);
+        }
+    }
+}
+
+using RowWarper = void (*)(const Planes &, const WarpTarget &, const KeyEffectParams &,
+                           const FrameConstants &, int, int);
+using RowShader = void (*)(const Planes &, const Planes &, const KeyEffectParams &,
+                           const FrameConstants &, int, int, unsigned char *);
+
+// One kernel per feature combination, indexed by mask. Each stage only
+// specialises on its own bits, so equivalent masks share an instantiation.
+template <size_t... Masks>
+constexpr std::array<RowWarper, sizeof...(Masks)> makeRowWarpers(std::index_sequence<Masks...>) {
+    return {&warpRows<static_cast<uint32_t>(Masks) & kWarpFeatures>...};
+}
+
+template <size_t... Masks>
+constexpr std::array<RowShader, sizeof...(Masks)> makeRowShaders(std::index_sequence<Masks...>) {
+    return {&shadeRows<static_cast<uint32_t>(Masks) & ~kWarpFeatures>...};
+}
+
+constexpr auto kRowWarpers = makeRowWarpers(std::make_index_sequence<KeyFeature::All + 1>());
+constexpr auto kRowShaders = makeRowShaders(std::make_index_sequence<KeyFeature::All + 1>());
+} // namespace
+
+uint32_t keyEffectFeatures(const KeyEffectParams &params) {
+    uint32_t features = 0;
+    if (params.kaleidoOn) {
+        features |= KeyFeature::Kaleido;
+    }
+    if (params.wooferOn) {
+        features |= KeyFeature::Woofer;
+    }
+    if (params.halftoneOn) {
+        features |= KeyFeature::Halftone;
+    }
+    if (std::abs(params.pulseHueMode) > 0.5f) {
+        features |= KeyFeature::HuePulse;
+    }
+    if (params.satOn) {
+        features |= KeyFeature::Saturation;
+    }
+    return features;
+}
+
+KeyEffectCpu::KeyEffectCpu(WorkerPool *pool)
+: pool(pool) {}
+
+const char *KeyEffectCpu::getBackendName() {
+    return simd::backendName();
+}
+
+void KeyEffectCpu::render(const cv::Mat &rgb, const KeyEffectParams &params, ofPixels &dst) {
+    int w = rgb.cols;
+    int h = rgb.rows;
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    allocateOutput(dst, w, h);
+
+    size_t count = static_cast<size_t>(w) * h;
+    red.resize(count);
+    green.resize(count);
+    blue.resize(count);
+    luma.resize(count);
+
+    auto forRows = [&](const std::function<void(int, int)> &fn) {
+        if (pool) {
+            pool->parallelFor(h, kRowGrain, fn);
+        } else {
+            fn(0, h);
+        }
+    };
+
+    // Split into normalised float planes once; the warp reads them randomly.
+    forRows([&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            const unsigned char *src = rgb.ptr<unsigned char>(y);
+            size_t offset = static_cast<size_t>(y) * w;
+            for (int x = 0; x < w; ++x) {
+                float r = src[x * 3 + 0] / 255.0f;
+                float g = src[x * 3 + 1] / 255.0f;
+                float b = src[x * 3 + 2] / 255.0f;
+                red[offset + x] = r;
+                green[offset + x] = g;
+                blue[offset + x] = b;
+                luma[offset + x] = r * 0.299f + g * 0.587f + b * 0.114f;
+            }
+        }
+    });
+
+    Planes source{red.data(), green.data(), blue.data(), luma.data(), w, h};
+    Planes input = source;
+    FrameConstants k(params, w, h);
+    uint32_t features = keyEffectFeatures(params);
+    if (features & kWarpFeatures) {
+        // The warp node's pass: every row must be done before the edge
+        // filter reads its neighbours.
+        warpedRed.resize(count);
+        warpedGreen.resize(count);
+        warpedBlue.resize(count);
+        warpedLuma.resize(count);
+        WarpTarget warped{warpedRed.data(), warpedGreen.data(), warpedBlue.data(), warpedLuma.data()};
+        RowWarper warpBand = kRowWarpers[features];
+        forRows([&](int y0, int y1) { warpBand(source, warped, params, k, y0, y1); });
+        input = {warped.r, warped.g, warped.b, warped.luma, w, h};
+    }
+
+    RowShader shadeBand = kRowShaders[features];
+    unsigned char *out = dst.getData();
+    forRows([&](int y0, int y1) { shadeBand(input, source, params, k, y0, y1, out); });
+}
+
+KeyEffectDiff compareKeyEffect(const ofPixels &a, const ofPixels &b, int tolerance) {
+    KeyEffectDiff diff;
+    if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() ||
+        a.getNumChannels() != 4 || b.getNumChannels() != 4) {
+        diff.sizeMismatch = true;
+        return diff;
+    }
+    diff.pixelCount = a.getWidth() * a.getHeight();
+    const unsigned char *pa = a.getData();
+    const unsigned char *pb = b.getData();
+    uint64_t total = 0;
+    for (size_t i = 0; i < diff.pixelCount; ++i) {
+        int pixelMax = 0;
+        for (int c = 0; c < 4; ++c) {
+            int d = std::abs(static_cast<int>(pa[i * 4 + c]) - static_cast<int>(pb[i * 4 + c]));
+            pixelMax = std::max(pixelMax, d);
+            total += d;
+        }
+        diff.maxDiff = std::max(diff.maxDiff, pixelMax);
+        if (pixelMax > tolerance) {
+            diff.pixelsOverTolerance++;
+        }
+    }
+    diff.meanDiff = diff.pixelCount > 0 ? static_cast<double>(total) / (diff.pixelCount * 4) : 0.0;
+    return diff;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "KeyShaderSource.h"
+#include "WorkerPool.h"
+
+// Values fed to the key effect shaders (see KeyShaderSource.cpp). Hues are
+// normalised to 0..1 and the pulse hue shift is in degrees, as in the shader.
+struct KeyEffectParams {
+    float texWidth = 0.0f;
+    float texHeight = 0.0f;
+    float keyHue = 0.0f;
+    float keyHueRange = 0.0f;
+    float keyMinSat = 0.0f;
+    float keyMinVal = 0.0f;
+    float levels = 6.0f;
+    float edgeStrength = 0.0f;
+    float time = 0.0f;
+    float beat = 0.0f; // beat clock position; the pulse peaks on whole beats
+    float pulseAmount = 0.0f;
+    float pulseColorize = 0.0f;
+    float pulseHueMode = 0.0f;
+    float pulseHueShift = 0.0f;
+    float pulseAttack = 0.08f;
+    float pulseDecay = 1.8f;
+    float pulseHueBoost = 1.0f;
+    bool wooferOn = false;
+    float wooferStrength = 0.0f;
+    float wooferFalloff = 1.0f;
+    bool satOn = false;
+    float satScale = 1.0f;
+    bool kaleidoOn = false;
+    float kaleidoSegments = 6.0f;
+    float kaleidoSpin = 0.0f;
+    float kaleidoZoom = 1.0f;
+    bool halftoneOn = false;
+    float halftoneScale = 14.0f;
+    float halftoneEdge = 0.3f;
+    float wetMix = 1.0f;
+};
+
+// KeyFeature bits for the stages these params enable.
+uint32_t keyEffectFeatures(const KeyEffectParams &params);
+
+// Scalar CPU version of the key effect graph at full scale, evaluated once
+// per source pixel (the shaders' vTexCoord is the pixel centre) with the
+// same math in the same order: the warp node into an intermediate image,
+// then the key, stylize and colour nodes. rgb is 8-bit RGB; dst is
+// (re)allocated as RGBA with the colour/alpha the last pass outputs. Slow;
+// used to validate KeyEffectCpu.
+void renderKeyEffectReference(const cv::Mat &rgb, const KeyEffectParams &params, ofPixels &dst);
+
+// Vectorised (see SimdFloat.h), multi-threaded version of the reference.
+// The source is split into float planes once per frame; the warp (if on)
+// and the remaining nodes then each run over row bands on the worker pool,
+// with kernels specialised for the enabled stages. Transcendentals use
+// polynomial approximations, so results can differ from the reference by a
+// level or so, more where a tiny coordinate change crosses a floor()/mod()
+// step.
+class KeyEffectCpu {
+public:
+    // A null pool renders on the calling thread only.
+    explicit KeyEffectCpu(WorkerPool *pool = &WorkerPool::shared());
+
+    void setPool(WorkerPool *newPool) { pool = newPool; }
+    void render(const cv::Mat &rgb, const KeyEffectParams &params, ofPixels &dst);
+
+    static const char *getBackendName();
+
+private:
+    static constexpr int kRowGrain = 8;
+
+    WorkerPool *pool = nullptr;
+    std::vector<float> red;
+    std::vector<float> green;
+    std::vector<float> blue;
+    std::vector<float> luma;
+    std::vector<float> warpedRed;
+    std::vector<float> warpedGreen;
+    std::vector<float> warpedBlue;
+    std::vector<float> warpedLuma;
+};
+
+struct KeyEffectDiff {
+    bool sizeMismatch = false;
+    size_t pixelCount = 0;
+    size_t pixelsOverTolerance = 0; // any channel differs by more than the tolerance
+    int maxDiff = 0;
+    double meanDiff = 0.0;
+};
+
+KeyEffectDiff compareKeyEffect(const ofPixels &a, const ofPixels &b, int tolerance);
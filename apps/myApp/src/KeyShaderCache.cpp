@@ -0,0 +1,46 @@
+#include "KeyShaderCache.h"
+
+#include "KeyShaderSource.h"
+
+void KeyShaderCache::setup(const std::string &vertexSource) {
+    vertex = vertexSource;
+    variants.clear();
+}
+
+ofShader *KeyShaderCache::get(const std::string &fragmentSource, const std::string &label) {
+    auto found = variants.find(fragmentSource);
+    if (found != variants.end()) {
+        return found->second.ready ? &found->second.shader : nullptr;
+    }
+
+    Variant &variant = variants[fragmentSource];
+    uint64_t start = ofGetElapsedTimeMillis();
+    variant.ready = variant.shader.setupShaderFromSource(GL_VERTEX_SHADER, vertex);
+    variant.ready = variant.ready &&
+                    variant.shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragmentSource);
+    if (variant.ready) {
+        variant.shader.bindDefaults();
+        variant.ready = variant.shader.linkProgram();
+    }
+    if (variant.ready) {
+        variant.shader.bindUniformBlock(kKeyParamsBinding, kKeyParamsBlockName);
+    }
+
+    if (!variant.ready) {
+        ofLogWarning() << "Failed to compile keying shader " << label << ".";
+        return nullptr;
+    }
+    ofLogVerbose() << "Key shader: compiled " << label << " in "
+                   << (ofGetElapsedTimeMillis() - start) << "ms";
+    return &variant.shader;
+}
+
+size_t KeyShaderCache::getCompiledCount() const {
+    size_t count = 0;
+    for (const auto &entry : variants) {
+        if (entry.second.ready) {
+            count++;
+        }
+    }
+    return count;
+}
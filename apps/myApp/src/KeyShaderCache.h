@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <map>
+#include <string>
+
+// Linked key effect programs, keyed by fragment source. Every effect graph
+// pass with the same nodes and KEY_* defines shares one program; programs
+// are compiled on first use and kept for the session.
+class KeyShaderCache {
+public:
+    void setup(const std::string &vertexSource);
+
+    // Null if the program failed to build (the failure is cached too). label
+    // names the program in log messages.
+    ofShader *get(const std::string &fragmentSource, const std::string &label);
+    size_t getCompiledCount() const;
+
+private:
+    struct Variant {
+        ofShader shader;
+        bool ready = false;
+    };
+
+    std::string vertex;
+    std::map<std::string, Variant> variants;
+};
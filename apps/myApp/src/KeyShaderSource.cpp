@@ -1,38 +1,56 @@
 #include "KeyShaderSource.h"
 
-const std::string &getKeyFragmentShaderSource() {
-    static const std::string kFragment = R"(
-#version 150
-uniform sampler2DRect tex0;
-uniform float keyHue;
-uniform float keyHueRange;
-uniform float keyMinSat;
-uniform float keyMinVal;
-uniform float levels;
-uniform float edgeStrength;
+namespace {
+struct FeatureName {
+    uint32_t bit;
+    const char *define;
+    const char *name;
+};
+
+const FeatureName kFeatureNames[] = {
+    {KeyFeature::Kaleido, "KEY_KALEIDO", "kaleido"},
+    {KeyFeature::Woofer, "KEY_WOOFER", "woofer"},
+    {KeyFeature::Halftone, "KEY_HALFTONE", "halftone"},
+    {KeyFeature::HuePulse, "KEY_HUE_PULSE", "huePulse"},
+    {KeyFeature::Saturation, "KEY_SATURATION", "saturation"},
+};
+
+// Everything between the feature #defines and the generated main().
+const char *kFragmentLibrary = R"(
+// The texture this pass reads (the source or an earlier pass, at any scale)
+// and the untouched source for the wet/dry mix.
+uniform sampler2DRect passInput;
+uniform sampler2DRect rawInput;
+uniform vec2 inputToSource;
 uniform float time;
-uniform float bpm;
-uniform float pulseAmount;
-uniform float pulseColorize;
-uniform float pulseHueMode;
-uniform float pulseHueShift;
-uniform float pulseAttack;
-uniform float pulseDecay;
-uniform float pulseHueBoost;
-uniform float wooferOn;
-uniform float wooferStrength;
-uniform float wooferFalloff;
-uniform float satOn;
-uniform float satScale;
-uniform float kaleidoOn;
-uniform float kaleidoSegments;
-uniform float kaleidoSpin;
-uniform float kaleidoZoom;
-uniform vec2 texSize;
-uniform float halftoneOn;
-uniform float halftoneScale;
-uniform float halftoneEdge;
-uniform float wetMix;
+uniform float beat;
+
+// Mirrors KeyUniformBlock (std140).
+layout(std140) uniform KeyParams {
+    vec2 texSize;
+    float keyHue;
+    float keyHueRange;
+    float keyMinSat;
+    float keyMinVal;
+    float levels;
+    float edgeStrength;
+    float pulseAmount;
+    float pulseColorize;
+    float pulseHueMode;
+    float pulseHueShift;
+    float pulseAttack;
+    float pulseDecay;
+    float pulseHueBoost;
+    float wooferStrength;
+    float wooferFalloff;
+    float satScale;
+    float kaleidoSegments;
+    float kaleidoSpin;
+    float kaleidoZoom;
+    float halftoneScale;
+    float halftoneEdge;
+    float wetMix;
+};
 
 in vec2 vTexCoord;
 out vec4 outputColor;
@@ -58,19 +76,22 @@ float luma(vec3 c) {
     return dot(c, vec3(0.299, 0.587, 0.114));
 }
 
-void main() {
-    float phase = fract(time * (bpm / 60.0));
+float beatKick() {
+    float phase = fract(beat);
     float attack = max(0.001, pulseAttack);
     float decay = max(0.001, pulseDecay);
     float ramp = smoothstep(0.0, attack, phase);
     float fall = (phase <= attack) ? 1.0 : exp(-(phase - attack) * decay);
-    float kick = ramp * fall;
-    float boostedKick = min(1.0, kick * pulseHueBoost);
-    float pulse = 1.0 + (pulseAmount * boostedKick);
+    return min(1.0, ramp * fall * pulseHueBoost);
+}
 
-    vec2 rawCoord = vTexCoord;
-    vec2 coord = vTexCoord;
-    if (kaleidoOn > 0.5) {
+// Nodes take the value so far and the pixel's source coordinate. They run in
+// graph order: warp, key, stylize, colour.
+
+// Resamples the pass input at the kaleidoscope/woofer coordinate.
+vec4 warpNode(vec4 value, vec2 coord) {
+#ifdef KEY_KALEIDO
+    {
         vec2 center = texSize * 0.5;
         vec2 p = coord - center;
         float zoom = clamp(kaleidoZoom, 0.1, 1.0);
@@ -84,24 +105,46 @@ void main() {
         vec2 newP = vec2(cos(angle), sin(angle)) * r;
         coord = newP + center;
     }
+#endif
 
-    if (wooferOn > 0.5) {
+#ifdef KEY_WOOFER
+    {
         vec2 center = texSize * 0.5;
         vec2 p = coord - center;
         float maxR = max(1.0, min(texSize.x, texSize.y) * 0.5);
         float rNorm = length(p) / maxR;
         float falloff = pow(clamp(1.0 - rNorm, 0.0, 1.0), wooferFalloff);
-        float bulge = 1.0 + (wooferStrength * boostedKick * falloff);
+        float bulge = 1.0 + (wooferStrength * beatKick() * falloff);
         coord = center + (p * bulge);
     }
+#endif
 
     coord = clamp(coord, vec2(0.0), texSize - 1.0);
-    rawCoord = clamp(rawCoord, vec2(0.0), texSize - 1.0);
+    return vec4(texture(passInput, coord / inputToSource).rgb, 1.0);
+}
 
-    vec3 rgb = texture(tex0, coord).rgb;
-    vec3 rawColor = texture(tex0, rawCoord).rgb;
+// HSV key into alpha; colour passes through.
+vec4 keyNode(vec4 value, vec2 coord) {
+    vec3 hsv = rgb2hsv(value.rgb);
+
+    float hueDist = abs(hsv.x - keyHue);
+    hueDist = min(hueDist, 1.0 - hueDist);
+
+    float hueOk = 1.0 - smoothstep(keyHueRange, keyHueRange + 0.02, hueDist);
+    float satOk = smoothstep(keyMinSat, keyMinSat + 0.05, hsv.y);
+    float valOk = smoothstep(keyMinVal, keyMinVal + 0.05, hsv.z);
+
+    float keyMask = hueOk * satOk * valOk;
+    return vec4(value.rgb, 1.0 - keyMask);
+}
+
+// Halftone dots, posterize and the luma edge boost. The edge filter reads the
+// right and upper neighbours straight from the pass input.
+vec4 stylizeNode(vec4 value, vec2 coord) {
+    vec3 rgb = value.rgb;
     float dotMask = 1.0;
-    if (halftoneOn > 0.5) {
+#ifdef KEY_HALFTONE
+    {
         float cell = max(2.0, halftoneScale);
         vec2 cellSize = vec2(cell);
         vec2 cellCenter = (floor(coord / cellSize) + 0.5) * cellSize;
@@ -112,31 +155,31 @@ void main() {
         float dist = length(offset);
         dotMask = 1.0 - smoothstep(radius - edge, radius + edge, dist);
     }
-    vec3 hsv = rgb2hsv(rgb);
-
-    float hueDist = abs(hsv.x - keyHue);
-    hueDist = min(hueDist, 1.0 - hueDist);
-
-    float hueOk = 1.0 - smoothstep(keyHueRange, keyHueRange + 0.02, hueDist);
-    float satOk = smoothstep(keyMinSat, keyMinSat + 0.05, hsv.y);
-    float valOk = smoothstep(keyMinVal, keyMinVal + 0.05, hsv.z);
-
-    float keyMask = hueOk * satOk * valOk;
-    float alpha = 1.0 - keyMask;
+#endif
 
     float safeLevels = max(levels, 2.0);
     vec3 poster = floor(rgb * safeLevels) / (safeLevels - 1.0);
 
     float lumC = luma(rgb);
-    float lumR = luma(texture(tex0, coord + vec2(1.0, 0.0)).rgb);
-    float lumU = luma(texture(tex0, coord + vec2(0.0, 1.0)).rgb);
+    float lumR = luma(texture(passInput, vTexCoord + vec2(1.0, 0.0)).rgb);
+    float lumU = luma(texture(passInput, vTexCoord + vec2(0.0, 1.0)).rgb);
     float edge = abs(lumC - lumR) + abs(lumC - lumU);
 
     vec3 color = mix(rgb, poster, 0.85);
     color += edgeStrength * edge;
-    color *= pulse;
+    return vec4(color, value.a * dotMask);
+}
+
+// Beat pulse and tint, hue pulse, saturation, then the wet/dry mix against
+// the untouched source. Output is premultiplied.
+vec4 colourNode(vec4 value, vec2 coord) {
+    float boostedKick = beatKick();
+    float pulse = 1.0 + (pulseAmount * boostedKick);
+
+    vec3 color = value.rgb * pulse;
     color = mix(color, color * vec3(1.1, 0.85, 1.2), pulseColorize * boostedKick);
-    if (abs(pulseHueMode) > 0.5) {
+#ifdef KEY_HUE_PULSE
+    {
         vec3 hsvOut = rgb2hsv(color);
         float shift = (pulseHueShift / 360.0) * boostedKick;
         if (pulseHueMode > 0.0) {
@@ -146,21 +189,86 @@ void main() {
         }
         color = hsv2rgb(hsvOut);
     }
-    if (satOn > 0.5) {
+#endif
+#ifdef KEY_SATURATION
+    {
         vec3 hsvSat = rgb2hsv(color);
         hsvSat.y = clamp(hsvSat.y * satScale, 0.0, 1.0);
         color = hsv2rgb(hsvSat);
     }
+#endif
     color = clamp(color, 0.0, 1.0);
 
+    vec3 rawColor = texture(rawInput, coord).rgb;
     float mixAmount = clamp(wetMix, 0.0, 1.0);
-    float processedAlpha = alpha * dotMask;
-    vec3 processedColor = color * dotMask;
-    vec3 processedPremul = processedColor * alpha;
-    vec3 outColor = mix(rawColor, processedPremul, mixAmount);
-    float outAlpha = mix(1.0, processedAlpha, mixAmount);
-    outputColor = vec4(outColor, outAlpha);
+    vec3 outColor = mix(rawColor, color * value.a, mixAmount);
+    float outAlpha = mix(1.0, value.a, mixAmount);
+    return vec4(outColor, outAlpha);
 }
 )";
-    return kFragment;
+
+// Bilinear upscale of the finished effect plus a sharpen against the four
+// neighbours. The sharpen is scaled down where local contrast is already high
+// and clamped to the neighbourhood's range, so edges get crisper without
+// halos.
+const char *kUpscaleSource = R"(#version 150
+uniform sampler2DRect tex0;
+uniform float sharpness;
+
+in vec2 vTexCoord;
+out vec4 outputColor;
+
+void main() {
+    vec4 c = texture(tex0, vTexCoord);
+    vec4 n = texture(tex0, vTexCoord + vec2(0.0, -1.0));
+    vec4 s = texture(tex0, vTexCoord + vec2(0.0, 1.0));
+    vec4 e = texture(tex0, vTexCoord + vec2(1.0, 0.0));
+    vec4 w = texture(tex0, vTexCoord + vec2(-1.0, 0.0));
+
+    vec4 lo = min(c, min(min(n, s), min(e, w)));
+    vec4 hi = max(c, max(max(n, s), max(e, w)));
+    vec4 headroom = clamp(min(lo, 1.0 - hi) / max(hi, vec4(1e-4)), 0.0, 1.0);
+    vec4 amount = sharpness * sqrt(headroom);
+
+    vec4 blur = (n + s + e + w) * 0.25;
+    outputColor = clamp(c + (c - blur) * amount, lo, hi);
+}
+)";
+} // namespace
+
+std::string getKeyPassShaderSource(const std::vector<std::string> &nodeFunctions, uint32_t features) {
+    std::string source = "#version 150\n";
+    for (const auto &feature : kFeatureNames) {
+        if (features & feature.bit) {
+            source += "#define ";
+            source += feature.define;
+            source += "\n";
+        }
+    }
+    source += kFragmentLibrary;
+    source += "\nvoid main() {\n"
+              "    vec2 coord = vTexCoord * inputToSource;\n"
+              "    vec4 value = texture(passInput, vTexCoord);\n";
+    for (const auto &function : nodeFunctions) {
+        source += "    value = " + function + "(value, coord);\n";
+    }
+    source += "    outputColor = value;\n}\n";
+    return source;
+}
+
+std::string getKeyUpscaleShaderSource() {
+    return kUpscaleSource;
+}
+
+std::string describeKeyFeatures(uint32_t features) {
+    std::string description;
+    for (const auto &feature : kFeatureNames) {
+        if (features & feature.bit) {
+            if (!description.empty()) {
+                description += "+";
+            }
+            description += feature.name;
+        }
+    }
+    return description.empty() ? "plain" : description;
 }
@@ -1,5 +1,66 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
-const std::string &getKeyFragmentShaderSource();
+// Optional stages of the key effect. Each combination is compiled as its own
+// set of pass shaders (and CPU kernel), so disabled stages cost nothing per
+// pixel.
+namespace KeyFeature {
+constexpr uint32_t Kaleido = 1u << 0;
+constexpr uint32_t Woofer = 1u << 1;
+constexpr uint32_t Halftone = 1u << 2;
+constexpr uint32_t HuePulse = 1u << 3;
+constexpr uint32_t Saturation = 1u << 4;
+constexpr uint32_t Count = 5;
+constexpr uint32_t All = (1u << Count) - 1;
+} // namespace KeyFeature
+
+// CPU side of the shaders' std140 KeyParams uniform block. Everything the
+// effect reads except the textures and the per-frame time and beat lives
+// here, so the block is only re-uploaded when a control changes. Every pass
+// shader declares the same block, so one buffer serves the whole effect
+// graph.
+struct KeyUniformBlock {
+    float texSize[2];
+    float keyHue;
+    float keyHueRange;
+    float keyMinSat;
+    float keyMinVal;
+    float levels;
+    float edgeStrength;
+    float pulseAmount;
+    float pulseColorize;
+    float pulseHueMode;
+    float pulseHueShift;
+    float pulseAttack;
+    float pulseDecay;
+    float pulseHueBoost;
+    float wooferStrength;
+    float wooferFalloff;
+    float satScale;
+    float kaleidoSegments;
+    float kaleidoSpin;
+    float kaleidoZoom;
+    float halftoneScale;
+    float halftoneEdge;
+    float wetMix;
+    // 24 floats fill six 16-byte rows, so std140 adds no padding at the end;
+    // a new field needs padding up to the next multiple of 16 bytes.
+};
+static_assert(sizeof(KeyUniformBlock) == 96, "KeyUniformBlock must match the std140 layout");
+
+constexpr unsigned int kKeyParamsBinding = 0;
+constexpr const char *kKeyParamsBlockName = "KeyParams";
+
+// Fragment shader for one effect graph pass: a KEY_* #define for every
+// feature bit set, the node library, and a main() that feeds the pass input
+// through nodeFunctions in order. The node functions are warpNode, keyNode,
+// stylizeNode and colourNode (see KeyShaderSource.cpp).
+std::string getKeyPassShaderSource(const std::vector<std::string> &nodeFunctions, uint32_t features);
+// Final blit from the effect's processing resolution to the screen: tex0 is
+// the finished effect, sharpness 0 is a plain bilinear upscale.
+std::string getKeyUpscaleShaderSource();
+// "kaleido+woofer", or "plain" for no features.
+std::string describeKeyFeatures(uint32_t features);
@@ -0,0 +1,48 @@
+#include "KeyUniformBuffer.h"
+
+KeyUniformBlock makeKeyUniformBlock(const KeyEffectParams &params) {
+    KeyUniformBlock block{};
+    block.texSize[0] = params.texWidth;
+    block.texSize[1] = params.texHeight;
+    block.keyHue = params.keyHue;
+    block.keyHueRange = params.keyHueRange;
+    block.keyMinSat = params.keyMinSat;
+    block.keyMinVal = params.keyMinVal;
+    block.levels = params.levels;
+    block.edgeStrength = params.edgeStrength;
+    block.pulseAmount = params.pulseAmount;
+    block.pulseColorize = params.pulseColorize;
+    block.pulseHueMode = params.pulseHueMode;
+    block.pulseHueShift = params.pulseHueShift;
+    block.pulseAttack = params.pulseAttack;
+    block.pulseDecay = params.pulseDecay;
+    block.pulseHueBoost = params.pulseHueBoost;
+    block.wooferStrength = params.wooferStrength;
+    block.wooferFalloff = params.wooferFalloff;
+    block.satScale = params.satScale;
+    block.kaleidoSegments = params.kaleidoSegments;
+    block.kaleidoSpin = params.kaleidoSpin;
+    block.kaleidoZoom = params.kaleidoZoom;
+    block.halftoneScale = params.halftoneScale;
+    block.halftoneEdge = params.halftoneEdge;
+    block.wetMix = params.wetMix;
+    return block;
+}
+
+void KeyUniformBuffer::setup() {
+    buffer.allocate(sizeof(KeyUniformBlock), nullptr, GL_DYNAMIC_DRAW);
+    // Nothing else uses this binding point, so bind once for all variants.
+    buffer.bindBase(GL_UNIFORM_BUFFER, kKeyParamsBinding);
+    dirty = true;
+}
+
+bool KeyUniformBuffer::update(const KeyUniformBlock &block) {
+    bool resized = block.texSize[0] != uploaded.texSize[0] || block.texSize[1] != uploaded.texSize[1];
+    if (!dirty && !resized) {
+        return false;
+    }
+    buffer.updateData(0, sizeof(KeyUniformBlock), &block);
+    uploaded = block;
+    dirty = false;
+    return true;
+}
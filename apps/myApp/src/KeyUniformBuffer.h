@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "KeyEffectCpu.h"
+#include "KeyShaderSource.h"
+
+KeyUniformBlock makeKeyUniformBlock(const KeyEffectParams &params);
+
+// GL buffer behind the key shader's KeyParams uniform block. Controls mark
+// it dirty when they change a value; update() uploads only then (or when the
+// texture size changes), so steady frames cost no uniform traffic.
+class KeyUniformBuffer {
+public:
+    void setup();
+    void markDirty() { dirty = true; }
+    // Returns true if the block was uploaded.
+    bool update(const KeyUniformBlock &block);
+
+private:
+    ofBufferObject buffer;
+    KeyUniformBlock uploaded{};
+    bool dirty = true;
+};
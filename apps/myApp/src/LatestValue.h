@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer "latest value" slot (triple buffer).
+// The producer fills writeSlot() and calls publish(); the consumer calls
+// consume() and, if it returns true, reads the newest value through read().
+// Neither side ever waits on the other; intermediate values are overwritten.
+template <typename T>
+class LatestValue {
+public:
+    T &writeSlot() { return slots[writeIndex]; }
+
+    void publish() {
+        uint8_t previous = middle.exchange(static_cast<uint8_t>(writeIndex | kFreshBit),
+                                           std::memory_order_acq_rel);
+        writeIndex = previous & kIndexMask;
+    }
+
+    bool consume() {
+        if ((middle.load(std::memory_order_acquire) & kFreshBit) == 0) {
+            return false;
+        }
+        uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & kIndexMask;
+        return true;
+    }
+
+    T &read() { return slots[readIndex]; }
+    const T &read() const { return slots[readIndex]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFreshBit = 0x4;
+
+    std::array<T, 3> slots;
+    uint8_t writeIndex = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t readIndex = 2;
+};
@@ -25,10 +25,53 @@ void MidiControl::close() {
 }
 
 void MidiControl::newMidiMessage(ofxMidiMessage &message) {
-    queue.push_back(message);
-    if (queue.size() > 256) {
-        queue.pop_front();
+    MidiEvent event;
+    event.timeMicros = stampEvent(ofGetElapsedTimeMicros(), message.deltatime);
+    event.driverDeltaMillis = static_cast<float>(message.deltatime);
+    event.status = static_cast<uint8_t>(message.status);
+    event.channel = static_cast<uint8_t>(std::max(0, message.channel));
+    if (message.bytes.size() > 1) {
+        event.data1 = message.bytes[1] & 0x7f;
+    }
+    if (message.bytes.size() > 2) {
+        event.data2 = message.bytes[2] & 0x7f;
+    }
+    events.push(event);
+}
+
+namespace {
+// A message is never dated more than this before it arrived.
+constexpr double kMaxJitterMicros = 10000.0;
+// How fast the offset may grow to follow the two clocks drifting apart.
+constexpr double kDriftPerMicro = 0.001;
+// After this long without input the driver clock is re-anchored.
+constexpr uint64_t kIdleResetMicros = 1000000;
+} // namespace
+
+// The driver's deltas between messages come from its own timestamps, taken
+// before USB and the driver's callback bunch messages together. Summed,
+// they give the driver's clock; its offset to ours is the smallest delay
+// seen (the message that got through fastest), allowed to creep upward
+// slowly to follow clock drift. Each message is dated on the driver's clock
+// plus that offset, so a burst of messages keeps its original spacing.
+uint64_t MidiControl::stampEvent(uint64_t arrivalMicros, double driverDeltaMillis) {
+    uint64_t sinceLast = arrivalMicros - lastArrivalMicros;
+    lastArrivalMicros = arrivalMicros;
+    if (sinceLast > kIdleResetMicros || driverDeltaMillis < 0.0) {
+        driverMicros = 0.0;
+        driverOffsetMicros = static_cast<double>(arrivalMicros);
+        return arrivalMicros;
+    }
+    driverMicros += driverDeltaMillis * 1000.0;
+    double arrival = static_cast<double>(arrivalMicros);
+    double delay = arrival - (driverMicros + driverOffsetMicros);
+    if (delay < 0.0) {
+        driverOffsetMicros += delay;
+    } else {
+        driverOffsetMicros += std::min(delay, static_cast<double>(sinceLast) * kDriftPerMicro);
     }
+    double stamped = std::max(driverMicros + driverOffsetMicros, arrival - kMaxJitterMicros);
+    return static_cast<uint64_t>(std::min(stamped, arrival));
 }
 
 void MidiControl::update() {
@@ -51,114 +94,144 @@ void MidiControl::update() {
         }
     }
 
-    while (!queue.empty()) {
-        ofxMidiMessage msg = queue.front();
-        queue.pop_front();
-        processMessage(msg);
+    lastEventCount = 0;
+    MidiEvent event;
+    while (events.pop(event)) {
+        processMessage(event);
+        ++lastEventCount;
     }
+
+    uint64_t nowMicros = ofGetElapsedTimeMicros();
+    sampleKnobs(nowMicros > knobDelayMicros ? nowMicros - knobDelayMicros : 0);
 }
 
-void MidiControl::registerControl(const std::string &id) {
-    if (id.empty()) {
-        return;
+void MidiControl::addKnobPoint(int handle, KnobBinding &knob, uint64_t timeMicros, float value01) {
+    if (knob.curve.empty()) {
+        knob.curve.add(timeMicros, knob.value01);
     }
-    bindings[id];
+    knob.curve.add(timeMicros, value01);
+    moving[handle / 64] |= uint64_t(1) << (handle % 64);
 }
 
-void MidiControl::beginLearn(const std::string &id) {
-    if (id.empty()) {
-        return;
+void MidiControl::sampleKnobs(uint64_t atMicros) {
+    bool changed = false;
+    // Returns true while the curve is still ahead of atMicros.
+    auto sample = [&](KnobBinding &knob, bool &updated, uint64_t &eventMicros) {
+        if (knob.curve.empty()) {
+            return false;
+        }
+        float value01 = knob.curve.sample(atMicros);
+        bool settled = atMicros >= knob.curve.getLastTime();
+        // Small steps are skipped mid-sweep but the final value always lands.
+        if (std::abs(value01 - knob.value01) > 0.0005f || (settled && value01 != knob.value01)) {
+            knob.value01 = value01;
+            updated = true;
+            eventMicros = std::min(atMicros, knob.curve.getLastTime());
+            changed = true;
+        }
+        return !settled;
+    };
+    for (size_t word = 0; word < moving.size(); ++word) {
+        uint64_t bits = moving[word];
+        for (int bit = 0; bits != 0; ++bit, bits >>= 1) {
+            if ((bits & 1) == 0) {
+                continue;
+            }
+            int handle = static_cast<int>(word * 64) + bit;
+            Binding &binding = controls[handle];
+            changed = false;
+            bool stillMoving = sample(binding.knob, binding.knobUpdated, binding.eventMicros);
+            stillMoving = sample(binding.oscKnob, binding.oscKnobUpdated, binding.eventMicros) || stillMoving;
+            if (changed) {
+                markDirty(handle);
+            }
+            if (!stillMoving) {
+                moving[word] &= ~(uint64_t(1) << bit);
+            }
+        }
     }
-    registerControl(id);
-    learn = LearnState{};
-    learn.active = true;
-    learn.mode = LearnState::Mode::Auto;
-    learn.targetId = id;
-    ofLogNotice() << "MIDI learn (" << id << "): waiting for pad or knob input.";
 }
 
-void MidiControl::beginLearnMute(const std::string &id) {
-    if (id.empty()) {
-        return;
-    }
-    registerControl(id);
-    learn = LearnState{};
-    learn.active = true;
-    learn.mode = LearnState::Mode::PadOnlyMute;
-    learn.targetId = id;
-    ofLogNotice() << "MIDI learn (" << id << "): waiting for mute pad input.";
+int MidiControl::registerControl(const std::string &id) {
+    auto it = handles.find(id);
+    if (it != handles.end()) {
+        return it->second;
+    }
+    int handle = static_cast<int>(controls.size());
+    handles[id] = handle;
+    controls.emplace_back();
+    controlIds.push_back(id);
+    dirty.resize((controls.size() + 63) / 64, 0);
+    moving.resize(dirty.size(), 0);
+    return handle;
+}
+
+int MidiControl::findControl(const std::string &id) const {
+    auto it = handles.find(id);
+    return it != handles.end() ? it->second : -1;
+}
+
+void MidiControl::beginLearn(int handle) {
+    beginLearnMode(handle, LearnState::Mode::Auto, "pad or knob");
+}
+
+void MidiControl::beginLearnMute(int handle) {
+    beginLearnMode(handle, LearnState::Mode::PadOnlyMute, "mute pad");
 }
 
-void MidiControl::beginLearnOsc(const std::string &id) {
-    if (id.empty()) {
+void MidiControl::beginLearnOsc(int handle) {
+    beginLearnMode(handle, LearnState::Mode::Osc, "oscillator pad or knob");
+}
+
+void MidiControl::beginLearnMode(int handle, LearnState::Mode mode, const char *waitingFor) {
+    if (handle < 0 || handle >= static_cast<int>(controls.size())) {
         return;
     }
-    registerControl(id);
     learn = LearnState{};
     learn.active = true;
-    learn.mode = LearnState::Mode::Osc;
-    learn.targetId = id;
-    ofLogNotice() << "MIDI learn (" << id << "): waiting for oscillator pad or knob input.";
+    learn.mode = mode;
+    learn.target = handle;
+    ofLogNotice() << "MIDI learn (" << controlIds[handle] << "): waiting for " << waitingFor << " input.";
 }
 
-bool MidiControl::consumePadHit(const std::string &id) {
-    auto it = bindings.find(id);
-    if (it == bindings.end()) {
-        return false;
-    }
-    if (!it->second.padHit) {
+bool MidiControl::consumePadHit(int handle) {
+    Binding &binding = controls[handle];
+    if (!binding.padHit) {
         return false;
     }
-    it->second.padHit = false;
+    binding.padHit = false;
     return true;
 }
 
-bool MidiControl::consumeKnobValue(const std::string &id, float &outValue01) {
-    auto it = bindings.find(id);
-    if (it == bindings.end()) {
+bool MidiControl::consumeKnobValue(int handle, float &outValue01) {
+    Binding &binding = controls[handle];
+    if (!binding.knobUpdated) {
         return false;
     }
-    if (!it->second.knobUpdated) {
-        return false;
-    }
-    it->second.knobUpdated = false;
-    outValue01 = it->second.knob.value01;
+    binding.knobUpdated = false;
+    outValue01 = binding.knob.value01;
     return true;
 }
 
-bool MidiControl::consumeOscPadHit(const std::string &id) {
-    auto it = bindings.find(id);
-    if (it == bindings.end()) {
-        return false;
-    }
-    if (!it->second.oscPadHit) {
+bool MidiControl::consumeOscPadHit(int handle) {
+    Binding &binding = controls[handle];
+    if (!binding.oscPadHit) {
         return false;
     }
-    it->second.oscPadHit = false;
+    binding.oscPadHit = false;
     return true;
 }
 
-bool MidiControl::consumeOscKnobValue(const std::string &id, float &outValue01) {
-    auto it = bindings.find(id);
-    if (it == bindings.end()) {
+bool MidiControl::consumeOscKnobValue(int handle, float &outValue01) {
+    Binding &binding = controls[handle];
+    if (!binding.oscKnobUpdated) {
         return false;
     }
-    if (!it->second.oscKnobUpdated) {
-        return false;
-    }
-    it->second.oscKnobUpdated = false;
-    outValue01 = it->second.oscKnob.value01;
+    binding.oscKnobUpdated = false;
+    outValue01 = binding.oscKnob.value01;
     return true;
 }
 
-bool MidiControl::isMuteActive(const std::string &id) const {
-    auto it = bindings.find(id);
-    if (it == bindings.end()) {
-        return false;
-    }
-    return it->second.muteActive;
-}
-
 void MidiControl::cyclePort() {
     int numPorts = midiIn.getNumInPorts();
     if (numPorts <= 0) {
@@ -178,133 +251,169 @@ void MidiControl::toggleOutputTest() {
                   << " (channel " << outputTestChannel << ")";
 }
 
-void MidiControl::processMessage(const ofxMidiMessage &message) {
+namespace {
+// Index into the dispatch tables, or -1 if the channel or number is out of
+// range.
+int dispatchKey(int table, int channel, int number) {
+    if (channel < 1 || channel > 16 || number < 0 || number > 127) {
+        return -1;
+    }
+    return (table * 16 + channel - 1) * 128 + number;
+}
+} // namespace
+
+void MidiControl::processMessage(const MidiEvent &event) {
+    if (processTransport(event)) {
+        return;
+    }
     if (learn.active) {
-        processLearning(message);
+        processLearning(event);
         return;
     }
 
-    bool isNoteOn = (message.status == MIDI_NOTE_ON && message.velocity > 0);
-    bool isNoteOff = (message.status == MIDI_NOTE_OFF) ||
-                     (message.status == MIDI_NOTE_ON && message.velocity == 0);
+    bool isNoteOn = (event.status == MIDI_NOTE_ON && event.data2 > 0);
+    bool isNoteOff = (event.status == MIDI_NOTE_OFF) ||
+                     (event.status == MIDI_NOTE_ON && event.data2 == 0);
+    bool isControl = (event.status == MIDI_CONTROL_CHANGE);
+    if (!isNoteOn && !isNoteOff && !isControl) {
+        return;
+    }
 
-    if (isNoteOn) {
-        for (auto &entry : bindings) {
-            auto &binding = entry.second;
-            if (binding.pad.valid() &&
-                message.channel == binding.pad.channel &&
-                message.pitch == binding.pad.note) {
+    int key = dispatchKey(isControl ? kControlTable : kNoteTable, event.channel, event.data1);
+    if (key < 0) {
+        return;
+    }
+    float value01 = event.data2 / 127.0f;
+    for (int r = routeStart[key]; r < routeStart[key + 1]; ++r) {
+        const Route &route = routes[r];
+        Binding &binding = controls[route.handle];
+        bool changed = false;
+        switch (route.role) {
+        case Role::Pad:
+            if (isNoteOn) {
                 binding.padHit = true;
+                changed = true;
             }
-            if (binding.mutePad.valid() &&
-                message.channel == binding.mutePad.channel &&
-                message.pitch == binding.mutePad.note) {
-                binding.muteActive = true;
-            }
-            if (binding.oscPad.valid() &&
-                message.channel == binding.oscPad.channel &&
-                message.pitch == binding.oscPad.note) {
+            break;
+        case Role::MutePad:
+            changed = binding.muteActive != isNoteOn;
+            binding.muteActive = isNoteOn;
+            break;
+        case Role::OscPad:
+            if (isNoteOn) {
                 binding.oscPadHit = true;
+                changed = true;
             }
+            break;
+        case Role::Knob:
+            addKnobPoint(route.handle, binding.knob, event.timeMicros, value01);
+            break;
+        case Role::OscKnob:
+            addKnobPoint(route.handle, binding.oscKnob, event.timeMicros, value01);
+            break;
         }
-    }
-
-    if (isNoteOff) {
-        for (auto &entry : bindings) {
-            auto &binding = entry.second;
-            if (binding.mutePad.valid() &&
-                message.channel == binding.mutePad.channel &&
-                message.pitch == binding.mutePad.note) {
-                binding.muteActive = false;
-            }
+        if (changed) {
+            binding.eventMicros = event.timeMicros;
+            markDirty(route.handle);
         }
     }
+}
 
-    if (message.status == MIDI_CONTROL_CHANGE) {
-        for (auto &entry : bindings) {
-            auto &binding = entry.second;
-            if (binding.knob.valid() &&
-                message.channel == binding.knob.channel &&
-                message.control == binding.knob.control) {
-                float value01 = ofClamp(message.value / 127.0f, 0.0f, 1.0f);
-                if (std::abs(value01 - binding.knob.value01) > 0.0005f) {
-                    binding.knob.value01 = value01;
-                    binding.knobUpdated = true;
-                }
-            }
-            if (binding.oscKnob.valid() &&
-                message.channel == binding.oscKnob.channel &&
-                message.control == binding.oscKnob.control) {
-                float value01 = ofClamp(message.value / 127.0f, 0.0f, 1.0f);
-                if (std::abs(value01 - binding.oscKnob.value01) > 0.0005f) {
-                    binding.oscKnob.value01 = value01;
-                    binding.oscKnobUpdated = true;
-                }
-            }
-        }
+// Clock and transport messages; true if the event was one.
+bool MidiControl::processTransport(const MidiEvent &event) {
+    switch (event.status) {
+    case MIDI_TIME_CLOCK:
+        if (beatClock) {
+            beatClock->clockTick(event.timeMicros * 1e-6);
+        }
+        return true;
+    case MIDI_START:
+        if (beatClock) {
+            beatClock->start();
+        }
+        return true;
+    case MIDI_CONTINUE:
+        if (beatClock) {
+            beatClock->resume();
+        }
+        return true;
+    case MIDI_STOP:
+        if (beatClock) {
+            beatClock->stop();
+        }
+        return true;
+    case MIDI_SONG_POS_POINTER:
+        if (beatClock) {
+            beatClock->setSongPosition(event.data1 | (event.data2 << 7));
+        }
+        return true;
+    default:
+        return false;
     }
 }
 
-void MidiControl::processLearning(const ofxMidiMessage &message) {
+void MidiControl::processLearning(const MidiEvent &event) {
     if (!learn.windowStarted) {
         learn.windowStarted = true;
         learn.startMs = ofGetElapsedTimeMillis();
     }
 
     if (learn.mode == LearnState::Mode::PadOnlyMute) {
-        if (message.status == MIDI_NOTE_ON && message.velocity > 0) {
+        if (event.status == MIDI_NOTE_ON && event.data2 > 0) {
             learn.noteCount += 1;
-            learn.lastNote = message.pitch;
-            learn.lastNoteChannel = message.channel;
+            learn.lastNote = event.data1;
+            learn.lastNoteChannel = event.channel;
         }
         return;
     }
 
     if (learn.mode == LearnState::Mode::Osc) {
-        if (message.status == MIDI_NOTE_ON && message.velocity > 0) {
+        if (event.status == MIDI_NOTE_ON && event.data2 > 0) {
             learn.noteCount += 1;
-            learn.lastNote = message.pitch;
-            learn.lastNoteChannel = message.channel;
-        } else if (message.status == MIDI_CONTROL_CHANGE) {
+            learn.lastNote = event.data1;
+            learn.lastNoteChannel = event.channel;
+        } else if (event.status == MIDI_CONTROL_CHANGE) {
             learn.ccCount += 1;
-            learn.lastCc = message.control;
-            learn.lastCcChannel = message.channel;
+            learn.lastCc = event.data1;
+            learn.lastCcChannel = event.channel;
         }
         return;
     }
 
-    if (message.status == MIDI_NOTE_ON && message.velocity > 0) {
+    if (event.status == MIDI_NOTE_ON && event.data2 > 0) {
         learn.noteCount += 1;
-        learn.lastNote = message.pitch;
-        learn.lastNoteChannel = message.channel;
-    } else if (message.status == MIDI_CONTROL_CHANGE) {
+        learn.lastNote = event.data1;
+        learn.lastNoteChannel = event.channel;
+    } else if (event.status == MIDI_CONTROL_CHANGE) {
         learn.ccCount += 1;
-        learn.lastCc = message.control;
-        learn.lastCcChannel = message.channel;
+        learn.lastCc = event.data1;
+        learn.lastCcChannel = event.channel;
     }
 }
 
 void MidiControl::finalizeLearning() {
-    if (learn.targetId.empty()) {
+    if (learn.target < 0 || learn.target >= static_cast<int>(controls.size())) {
         ofLogWarning() << "MIDI learn: invalid target.";
         learn.active = false;
         learn.windowStarted = false;
         return;
     }
 
-    Binding &binding = bindings[learn.targetId];
+    Binding &binding = controls[learn.target];
+    const std::string &targetId = controlIds[learn.target];
 
     if (learn.mode == LearnState::Mode::PadOnlyMute) {
         if (learn.noteCount >= 1 && learn.lastNote >= 0) {
             binding.mutePad.channel = learn.lastNoteChannel;
             binding.mutePad.note = learn.lastNote;
-            ofLogNotice() << "MIDI learn (" << learn.targetId << "): bound mute pad note "
+            ofLogNotice() << "MIDI learn (" << targetId << "): bound mute pad note "
                           << binding.mutePad.note << " on channel " << binding.mutePad.channel;
         } else {
-            ofLogWarning() << "MIDI learn (" << learn.targetId << "): no valid mute pad input detected.";
+            ofLogWarning() << "MIDI learn (" << targetId << "): no valid mute pad input detected.";
         }
         learn.active = false;
         learn.windowStarted = false;
+        rebuildDispatch();
         saveSettings();
         return;
     }
@@ -314,19 +423,20 @@ void MidiControl::finalizeLearning() {
             binding.oscKnob.channel = learn.lastCcChannel;
             binding.oscKnob.control = learn.lastCc;
             binding.oscKnob.value01 = 0.0f;
-            ofLogNotice() << "MIDI learn (" << learn.targetId << "): bound osc knob CC "
+            ofLogNotice() << "MIDI learn (" << targetId << "): bound osc knob CC "
                           << binding.oscKnob.control << " on channel " << binding.oscKnob.channel;
         } else if (learn.noteCount >= 1 && learn.lastNote >= 0) {
             binding.oscPad.channel = learn.lastNoteChannel;
             binding.oscPad.note = learn.lastNote;
-            ofLogNotice() << "MIDI learn (" << learn.targetId << "): bound osc pad note "
+            ofLogNotice() << "MIDI learn (" << targetId << "): bound osc pad note "
                           << binding.oscPad.note << " on channel " << binding.oscPad.channel;
         } else {
-            ofLogWarning() << "MIDI learn (" << learn.targetId << "): no valid osc input detected.";
+            ofLogWarning() << "MIDI learn (" << targetId << "): no valid osc input detected.";
         }
 
         learn.active = false;
         learn.windowStarted = false;
+        rebuildDispatch();
         saveSettings();
         return;
     }
@@ -335,22 +445,61 @@ void MidiControl::finalizeLearning() {
         binding.knob.channel = learn.lastCcChannel;
         binding.knob.control = learn.lastCc;
         binding.knob.value01 = 0.0f;
-        ofLogNotice() << "MIDI learn (" << learn.targetId << "): bound knob CC "
+        ofLogNotice() << "MIDI learn (" << targetId << "): bound knob CC "
                       << binding.knob.control << " on channel " << binding.knob.channel;
     } else if (learn.noteCount >= 1 && learn.lastNote >= 0) {
         binding.pad.channel = learn.lastNoteChannel;
         binding.pad.note = learn.lastNote;
-        ofLogNotice() << "MIDI learn (" << learn.targetId << "): bound pad note "
+        ofLogNotice() << "MIDI learn (" << targetId << "): bound pad note "
                       << binding.pad.note << " on channel " << binding.pad.channel;
     } else {
-        ofLogWarning() << "MIDI learn (" << learn.targetId << "): no valid input detected.";
+        ofLogWarning() << "MIDI learn (" << targetId << "): no valid input detected.";
     }
 
     learn.active = false;
     learn.windowStarted = false;
+    rebuildDispatch();
     saveSettings();
 }
 
+void MidiControl::rebuildDispatch() {
+    struct Entry {
+        int key;
+        Route route;
+    };
+    std::vector<Entry> entries;
+    uint16_t handle = 0;
+    auto add = [&](int table, int channel, int number, Role role) {
+        int key = dispatchKey(table, channel, number);
+        if (key >= 0) {
+            Route route;
+            route.handle = handle;
+            route.role = role;
+            entries.push_back({key, route});
+        }
+    };
+    for (; handle < controls.size(); ++handle) {
+        const Binding &binding = controls[handle];
+        add(kNoteTable, binding.pad.channel, binding.pad.note, Role::Pad);
+        add(kNoteTable, binding.mutePad.channel, binding.mutePad.note, Role::MutePad);
+        add(kNoteTable, binding.oscPad.channel, binding.oscPad.note, Role::OscPad);
+        add(kControlTable, binding.knob.channel, binding.knob.control, Role::Knob);
+        add(kControlTable, binding.oscKnob.channel, binding.oscKnob.control, Role::OscKnob);
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.key < b.key; });
+
+    routes.clear();
+    std::fill(routeStart.begin(), routeStart.end(), 0);
+    for (const auto &entry : entries) {
+        routes.push_back(entry.route);
+        routeStart[entry.key + 1] += 1;
+    }
+    for (int k = 0; k < kDispatchKeys; ++k) {
+        routeStart[k + 1] += routeStart[k];
+    }
+}
+
 void MidiControl::openPort(int index) {
     int numPorts = midiIn.getNumInPorts();
     if (numPorts <= 0) {
@@ -631,7 +780,14 @@ bool MidiControl::applySettingsForAvailableDevice() {
         int portIndex = findInPortByName(device.name);
         if (portIndex >= 0) {
             openPort(portIndex);
-            bindings = device.bindings;
+            for (auto &binding : controls) {
+                binding = Binding{};
+            }
+            for (const auto &entry : device.bindings) {
+                int handle = registerControl(entry.first);
+                controls[handle] = entry.second;
+            }
+            rebuildDispatch();
             ofLogNotice() << "MIDI settings: loaded bindings for device \""
                           << device.name << "\".";
             return true;
@@ -674,10 +830,9 @@ MidiControl::DeviceSettings MidiControl::buildCurrentDeviceSettings() {
     if (currentPort >= 0 && currentPort < midiIn.getNumInPorts()) {
         device.name = midiIn.getInPortName(currentPort);
     }
-    for (const auto &entry : bindings) {
-        const auto &id = entry.first;
-        const auto &binding = entry.second;
-        Binding clean = binding;
+    for (size_t handle = 0; handle < controls.size(); ++handle) {
+        const auto &id = controlIds[handle];
+        Binding clean = controls[handle];
         clean.padHit = false;
         clean.knobUpdated = false;
         clean.muteActive = false;
@@ -685,6 +840,9 @@ MidiControl::DeviceSettings MidiControl::buildCurrentDeviceSettings() {
         clean.oscKnobUpdated = false;
         clean.knob.value01 = 0.0f;
         clean.oscKnob.value01 = 0.0f;
+        clean.knob.curve.clear();
+        clean.oscKnob.curve.clear();
+        clean.eventMicros = 0;
         if (clean.pad.valid() || clean.mutePad.valid() || clean.oscPad.valid() ||
             clean.knob.valid() || clean.oscKnob.valid()) {
             device.bindings[id] = clean;
@@ -3,7 +3,11 @@
 #include "ofMain.h"
 #include "ofxMidi.h"
 
-#include <deque>
+#include "BeatClock.h"
+#include "ControlCurve.h"
+#include "MidiEventQueue.h"
+
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iosfwd>
@@ -17,16 +21,44 @@ public:
     void cyclePort();
     void toggleOutputTest();
 
-    void registerControl(const std::string &id);
-    void beginLearn(const std::string &id);
-    void beginLearnMute(const std::string &id);
-    void beginLearnOsc(const std::string &id);
-    bool consumePadHit(const std::string &id);
-    bool consumeKnobValue(const std::string &id, float &outValue01);
-    bool consumeOscPadHit(const std::string &id);
-    bool consumeOscKnobValue(const std::string &id, float &outValue01);
-    bool isMuteActive(const std::string &id) const;
+    // Returns the control's handle, a small index that stays valid for the
+    // life of this object. Registering an id twice returns the same handle.
+    int registerControl(const std::string &id);
+    int findControl(const std::string &id) const;
+    const std::string &getControlId(int handle) const { return controlIds[handle]; }
+
+    void beginLearn(int handle);
+    void beginLearnMute(int handle);
+    void beginLearnOsc(int handle);
+    bool consumePadHit(int handle);
+    bool consumeKnobValue(int handle, float &outValue01);
+    bool consumeOscPadHit(int handle);
+    bool consumeOscKnobValue(int handle, float &outValue01);
+    bool isMuteActive(int handle) const { return controls[handle].muteActive; }
+    // When (ofGetElapsedTimeMicros()) the input behind the control's latest
+    // state change happened, for latency stats.
+    uint64_t getEventMicros(int handle) const { return controls[handle].eventMicros; }
+
+    // MIDI clock, start/stop/continue and song position drive this clock
+    // from update(); null ignores them.
+    void setBeatClock(BeatClock *clock) { beatClock = clock; }
+
+    // Knobs are rendered this far behind the clock, interpolating between
+    // their timestamped values, so a sweep moves evenly from frame to frame.
+    // About one frame is enough; 0 applies the latest value immediately.
+    void setKnobDelayMicros(uint64_t micros) { knobDelayMicros = micros; }
+
+    // Calls fn(handle) for each control whose pad, mute or knob state changed
+    // since the last call, in handle order, and clears the marks.
+    template <typename Fn>
+    void forEachDirtyControl(Fn &&fn);
+
+    // Events handled by the last update().
+    int getLastEventCount() const { return lastEventCount; }
+    uint64_t getDroppedEventCount() const { return events.getDroppedCount(); }
+    uint64_t getCoalescedEventCount() const { return events.getCoalescedCount(); }
 
+    // Called on the MIDI driver thread.
     void newMidiMessage(ofxMidiMessage &message) override;
 
 private:
@@ -40,6 +72,7 @@ private:
         int channel = -1;
         int control = -1;
         float value01 = 0.0f;
+        ControlCurve curve;
         bool valid() const { return channel >= 0 && control >= 0; }
     };
 
@@ -54,6 +87,21 @@ private:
         bool muteActive = false;
         bool oscPadHit = false;
         bool oscKnobUpdated = false;
+        uint64_t eventMicros = 0;
+    };
+
+    // What a bound note or CC drives on its binding.
+    enum class Role : uint8_t {
+        Pad,
+        MutePad,
+        OscPad,
+        Knob,
+        OscKnob
+    };
+
+    struct Route {
+        uint16_t handle = 0;
+        Role role = Role::Pad;
     };
 
     struct DeviceSettings {
@@ -69,6 +117,7 @@ private:
         };
         bool active = false;
         bool windowStarted = false;
+        int target = -1;
         uint64_t startMs = 0;
         int noteCount = 0;
         int ccCount = 0;
@@ -76,13 +125,19 @@ private:
         int lastNoteChannel = -1;
         int lastCc = -1;
         int lastCcChannel = -1;
-        std::string targetId;
         Mode mode = Mode::Auto;
     };
 
-    void processMessage(const ofxMidiMessage &message);
-    void processLearning(const ofxMidiMessage &message);
+    void processMessage(const MidiEvent &event);
+    void processLearning(const MidiEvent &event);
+    bool processTransport(const MidiEvent &event);
+    void beginLearnMode(int handle, LearnState::Mode mode, const char *waitingFor);
     void finalizeLearning();
+    void markDirty(int handle) { dirty[handle / 64] |= uint64_t(1) << (handle % 64); }
+    void addKnobPoint(int handle, KnobBinding &knob, uint64_t timeMicros, float value01);
+    void sampleKnobs(uint64_t atMicros);
+    uint64_t stampEvent(uint64_t arrivalMicros, double driverDeltaMillis);
+    void rebuildDispatch();
     void openPort(int index);
     void logPorts();
     void sendRandomTestMessage(uint64_t nowMs);
@@ -100,10 +155,22 @@ private:
                       const KnobBinding &knob) const;
 
     static constexpr uint64_t kLearnWindowMs = 150;
+    // Dispatch tables: notes, then CCs, each 16 channels x 128 numbers.
+    static constexpr int kNoteTable = 0;
+    static constexpr int kControlTable = 1;
+    static constexpr int kDispatchKeys = 2 * 16 * 128;
 
     ofxMidiIn midiIn;
     ofxMidiOut midiOut;
-    std::deque<ofxMidiMessage> queue;
+    MidiEventQueue events;
+    int lastEventCount = 0;
+    uint64_t knobDelayMicros = 0;
+    BeatClock *beatClock = nullptr;
+    // Driver thread only: the driver's clock, rebuilt from its deltas, and
+    // its offset to ours (see stampEvent()).
+    double driverMicros = 0.0;
+    double driverOffsetMicros = 0.0;
+    uint64_t lastArrivalMicros = 0;
     struct PendingNoteOff {
         int channel = 1;
         int note = 0;
@@ -123,5 +190,28 @@ private:
     std::vector<DeviceSettings> savedDevices;
 
     LearnState learn;
-    std::unordered_map<std::string, Binding> bindings;
+    // Indexed by control handle.
+    std::vector<Binding> controls;
+    std::vector<std::string> controlIds;
+    std::vector<uint64_t> dirty;  // one bit per handle
+    std::vector<uint64_t> moving; // knobs whose curve is ahead of the render time
+    std::unordered_map<std::string, int> handles;
+
+    // Routes for dispatch key k are routes[routeStart[k], routeStart[k + 1]),
+    // rebuilt by rebuildDispatch() whenever a binding's note or CC changes.
+    std::vector<uint16_t> routeStart = std::vector<uint16_t>(kDispatchKeys + 1, 0);
+    std::vector<Route> routes;
 };
+
+template <typename Fn>
+void MidiControl::forEachDirtyControl(Fn &&fn) {
+    for (size_t word = 0; word < dirty.size(); ++word) {
+        uint64_t bits = dirty[word];
+        dirty[word] = 0;
+        for (int bit = 0; bits != 0; ++bit, bits >>= 1) {
+            if (bits & 1) {
+                fn(static_cast<int>(word * 64) + bit);
+            }
+        }
+    }
+}
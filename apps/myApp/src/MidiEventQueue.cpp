@@ -0,0 +1,70 @@
+#include "MidiEventQueue.h"
+
+namespace {
+constexpr uint8_t kControlChange = 0xB0;
+constexpr uint32_t kMask = MidiEventQueue::kCapacity - 1;
+} // namespace
+
+void MidiEventQueue::push(const MidiEvent &event) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t used = t - head.load(std::memory_order_acquire);
+    bool isControl = event.status == kControlChange && event.channel >= 1 && event.channel <= kChannels &&
+                     event.data1 < kControllers;
+    if (isControl) {
+        size_t index = (event.channel - 1) * kControllers + event.data1;
+        if (used >= kCapacity - kNoteReserve) {
+            parkedTime[index].store(event.timeMicros, std::memory_order_relaxed);
+            parked[index].store(static_cast<uint8_t>(event.data2 + 1), std::memory_order_release);
+            anyParked.store(true, std::memory_order_release);
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // This value is newer than anything parked for the controller.
+        parked[index].store(kNoValue, std::memory_order_relaxed);
+    } else if (used >= kCapacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring[t & kMask] = event;
+    tail.store(t + 1, std::memory_order_release);
+}
+
+bool MidiEventQueue::pop(MidiEvent &out) {
+    if (unparkedNext < unparked.size()) {
+        out = unparked[unparkedNext++];
+        return true;
+    }
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h != tail.load(std::memory_order_acquire)) {
+        out = ring[h & kMask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    return popParked(out);
+}
+
+bool MidiEventQueue::popParked(MidiEvent &out) {
+    unparked.clear();
+    unparkedNext = 0;
+    if (!anyParked.exchange(false, std::memory_order_acq_rel)) {
+        return false;
+    }
+    for (size_t i = 0; i < parked.size(); ++i) {
+        uint8_t value = parked[i].exchange(kNoValue, std::memory_order_acquire);
+        if (value == kNoValue) {
+            continue;
+        }
+        MidiEvent event;
+        event.timeMicros = parkedTime[i].load(std::memory_order_relaxed);
+        event.status = kControlChange;
+        event.channel = static_cast<uint8_t>(i / kControllers + 1);
+        event.data1 = static_cast<uint8_t>(i % kControllers);
+        event.data2 = static_cast<uint8_t>(value - 1);
+        unparked.push_back(event);
+    }
+    if (unparked.empty()) {
+        return false;
+    }
+    out = unparked[unparkedNext++];
+    return true;
+}
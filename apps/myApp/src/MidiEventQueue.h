@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One short MIDI message, copied out of ofxMidiMessage on the driver thread.
+// data1/data2 are the raw data bytes: note and velocity, controller and
+// value, or the song position LSB and MSB.
+struct MidiEvent {
+    uint64_t timeMicros = 0;     // ofGetElapsedTimeMicros() when the driver delivered it
+    float driverDeltaMillis = 0; // driver's time since its previous message
+    uint8_t status = 0;          // MidiStatus, channel bits cleared
+    uint8_t channel = 0;         // 1-16, 0 for system messages
+    uint8_t data1 = 0;
+    uint8_t data2 = 0;
+};
+
+// Bounded lock-free single-producer/single-consumer queue of MidiEvents
+// between the MIDI driver thread (push) and update() (pop). Neither side
+// waits, and the producer never allocates.
+//
+// The last kNoteReserve slots are kept for everything but control changes,
+// so a knob flood can't crowd out pad hits. A control change that doesn't
+// fit is parked as the newest value of its (channel, controller) instead,
+// and handed out once the ring has drained: a knob always ends on its last
+// position even when intermediate values are skipped.
+class MidiEventQueue {
+public:
+    static constexpr uint32_t kCapacity = 1024; // power of two
+    static constexpr uint32_t kNoteReserve = 64;
+
+    // Producer side.
+    void push(const MidiEvent &event);
+
+    // Consumer side. Returns false once the queue is empty.
+    bool pop(MidiEvent &out);
+
+    // Events lost because the ring was full.
+    uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    // Control changes parked outside the ring; only the newest per
+    // controller is delivered.
+    uint64_t getCoalescedCount() const { return coalesced.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kChannels = 16;
+    static constexpr int kControllers = 128;
+    // Parked value + 1, 0 for none.
+    static constexpr uint8_t kNoValue = 0;
+
+    bool popParked(MidiEvent &out);
+
+    std::array<MidiEvent, kCapacity> ring;
+    alignas(64) std::atomic<uint32_t> head{0}; // next slot to read, written by the consumer
+    alignas(64) std::atomic<uint32_t> tail{0}; // next slot to write, written by the producer
+    alignas(64) std::array<std::atomic<uint8_t>, kChannels * kControllers> parked{};
+    std::array<std::atomic<uint64_t>, kChannels * kControllers> parkedTime{};
+    std::atomic<bool> anyParked{false};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> coalesced{0};
+
+    // Consumer-only: parked control changes collected after the ring drained.
+    std::vector<MidiEvent> unparked;
+    size_t unparkedNext = 0;
+};
@@ -0,0 +1,105 @@
+#include "MotionField.h"
+
+#include "ofMain.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "SimdBytes.h"
+
+MotionField::MotionField(WorkerPool *pool) : pool(pool) {}
+
+void MotionField::setGrid(int newColumns, int newRows) {
+    gridColumns = std::max(1, newColumns);
+    gridRows = std::max(1, newRows);
+}
+
+void MotionField::allocate(const cv::Size &size) {
+    frameSize = size;
+    columns = std::min(gridColumns, size.width);
+    rows = std::min(gridRows, size.height);
+    cellX.resize(static_cast<size_t>(columns) + 1);
+    cellY.resize(static_cast<size_t>(rows) + 1);
+    for (int c = 0; c <= columns; ++c) {
+        cellX[c] = c * size.width / columns;
+    }
+    for (int r = 0; r <= rows; ++r) {
+        cellY[r] = r * size.height / rows;
+    }
+    sums.assign(static_cast<size_t>(columns) * rows, 0);
+    cells.assign(sums.size(), 0.0f);
+    level = 0.0f;
+    previous.resize(static_cast<size_t>(size.width) * size.height);
+}
+
+bool MotionField::update(const cv::Mat &gray) {
+    if (gray.empty()) {
+        return false;
+    }
+    uint64_t start = ofGetElapsedTimeMicros();
+    int width = gray.cols;
+    if (gray.size() != frameSize) {
+        allocate(gray.size());
+        for (int y = 0; y < gray.rows; ++y) {
+            std::copy_n(gray.ptr<uint8_t>(y), width, previous.data() + static_cast<size_t>(y) * width);
+        }
+        lastMicros = ofGetElapsedTimeMicros() - start;
+        return true;
+    }
+
+    std::function<void(int, int)> band = [&](int begin, int end) {
+        for (int r = begin; r < end; ++r) {
+            uint32_t *rowSums = sums.data() + static_cast<size_t>(r) * columns;
+            std::fill(rowSums, rowSums + columns, 0u);
+            for (int y = cellY[r]; y < cellY[r + 1]; ++y) {
+                const uint8_t *current = gray.ptr<uint8_t>(y);
+                uint8_t *last = previous.data() + static_cast<size_t>(y) * width;
+                for (int c = 0; c < columns; ++c) {
+                    uint32_t sum = 0;
+                    simd::forEachByte(cellX[c], cellX[c + 1], [&](auto lanes, int x) {
+                        using V = decltype(lanes);
+                        V a = V::load(current + x);
+                        V b = V::load(last + x);
+                        sum += simd::sumLanes(simd::max(a, b) - simd::min(a, b));
+                        a.store(last + x);
+                    });
+                    rowSums[c] += sum;
+                }
+            }
+        }
+    };
+    if (pool) {
+        pool->parallelFor(rows, 1, band);
+    } else {
+        band(0, rows);
+    }
+
+    uint64_t total = 0;
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            size_t i = static_cast<size_t>(r) * columns + c;
+            int area = (cellX[c + 1] - cellX[c]) * (cellY[r + 1] - cellY[r]);
+            cells[i] = static_cast<float>(sums[i]) / (255.0f * static_cast<float>(area));
+            total += sums[i];
+        }
+    }
+    level = static_cast<float>(static_cast<double>(total) / (255.0 * width * gray.rows));
+    lastMicros = ofGetElapsedTimeMicros() - start;
+    return true;
+}
+
+float MotionField::sample(float x, float y) const {
+    if (cells.empty() || x < 0.0f || y < 0.0f || x >= frameSize.width || y >= frameSize.height) {
+        return 0.0f;
+    }
+    int c = std::min(columns - 1, static_cast<int>(x) * columns / frameSize.width);
+    int r = std::min(rows - 1, static_cast<int>(y) * rows / frameSize.height);
+    // Cell edges round down, so the estimate can be one cell too far left/up.
+    if (static_cast<int>(x) >= cellX[c + 1]) {
+        ++c;
+    }
+    if (static_cast<int>(y) >= cellY[r + 1]) {
+        ++r;
+    }
+    return getCell(c, r);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "WorkerPool.h"
+
+// Where in the frame things move. Each frame's 8-bit luma is compared with
+// the previous one in a single SIMD pass that sums the absolute difference
+// per cell of a coarse grid (32x18 by default) and leaves the new frame in
+// place of the old one, so the only buffer is the previous frame, allocated
+// once per frame size. Grid rows run as bands on the worker pool.
+class MotionField {
+public:
+    // A null pool runs on the calling thread only.
+    explicit MotionField(WorkerPool *pool = &WorkerPool::shared());
+
+    void setPool(WorkerPool *newPool) { pool = newPool; }
+    // Takes effect on the next reset() or frame size change.
+    void setGrid(int columns, int rows);
+    // Forgets the previous frame.
+    void reset() { frameSize = cv::Size(); }
+
+    // Compares gray (8-bit, 1 channel) with the previous frame and keeps it
+    // for the next call. Returns false if the frame is empty; the first
+    // frame (and any size change) gives an all-zero field.
+    bool update(const cv::Mat &gray);
+
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+    // Mean absolute difference per cell, 0-1, row-major.
+    const std::vector<float> &getCells() const { return cells; }
+    float getCell(int column, int row) const { return cells[static_cast<size_t>(row) * columns + column]; }
+    // The cell holding a point in frame coordinates; 0 outside the frame.
+    float sample(float x, float y) const;
+    // Mean absolute difference over the whole frame, 0-1.
+    float getLevel() const { return level; }
+    uint64_t getLastMicros() const { return lastMicros; }
+
+private:
+    void allocate(const cv::Size &size);
+
+    WorkerPool *pool = nullptr;
+    int gridColumns = 32;
+    int gridRows = 18;
+    int columns = 0;
+    int rows = 0;
+    cv::Size frameSize;
+    std::vector<uint8_t> previous;
+    std::vector<int> cellX; // columns + 1 cell edges in pixels
+    std::vector<int> cellY; // rows + 1
+    std::vector<uint32_t> sums;
+    std::vector<float> cells;
+    float level = 0.0f;
+    uint64_t lastMicros = 0;
+};
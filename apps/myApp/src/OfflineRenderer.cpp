@@ -0,0 +1,236 @@
+#include "OfflineRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+bool endsWith(const std::string &value, const std::string &suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Maps a canvas pixel back to the source pixel for a "cover" fit, matching
+// ofApp::drawTextureCover.
+struct CoverMap {
+    float scale = 1.0f;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+
+    CoverMap(int srcW, int srcH, int dstW, int dstH) {
+        scale = std::max(static_cast<float>(dstW) / srcW, static_cast<float>(dstH) / srcH);
+        offsetX = (dstW - srcW * scale) * 0.5f;
+        offsetY = (dstH - srcH * scale) * 0.5f;
+    }
+
+    int srcX(int x, int srcW) const {
+        return std::min(std::max(static_cast<int>((x + 0.5f - offsetX) / scale), 0), srcW - 1);
+    }
+
+    int srcY(int y, int srcH) const {
+        return std::min(std::max(static_cast<int>((y + 0.5f - offsetY) / scale), 0), srcH - 1);
+    }
+};
+} // namespace
+
+OfflineRenderer::~OfflineRenderer() {
+    close();
+}
+
+bool OfflineRenderer::setup(int width, int height, const std::string &outputPath) {
+    close();
+    this->width = width;
+    this->height = height;
+    this->outputPath = outputPath;
+    canvas.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+    trail.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+    output.allocate(width, height, OF_PIXELS_RGB);
+    framesWritten = 0;
+
+    rawOutput = endsWith(outputPath, ".rgb");
+    if (rawOutput) {
+        rawFile.open(ofToDataPath(outputPath, true), std::ios::binary | std::ios::trunc);
+        if (!rawFile) {
+            ofLogWarning() << "Offline: cannot open " << outputPath;
+            return false;
+        }
+        ofLogNotice() << "Offline: writing raw RGB " << width << "x" << height << " to " << outputPath;
+    } else {
+        if (!ofDirectory::createDirectory(outputPath, true, true) &&
+            !ofDirectory::doesDirectoryExist(outputPath, true)) {
+            ofLogWarning() << "Offline: cannot create " << outputPath;
+            return false;
+        }
+        ofLogNotice() << "Offline: writing PNG sequence to " << outputPath;
+    }
+    return true;
+}
+
+void OfflineRenderer::close() {
+    if (rawFile.is_open()) {
+        rawFile.close();
+    }
+}
+
+void OfflineRenderer::setBackground(const ofPixels &pixels) {
+    hasBackground = pixels.isAllocated() && pixels.getNumChannels() >= 3;
+    if (!hasBackground) {
+        return;
+    }
+    int srcW = pixels.getWidth();
+    int srcH = pixels.getHeight();
+    int channels = pixels.getNumChannels();
+    CoverMap map(srcW, srcH, width, height);
+    background.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *src = pixels.getData() + pixels.getBytesStride() * map.srcY(y, srcH);
+        float *dst = background.data() + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; ++x) {
+            const unsigned char *px = src + map.srcX(x, srcW) * channels;
+            dst[x * 3 + 0] = px[0] / 255.0f;
+            dst[x * 3 + 1] = px[1] / 255.0f;
+            dst[x * 3 + 2] = px[2] / 255.0f;
+        }
+    }
+}
+
+void OfflineRenderer::beginFrame() {
+    if (hasBackground) {
+        std::copy(background.begin(), background.end(), canvas.begin());
+    } else {
+        std::fill(canvas.begin(), canvas.end(), 30.0f / 255.0f);
+    }
+}
+
+void OfflineRenderer::drawCover(const ofPixels &rgba, bool mirrorX) {
+    if (!rgba.isAllocated() || rgba.getNumChannels() != 4) {
+        return;
+    }
+    int srcW = rgba.getWidth();
+    int srcH = rgba.getHeight();
+    CoverMap map(srcW, srcH, width, height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *src = rgba.getData() + rgba.getBytesStride() * map.srcY(y, srcH);
+        float *dst = canvas.data() + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; ++x) {
+            int sx = map.srcX(mirrorX ? (width - 1 - x) : x, srcW);
+            const unsigned char *px = src + sx * 4;
+            float a = px[3] / 255.0f;
+            float inv = 1.0f - a;
+            dst[x * 3 + 0] = (px[0] / 255.0f) * a + dst[x * 3 + 0] * inv;
+            dst[x * 3 + 1] = (px[1] / 255.0f) * a + dst[x * 3 + 1] * inv;
+            dst[x * 3 + 2] = (px[2] / 255.0f) * a + dst[x * 3 + 2] * inv;
+        }
+    }
+}
+
+void OfflineRenderer::fadeTrail(float fade) {
+    float keep = 1.0f - fade;
+    for (size_t i = 0; i < trail.size(); i += 4) {
+        trail[i + 0] *= keep;
+        trail[i + 1] *= keep;
+        trail[i + 2] *= keep;
+        trail[i + 3] = fade * fade + trail[i + 3] * keep;
+    }
+}
+
+void OfflineRenderer::blendTrailPixel(int x, int y, const ofFloatColor &color) {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return;
+    }
+    float *px = trail.data() + (static_cast<size_t>(y) * width + x) * 4;
+    // GL_SRC_ALPHA, GL_ONE (OF_BLENDMODE_ADD), clamped like an 8-bit target.
+    px[0] = std::min(1.0f, px[0] + color.r * color.a);
+    px[1] = std::min(1.0f, px[1] + color.g * color.a);
+    px[2] = std::min(1.0f, px[2] + color.b * color.a);
+    px[3] = std::min(1.0f, px[3] + color.a * color.a);
+}
+
+void OfflineRenderer::addSpark(const ofVec2f &pos, const ofVec2f &prev, const ofFloatColor &color, float size) {
+    float halfLine = std::max(1.0f, size * 0.4f) * 0.5f;
+    float reach = std::max(size, halfLine);
+    int x0 = static_cast<int>(std::floor(std::min(pos.x, prev.x) - reach));
+    int x1 = static_cast<int>(std::ceil(std::max(pos.x, prev.x) + reach));
+    int y0 = static_cast<int>(std::floor(std::min(pos.y, prev.y) - reach));
+    int y1 = static_cast<int>(std::ceil(std::max(pos.y, prev.y) + reach));
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+
+    ofVec2f seg = pos - prev;
+    float segLen2 = seg.lengthSquared();
+    float size2 = size * size;
+    float halfLine2 = halfLine * halfLine;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            ofVec2f p(x + 0.5f, y + 0.5f);
+            ofVec2f toPos = p - pos;
+            if (toPos.lengthSquared() <= size2) {
+                blendTrailPixel(x, y, color);
+            }
+            if (segLen2 > 0.0f) {
+                ofVec2f toPrev = p - prev;
+                float t = ofClamp((toPrev.x * seg.x + toPrev.y * seg.y) / segLen2, 0.0f, 1.0f);
+                ofVec2f closest = prev + seg * t;
+                if ((p - closest).lengthSquared() <= halfLine2) {
+                    blendTrailPixel(x, y, color);
+                }
+            }
+        }
+    }
+}
+
+void OfflineRenderer::compositeTrail() {
+    for (size_t i = 0, j = 0; j < canvas.size(); i += 4, j += 3) {
+        float a = trail[i + 3];
+        canvas[j + 0] = std::min(1.0f, canvas[j + 0] + trail[i + 0] * a);
+        canvas[j + 1] = std::min(1.0f, canvas[j + 1] + trail[i + 1] * a);
+        canvas[j + 2] = std::min(1.0f, canvas[j + 2] + trail[i + 2] * a);
+    }
+}
+
+void OfflineRenderer::drawDisc(float cx, float cy, float radius, const ofFloatColor &color) {
+    int x0 = std::max(0, static_cast<int>(std::floor(cx - radius)));
+    int x1 = std::min(width - 1, static_cast<int>(std::ceil(cx + radius)));
+    int y0 = std::max(0, static_cast<int>(std::floor(cy - radius)));
+    int y1 = std::min(height - 1, static_cast<int>(std::ceil(cy + radius)));
+    float r2 = radius * radius;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            float dx = x + 0.5f - cx;
+            float dy = y + 0.5f - cy;
+            if (dx * dx + dy * dy > r2) {
+                continue;
+            }
+            float *px = canvas.data() + (static_cast<size_t>(y) * width + x) * 3;
+            float inv = 1.0f - color.a;
+            px[0] = color.r * color.a + px[0] * inv;
+            px[1] = color.g * color.a + px[1] * inv;
+            px[2] = color.b * color.a + px[2] * inv;
+        }
+    }
+}
+
+bool OfflineRenderer::writeFrame() {
+    unsigned char *dst = output.getData();
+    for (size_t i = 0; i < canvas.size(); ++i) {
+        dst[i] = static_cast<unsigned char>(std::min(std::max(canvas[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    bool ok = true;
+    if (rawOutput) {
+        rawFile.write(reinterpret_cast<const char *>(dst), static_cast<std::streamsize>(canvas.size()));
+        ok = static_cast<bool>(rawFile);
+    } else {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(framesWritten));
+        ok = ofSaveImage(output, ofFilePath::join(outputPath, name));
+    }
+    if (ok) {
+        framesWritten++;
+    } else {
+        ofLogWarning() << "Offline: failed to write frame " << framesWritten;
+    }
+    return ok;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// CPU canvas used by the headless mode. Mirrors the GL draw order of
+// ofApp::draw() (background, keyed foreground, additive spark trail, beat
+// dot) with the same blend equations, and writes each finished frame to an
+// image sequence directory or a raw RGB file.
+class OfflineRenderer {
+public:
+    ~OfflineRenderer();
+
+    // Paths ending in .rgb are raw interleaved 8-bit RGB frames; anything
+    // else is a directory that receives frame_000000.png, ...
+    bool setup(int width, int height, const std::string &outputPath);
+    void close();
+
+    void setBackground(const ofPixels &pixels);
+    void beginFrame();
+    // Alpha-blends an RGBA image scaled to cover the canvas.
+    void drawCover(const ofPixels &rgba, bool mirrorX);
+    // Darkens the persistent trail layer like the translucent black rectangle.
+    void fadeTrail(float fade);
+    // Additive spark: a disc at pos plus a streak from prev.
+    void addSpark(const ofVec2f &pos, const ofVec2f &prev, const ofFloatColor &color, float size);
+    void compositeTrail();
+    void drawDisc(float x, float y, float radius, const ofFloatColor &color);
+    bool writeFrame();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    uint64_t getFramesWritten() const { return framesWritten; }
+
+private:
+    void blendTrailPixel(int x, int y, const ofFloatColor &color);
+
+    int width = 0;
+    int height = 0;
+    std::vector<float> canvas;  // RGB
+    std::vector<float> trail;   // RGBA, persists across frames
+    std::vector<float> background;
+    bool hasBackground = false;
+    ofPixels output;
+    std::string outputPath;
+    bool rawOutput = false;
+    std::ofstream rawFile;
+    uint64_t framesWritten = 0;
+};
@@ -0,0 +1,238 @@
+#include "PaletteExtractor.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+constexpr auto kIdleWait = std::chrono::milliseconds(5);
+constexpr int kLatticeColumns = 160; // points per row, whatever the image size
+constexpr int kSeedStride = 8;   // points looked at when seeding
+constexpr int kGridColumns = 16;
+constexpr int kGridRows = 9;
+// How far a centre moves towards its new mean per frame.
+constexpr float kBlend = 0.5f;
+} // namespace
+
+int PaletteExtractor::Palette::pick(float u, float v, float r) const {
+    if (!valid()) {
+        return -1;
+    }
+    int column = std::min(std::max(static_cast<int>(u * columns), 0), columns - 1);
+    int row = std::min(std::max(static_cast<int>(v * rows), 0), rows - 1);
+    const uint16_t *counts = cellCounts.data() + (static_cast<size_t>(row) * columns + column) * kColors;
+    int total = 0;
+    for (int i = 0; i < kColors; ++i) {
+        total += counts[i];
+    }
+    if (total == 0) {
+        float target = r;
+        for (int i = 0; i < kColors - 1; ++i) {
+            target -= weights[i];
+            if (target < 0.0f) {
+                return i;
+            }
+        }
+        return kColors - 1;
+    }
+    int target = std::min(static_cast<int>(r * total), total - 1);
+    for (int i = 0; i < kColors - 1; ++i) {
+        target -= counts[i];
+        if (target < 0) {
+            return i;
+        }
+    }
+    return kColors - 1;
+}
+
+PaletteExtractor::~PaletteExtractor() {
+    close();
+}
+
+void PaletteExtractor::setup() {
+    close();
+    running = true;
+    thread = std::thread(&PaletteExtractor::run, this);
+}
+
+void PaletteExtractor::close() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void PaletteExtractor::submitFrame(const FrameRef &frame) {
+    if (!running || !frame || !frame->pyramid().valid()) {
+        return;
+    }
+    input.writeSlot() = frame;
+    input.publish();
+    // The slot handed back is stale; drop its borrow so the ring can reuse it.
+    input.writeSlot().reset();
+    wake.notify_all();
+}
+
+bool PaletteExtractor::consume(Palette &out) {
+    if (!results.consume()) {
+        return false;
+    }
+    out = results.read();
+    return true;
+}
+
+void PaletteExtractor::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (running && !input.consume()) {
+                wake.wait_for(lock, kIdleWait);
+            }
+        }
+        if (!running) {
+            return;
+        }
+
+        FrameRef &frame = input.read();
+        process(frame);
+        frame.reset();
+    }
+}
+
+void PaletteExtractor::processFrame(const FrameRef &frame) {
+    if (running || !frame || !frame->pyramid().valid()) {
+        return;
+    }
+    process(frame);
+}
+
+void PaletteExtractor::process(const FrameRef &frame) {
+    uint64_t start = ofGetElapsedTimeMicros();
+    Palette &result = results.writeSlot();
+    extract(frame->pyramid().bgraHalf, result);
+    result.frameNumber = frame->sequence;
+    result.micros = ofGetElapsedTimeMicros() - start;
+    results.publish();
+}
+
+void PaletteExtractor::seed() {
+    // Farthest-point seeding: start from the middle point, then repeatedly
+    // take the point farthest from every centre so far.
+    centers.assign(kColors * 3, 0.0f);
+    int first = sampleCount / 2;
+    for (int c = 0; c < 3; ++c) {
+        centers[c] = samples[first * 3 + c];
+    }
+    for (int k = 1; k < kColors; ++k) {
+        int farthest = 0;
+        float farthestDistance = -1.0f;
+        for (int i = 0; i < sampleCount; i += kSeedStride) {
+            const uint8_t *p = samples.data() + i * 3;
+            float nearest = 1e9f;
+            for (int j = 0; j < k; ++j) {
+                float dr = p[0] - centers[j * 3];
+                float dg = p[1] - centers[j * 3 + 1];
+                float db = p[2] - centers[j * 3 + 2];
+                nearest = std::min(nearest, dr * dr + dg * dg + db * db);
+            }
+            if (nearest > farthestDistance) {
+                farthestDistance = nearest;
+                farthest = i;
+            }
+        }
+        for (int c = 0; c < 3; ++c) {
+            centers[k * 3 + c] = samples[farthest * 3 + c];
+        }
+    }
+}
+
+void PaletteExtractor::extract(const cv::Mat &bgra, Palette &result) {
+    int step = std::max(1, bgra.cols / kLatticeColumns);
+    int latticeW = bgra.cols / step;
+    int latticeH = bgra.rows / step;
+    if (latticeW <= 0 || latticeH <= 0) {
+        return;
+    }
+    int columns = std::min(kGridColumns, latticeW);
+    int rows = std::min(kGridRows, latticeH);
+    bool resized = latticeW * latticeH != sampleCount;
+    sampleCount = latticeW * latticeH;
+    samples.resize(static_cast<size_t>(sampleCount) * 3);
+    sampleCells.resize(static_cast<size_t>(sampleCount));
+
+    for (int sy = 0; sy < latticeH; ++sy) {
+        const uint8_t *src = bgra.ptr<uint8_t>(sy * step + step / 2);
+        uint8_t *dst = samples.data() + static_cast<size_t>(sy) * latticeW * 3;
+        uint16_t *cells = sampleCells.data() + static_cast<size_t>(sy) * latticeW;
+        int cellRow = sy * rows / latticeH;
+        for (int sx = 0; sx < latticeW; ++sx) {
+            const uint8_t *p = src + (sx * step + step / 2) * 4;
+            dst[sx * 3] = p[2];
+            dst[sx * 3 + 1] = p[1];
+            dst[sx * 3 + 2] = p[0];
+            cells[sx] = static_cast<uint16_t>(cellRow * columns + sx * columns / latticeW);
+        }
+    }
+    if (resized || centers.empty()) {
+        seed();
+    }
+
+    // One k-means step: assign every point to its nearest centre.
+    int center[kColors * 3];
+    for (int i = 0; i < kColors * 3; ++i) {
+        center[i] = static_cast<int>(centers[i] + 0.5f);
+    }
+    int64_t sums[kColors * 3] = {};
+    int counts[kColors] = {};
+    result.columns = columns;
+    result.rows = rows;
+    result.cellCounts.assign(static_cast<size_t>(columns) * rows * kColors, 0);
+    int farthest = 0;
+    int farthestDistance = -1;
+    for (int i = 0; i < sampleCount; ++i) {
+        const uint8_t *p = samples.data() + static_cast<size_t>(i) * 3;
+        int best = 0;
+        int bestDistance = 1 << 30;
+        for (int j = 0; j < kColors; ++j) {
+            int dr = p[0] - center[j * 3];
+            int dg = p[1] - center[j * 3 + 1];
+            int db = p[2] - center[j * 3 + 2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = j;
+            }
+        }
+        sums[best * 3] += p[0];
+        sums[best * 3 + 1] += p[1];
+        sums[best * 3 + 2] += p[2];
+        ++counts[best];
+        ++result.cellCounts[static_cast<size_t>(sampleCells[i]) * kColors + best];
+        if (bestDistance > farthestDistance) {
+            farthestDistance = bestDistance;
+            farthest = i;
+        }
+    }
+
+    // Move each centre part of the way to its mean; an empty one restarts
+    // at the worst-fitting point.
+    result.colors.resize(kColors);
+    result.weights.resize(kColors);
+    for (int j = 0; j < kColors; ++j) {
+        for (int c = 0; c < 3; ++c) {
+            float &value = centers[j * 3 + c];
+            if (counts[j] > 0) {
+                float mean = static_cast<float>(sums[j * 3 + c]) / counts[j];
+                value += (mean - value) * kBlend;
+            } else {
+                value = samples[static_cast<size_t>(farthest) * 3 + c];
+            }
+        }
+        result.colors[j] = ofColor(static_cast<unsigned char>(centers[j * 3] + 0.5f),
+                                   static_cast<unsigned char>(centers[j * 3 + 1] + 0.5f),
+                                   static_cast<unsigned char>(centers[j * 3 + 2] + 0.5f));
+        result.weights[j] = static_cast<float>(counts[j]) / sampleCount;
+    }
+}
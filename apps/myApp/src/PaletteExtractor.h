@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameRing.h"
+#include "LatestValue.h"
+
+// Dominant colours of the camera image for the sparks, on a worker thread.
+// Each submitted frame is sampled on a lattice of about 160 points per row
+// of the scaled BGRA image (160x90 for a 16:9 frame) and runs
+// one k-means step from the previous frame's centres, so the palette
+// converges over a few frames and then follows the scene. Besides the
+// palette, each cell of a 16x9 grid records how many of its points went to
+// each colour, so callers can pick colours that are actually near a point.
+// Headless renders skip setup() and call processFrame() on every frame, so
+// the palette never depends on how fast the worker kept up.
+class PaletteExtractor {
+public:
+    static constexpr int kColors = 6;
+
+    struct Palette {
+        std::vector<ofColor> colors; // kColors once valid, empty before
+        std::vector<float> weights;  // share of all points per colour
+        int columns = 0;
+        int rows = 0;
+        // Points per colour in each cell, kColors per cell, row-major.
+        std::vector<uint16_t> cellCounts;
+        uint64_t frameNumber = 0;
+        uint64_t micros = 0; // worker time for this palette
+
+        bool valid() const { return !colors.empty(); }
+        // A colour index near (u, v) in 0-1 frame coordinates, chosen with
+        // probability proportional to its points in that cell; r in [0, 1).
+        // Falls back to the global weights for an empty cell.
+        int pick(float u, float v, float r) const;
+    };
+
+    ~PaletteExtractor();
+
+    void setup();
+    void close();
+
+    void submitFrame(const FrameRef &frame);
+    // Runs the step for frame on the calling thread and publishes the
+    // result; only without setup().
+    void processFrame(const FrameRef &frame);
+    bool consume(Palette &out);
+
+private:
+    void run();
+    void process(const FrameRef &frame);
+    void extract(const cv::Mat &bgra, Palette &result);
+    void seed();
+
+    LatestValue<FrameRef> input;
+    LatestValue<Palette> results;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    // Worker thread only (or the processFrame() caller).
+    std::vector<uint8_t> samples; // RGB per lattice point
+    std::vector<uint16_t> sampleCells;
+    std::vector<float> centers;   // RGB per colour
+    int sampleCount = 0;
+};
@@ -0,0 +1,152 @@
+#include "PixelInterleave.h"
+
+#if defined(__AVX2__)
+#define INTERLEAVE_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define INTERLEAVE_SSSE3 1
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#define INTERLEAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+constexpr int kRowGrain = 16;
+
+void allocateOutput(ofPixels &rgba, int w, int h) {
+    if (static_cast<int>(rgba.getWidth()) != w ||
+        static_cast<int>(rgba.getHeight()) != h ||
+        rgba.getNumChannels() != 4) {
+        rgba.allocate(w, h, OF_PIXELS_RGBA);
+    }
+}
+
+void interleaveTail(const unsigned char *rgb, const unsigned char *mask, unsigned char *rgba, int begin, int count) {
+    for (int x = begin; x < count; ++x) {
+        rgba[x * 4 + 0] = rgb[x * 3 + 0];
+        rgba[x * 4 + 1] = rgb[x * 3 + 1];
+        rgba[x * 4 + 2] = rgb[x * 3 + 2];
+        rgba[x * 4 + 3] = mask[x];
+    }
+}
+
+#if INTERLEAVE_SSSE3 || INTERLEAVE_AVX2
+// Spreads four packed RGB pixels (the low 12 bytes) to RGBx.
+inline __m128i rgbToRgbx() {
+    return _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+}
+#endif
+
+#if INTERLEAVE_SSSE3
+// Moves mask bytes 4g..4g+3 into the alpha byte of four pixels.
+inline __m128i maskToAlpha(int g) {
+    char b = static_cast<char>(g * 4);
+    return _mm_setr_epi8(-1, -1, -1, b, -1, -1, -1, static_cast<char>(b + 1),
+                         -1, -1, -1, static_cast<char>(b + 2), -1, -1, -1, static_cast<char>(b + 3));
+}
+#endif
+} // namespace
+
+void interleaveRgbMaskRow(const unsigned char *rgb, const unsigned char *mask, unsigned char *rgba, int count) {
+    int x = 0;
+#if INTERLEAVE_AVX2
+    // 8 pixels per step: two 4-pixel groups, one per 128-bit lane. Each
+    // 16-byte load reads 4 bytes past its group, hence the margin.
+    const __m256i shuffle = _mm256_broadcastsi128_si256(rgbToRgbx());
+    for (; x + 10 <= count; x += 8) {
+        const unsigned char *src = rgb + x * 3;
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12));
+        __m256i pixels = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+        __m128i maskBytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask + x));
+        __m256i alpha = _mm256_slli_epi32(_mm256_cvtepu8_epi32(maskBytes), 24);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + x * 4), _mm256_or_si256(pixels, alpha));
+    }
+#elif INTERLEAVE_SSSE3
+    // 16 pixels per step: 48 RGB bytes in three loads, realigned into four
+    // 12-byte groups.
+    const __m128i shuffle = rgbToRgbx();
+    const __m128i alpha0 = maskToAlpha(0);
+    const __m128i alpha1 = maskToAlpha(1);
+    const __m128i alpha2 = maskToAlpha(2);
+    const __m128i alpha3 = maskToAlpha(3);
+    for (; x + 16 <= count; x += 16) {
+        const __m128i *src = reinterpret_cast<const __m128i *>(rgb + x * 3);
+        __m128i a = _mm_loadu_si128(src);
+        __m128i b = _mm_loadu_si128(src + 1);
+        __m128i c = _mm_loadu_si128(src + 2);
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + x));
+        __m128i *dst = reinterpret_cast<__m128i *>(rgba + x * 4);
+        _mm_storeu_si128(dst + 0, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), _mm_shuffle_epi8(m, alpha0)));
+        _mm_storeu_si128(dst + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle),
+                                               _mm_shuffle_epi8(m, alpha1)));
+        _mm_storeu_si128(dst + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle),
+                                               _mm_shuffle_epi8(m, alpha2)));
+        _mm_storeu_si128(dst + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle),
+                                               _mm_shuffle_epi8(m, alpha3)));
+    }
+#elif INTERLEAVE_NEON
+    for (; x + 16 <= count; x += 16) {
+        uint8x16x3_t src = vld3q_u8(rgb + x * 3);
+        uint8x16x4_t dst = {{src.val[0], src.val[1], src.val[2], vld1q_u8(mask + x)}};
+        vst4q_u8(rgba + x * 4, dst);
+    }
+#endif
+    interleaveTail(rgb, mask, rgba, x, count);
+}
+
+void interleaveRgbMask(const cv::Mat &rgb, const cv::Mat &mask, ofPixels &rgba, WorkerPool *pool) {
+    if (rgb.cols <= 0 || rgb.rows <= 0 || mask.cols != rgb.cols || mask.rows != rgb.rows) {
+        return;
+    }
+    allocateOutput(rgba, rgb.cols, rgb.rows);
+    interleaveRgbMask(rgb, mask, rgba.getData(), pool);
+}
+
+void interleaveRgbMask(const cv::Mat &rgb, const cv::Mat &mask, unsigned char *dst, WorkerPool *pool) {
+    int w = rgb.cols;
+    int h = rgb.rows;
+    if (w <= 0 || h <= 0 || mask.cols != w || mask.rows != h) {
+        return;
+    }
+
+    auto rows = [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            interleaveRgbMaskRow(rgb.ptr<unsigned char>(y), mask.ptr<unsigned char>(y),
+                                 dst + static_cast<size_t>(y) * w * 4, w);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(h, kRowGrain, rows);
+    } else {
+        rows(0, h);
+    }
+}
+
+void interleaveRgbMaskScalar(const cv::Mat &rgb, const cv::Mat &mask, ofPixels &rgba) {
+    int w = rgb.cols;
+    int h = rgb.rows;
+    if (w <= 0 || h <= 0 || mask.cols != w || mask.rows != h) {
+        return;
+    }
+    allocateOutput(rgba, w, h);
+
+    unsigned char *dst = rgba.getData();
+    for (int y = 0; y < h; ++y) {
+        interleaveTail(rgb.ptr<unsigned char>(y), mask.ptr<unsigned char>(y),
+                       dst + static_cast<size_t>(y) * w * 4, 0, w);
+    }
+}
+
+const char *getInterleaveBackendName() {
+#if INTERLEAVE_AVX2
+    return "avx2";
+#elif INTERLEAVE_SSSE3
+    return "ssse3";
+#elif INTERLEAVE_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
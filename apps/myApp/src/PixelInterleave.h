@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <opencv2/core.hpp>
+
+#include "WorkerPool.h"
+
+// Packs an 8-bit RGB image and an 8-bit mask into RGBA with the mask as
+// alpha (the bg-sub composite). The row kernel is picked at build time:
+// AVX2 (-mavx2), SSSE3 (-mssse3) or NEON byte shuffles, scalar otherwise.
+// rgba is (re)allocated to the image size if needed; rows run in bands on
+// pool (null = calling thread only).
+void interleaveRgbMask(const cv::Mat &rgb, const cv::Mat &mask, ofPixels &rgba,
+                       WorkerPool *pool = &WorkerPool::shared());
+// Same into caller memory (e.g. a mapped pixel buffer) of rgb.cols * 4 bytes
+// per row, tightly packed.
+void interleaveRgbMask(const cv::Mat &rgb, const cv::Mat &mask, unsigned char *rgba,
+                       WorkerPool *pool = &WorkerPool::shared());
+
+// count pixels of one row.
+void interleaveRgbMaskRow(const unsigned char *rgb, const unsigned char *mask, unsigned char *rgba, int count);
+
+// One byte at a time on the calling thread; the baseline for --bench interleave.
+void interleaveRgbMaskScalar(const cv::Mat &rgb, const cv::Mat &mask, ofPixels &rgba);
+
+const char *getInterleaveBackendName();
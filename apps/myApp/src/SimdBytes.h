@@ -0,0 +1,216 @@
+#pragma once
+
+// Unsigned byte and signed 16-bit vectors for the mask, background and
+// motion kernels, on the same build-time backend as SimdFloat.h. Byte and
+// Short are one-lane versions with the same operations, so a kernel written
+// as a generic lambda runs on full vectors and then on the leftover pixels
+// (see forEachByte/forEachShort).
+
+#include <cstdint>
+
+#include "SimdFloat.h"
+
+namespace simd {
+
+struct Byte {
+    static constexpr int kLanes = 1;
+    uint8_t v;
+
+    static Byte load(const uint8_t *p) { return {*p}; }
+    static Byte set(uint8_t x) { return {x}; }
+    void store(uint8_t *p) const { *p = v; }
+};
+
+inline Byte min(Byte a, Byte b) { return {a.v < b.v ? a.v : b.v}; }
+inline Byte max(Byte a, Byte b) { return {a.v > b.v ? a.v : b.v}; }
+inline Byte subSaturate(Byte a, Byte b) { return {static_cast<uint8_t>(a.v > b.v ? a.v - b.v : 0)}; }
+inline Byte operator+(Byte a, Byte b) { return {static_cast<uint8_t>(a.v + b.v)}; }
+inline Byte operator-(Byte a, Byte b) { return {static_cast<uint8_t>(a.v - b.v)}; }
+inline uint32_t sumLanes(Byte a) { return a.v; }
+
+struct Short {
+    static constexpr int kLanes = 1;
+    int16_t v;
+
+    static Short load(const int16_t *p) { return {*p}; }
+    // Zero-extends kLanes bytes.
+    static Short widen(const uint8_t *p) { return {static_cast<int16_t>(*p)}; }
+    static Short set(int16_t x) { return {x}; }
+    void store(int16_t *p) const { *p = v; }
+    // Saturates to 0-255.
+    void narrow(uint8_t *p) const { *p = static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v); }
+};
+
+inline Short min(Short a, Short b) { return {a.v < b.v ? a.v : b.v}; }
+inline Short max(Short a, Short b) { return {a.v > b.v ? a.v : b.v}; }
+inline Short abs(Short a) { return {static_cast<int16_t>(a.v < 0 ? -a.v : a.v)}; }
+inline Short operator+(Short a, Short b) { return {static_cast<int16_t>(a.v + b.v)}; }
+inline Short operator-(Short a, Short b) { return {static_cast<int16_t>(a.v - b.v)}; }
+inline Short operator&(Short a, Short b) { return {static_cast<int16_t>(a.v & b.v)}; }
+inline Short operator<<(Short a, int n) { return {static_cast<int16_t>(a.v * (1 << n))}; }
+// Arithmetic: rounds towards minus infinity.
+inline Short operator>>(Short a, int n) { return {static_cast<int16_t>(a.v >> n)}; }
+
+#if SIMD_AVX2
+
+struct Bytes {
+    static constexpr int kLanes = 32;
+    __m256i v;
+
+    static Bytes load(const uint8_t *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))}; }
+    static Bytes set(uint8_t x) { return {_mm256_set1_epi8(static_cast<char>(x))}; }
+    void store(uint8_t *p) const { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+};
+
+inline Bytes min(Bytes a, Bytes b) { return {_mm256_min_epu8(a.v, b.v)}; }
+inline Bytes max(Bytes a, Bytes b) { return {_mm256_max_epu8(a.v, b.v)}; }
+inline Bytes subSaturate(Bytes a, Bytes b) { return {_mm256_subs_epu8(a.v, b.v)}; }
+inline Bytes operator+(Bytes a, Bytes b) { return {_mm256_add_epi8(a.v, b.v)}; }
+inline Bytes operator-(Bytes a, Bytes b) { return {_mm256_sub_epi8(a.v, b.v)}; }
+inline uint32_t sumLanes(Bytes a) {
+    __m256i sums = _mm256_sad_epu8(a.v, _mm256_setzero_si256());
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_add_epi64(half, _mm_unpackhi_epi64(half, half))));
+}
+
+struct Shorts {
+    static constexpr int kLanes = 16;
+    __m256i v;
+
+    static Shorts load(const int16_t *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))}; }
+    static Shorts widen(const uint8_t *p) {
+        return {_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))};
+    }
+    static Shorts set(int16_t x) { return {_mm256_set1_epi16(x)}; }
+    void store(int16_t *p) const { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    void narrow(uint8_t *p) const {
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_castsi256_si128(packed));
+    }
+};
+
+inline Shorts min(Shorts a, Shorts b) { return {_mm256_min_epi16(a.v, b.v)}; }
+inline Shorts max(Shorts a, Shorts b) { return {_mm256_max_epi16(a.v, b.v)}; }
+inline Shorts abs(Shorts a) { return {_mm256_abs_epi16(a.v)}; }
+inline Shorts operator+(Shorts a, Shorts b) { return {_mm256_add_epi16(a.v, b.v)}; }
+inline Shorts operator-(Shorts a, Shorts b) { return {_mm256_sub_epi16(a.v, b.v)}; }
+inline Shorts operator&(Shorts a, Shorts b) { return {_mm256_and_si256(a.v, b.v)}; }
+inline Shorts operator<<(Shorts a, int n) { return {_mm256_sll_epi16(a.v, _mm_cvtsi32_si128(n))}; }
+inline Shorts operator>>(Shorts a, int n) { return {_mm256_sra_epi16(a.v, _mm_cvtsi32_si128(n))}; }
+
+#elif SIMD_SSE
+
+struct Bytes {
+    static constexpr int kLanes = 16;
+    __m128i v;
+
+    static Bytes load(const uint8_t *p) { return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))}; }
+    static Bytes set(uint8_t x) { return {_mm_set1_epi8(static_cast<char>(x))}; }
+    void store(uint8_t *p) const { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+};
+
+inline Bytes min(Bytes a, Bytes b) { return {_mm_min_epu8(a.v, b.v)}; }
+inline Bytes max(Bytes a, Bytes b) { return {_mm_max_epu8(a.v, b.v)}; }
+inline Bytes subSaturate(Bytes a, Bytes b) { return {_mm_subs_epu8(a.v, b.v)}; }
+inline Bytes operator+(Bytes a, Bytes b) { return {_mm_add_epi8(a.v, b.v)}; }
+inline Bytes operator-(Bytes a, Bytes b) { return {_mm_sub_epi8(a.v, b.v)}; }
+inline uint32_t sumLanes(Bytes a) {
+    __m128i sums = _mm_sad_epu8(a.v, _mm_setzero_si128());
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_add_epi64(sums, _mm_unpackhi_epi64(sums, sums))));
+}
+
+struct Shorts {
+    static constexpr int kLanes = 8;
+    __m128i v;
+
+    static Shorts load(const int16_t *p) { return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))}; }
+    static Shorts widen(const uint8_t *p) {
+        return {_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128())};
+    }
+    static Shorts set(int16_t x) { return {_mm_set1_epi16(x)}; }
+    void store(int16_t *p) const { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+    void narrow(uint8_t *p) const { _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(v, v)); }
+};
+
+inline Shorts min(Shorts a, Shorts b) { return {_mm_min_epi16(a.v, b.v)}; }
+inline Shorts max(Shorts a, Shorts b) { return {_mm_max_epi16(a.v, b.v)}; }
+// SSE2 has no abs for 16-bit lanes.
+inline Shorts abs(Shorts a) { return {_mm_max_epi16(a.v, _mm_sub_epi16(_mm_setzero_si128(), a.v))}; }
+inline Shorts operator+(Shorts a, Shorts b) { return {_mm_add_epi16(a.v, b.v)}; }
+inline Shorts operator-(Shorts a, Shorts b) { return {_mm_sub_epi16(a.v, b.v)}; }
+inline Shorts operator&(Shorts a, Shorts b) { return {_mm_and_si128(a.v, b.v)}; }
+inline Shorts operator<<(Shorts a, int n) { return {_mm_sll_epi16(a.v, _mm_cvtsi32_si128(n))}; }
+inline Shorts operator>>(Shorts a, int n) { return {_mm_sra_epi16(a.v, _mm_cvtsi32_si128(n))}; }
+
+#elif SIMD_NEON
+
+struct Bytes {
+    static constexpr int kLanes = 16;
+    uint8x16_t v;
+
+    static Bytes load(const uint8_t *p) { return {vld1q_u8(p)}; }
+    static Bytes set(uint8_t x) { return {vdupq_n_u8(x)}; }
+    void store(uint8_t *p) const { vst1q_u8(p, v); }
+};
+
+inline Bytes min(Bytes a, Bytes b) { return {vminq_u8(a.v, b.v)}; }
+inline Bytes max(Bytes a, Bytes b) { return {vmaxq_u8(a.v, b.v)}; }
+inline Bytes subSaturate(Bytes a, Bytes b) { return {vqsubq_u8(a.v, b.v)}; }
+inline Bytes operator+(Bytes a, Bytes b) { return {vaddq_u8(a.v, b.v)}; }
+inline Bytes operator-(Bytes a, Bytes b) { return {vsubq_u8(a.v, b.v)}; }
+inline uint32_t sumLanes(Bytes a) { return vaddlvq_u8(a.v); }
+
+struct Shorts {
+    static constexpr int kLanes = 8;
+    int16x8_t v;
+
+    static Shorts load(const int16_t *p) { return {vld1q_s16(p)}; }
+    static Shorts widen(const uint8_t *p) { return {vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)))}; }
+    static Shorts set(int16_t x) { return {vdupq_n_s16(x)}; }
+    void store(int16_t *p) const { vst1q_s16(p, v); }
+    void narrow(uint8_t *p) const { vst1_u8(p, vqmovun_s16(v)); }
+};
+
+inline Shorts min(Shorts a, Shorts b) { return {vminq_s16(a.v, b.v)}; }
+inline Shorts max(Shorts a, Shorts b) { return {vmaxq_s16(a.v, b.v)}; }
+inline Shorts abs(Shorts a) { return {vabsq_s16(a.v)}; }
+inline Shorts operator+(Shorts a, Shorts b) { return {vaddq_s16(a.v, b.v)}; }
+inline Shorts operator-(Shorts a, Shorts b) { return {vsubq_s16(a.v, b.v)}; }
+inline Shorts operator&(Shorts a, Shorts b) { return {vandq_s16(a.v, b.v)}; }
+inline Shorts operator<<(Shorts a, int n) { return {vshlq_s16(a.v, vdupq_n_s16(static_cast<int16_t>(n)))}; }
+inline Shorts operator>>(Shorts a, int n) { return {vshlq_s16(a.v, vdupq_n_s16(static_cast<int16_t>(-n)))}; }
+
+#else
+
+using Bytes = Byte;
+using Shorts = Short;
+
+#endif
+
+// Calls fn(Bytes(), x) for each full vector in [begin, end), then
+// fn(Byte(), x) for each pixel left; fn picks its types from the first
+// argument.
+template <typename Fn>
+inline void forEachByte(int begin, int end, Fn &&fn) {
+    int x = begin;
+    for (; x + Bytes::kLanes <= end; x += Bytes::kLanes) {
+        fn(Bytes(), x);
+    }
+    for (; x < end; ++x) {
+        fn(Byte(), x);
+    }
+}
+
+// Same with Shorts and Short.
+template <typename Fn>
+inline void forEachShort(int begin, int end, Fn &&fn) {
+    int x = begin;
+    for (; x + Shorts::kLanes <= end; x += Shorts::kLanes) {
+        fn(Shorts(), x);
+    }
+    for (; x < end; ++x) {
+        fn(Short(), x);
+    }
+}
+
+} // namespace simd
@@ -0,0 +1,360 @@
+#pragma once
+
+// Thin float/int vector types for the CPU image kernels. The widest
+// instruction set the compiler targets is picked at build time: AVX2 (build
+// with -mavx2 -mfma), SSE2/SSE4.1 (default on x86_64), NEON (arm64), or a
+// one-lane scalar fallback. Kernels are written once against this interface.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMD_SCALAR 1
+#endif
+
+namespace simd {
+
+#if SIMD_AVX2
+
+constexpr int kLanes = 8;
+inline const char *backendName() { return "avx2"; }
+
+struct Mask { __m256 v; };
+struct Int { __m256i v; };
+struct Float { __m256 v; };
+
+inline Float set(float x) { return {_mm256_set1_ps(x)}; }
+inline Float load(const float *p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float *p, Float a) { _mm256_storeu_ps(p, a.v); }
+inline void store(int32_t *p, Int a) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a.v); }
+// Lane offsets 0, 1, 2, ...
+inline Float iota() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+
+inline Float operator+(Float a, Float b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Float operator/(Float a, Float b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Float min(Float a, Float b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Float abs(Float a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+inline Float floor(Float a) { return {_mm256_floor_ps(a.v)}; }
+inline Float sqrt(Float a) { return {_mm256_sqrt_ps(a.v)}; }
+
+inline Mask operator<(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline Mask operator<=(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline Mask operator>(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+// m ? a : b per lane.
+inline Float select(Mask m, Float a, Float b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+
+inline Int set(int32_t x) { return {_mm256_set1_epi32(x)}; }
+inline Int operator+(Int a, Int b) { return {_mm256_add_epi32(a.v, b.v)}; }
+inline Int operator-(Int a, Int b) { return {_mm256_sub_epi32(a.v, b.v)}; }
+inline Int operator&(Int a, Int b) { return {_mm256_and_si256(a.v, b.v)}; }
+inline Int operator|(Int a, Int b) { return {_mm256_or_si256(a.v, b.v)}; }
+template <int N> inline Int shiftLeft(Int a) { return {_mm256_slli_epi32(a.v, N)}; }
+template <int N> inline Int shiftRight(Int a) { return {_mm256_srli_epi32(a.v, N)}; }
+// Truncates toward zero like a C cast.
+inline Int toInt(Float a) { return {_mm256_cvttps_epi32(a.v)}; }
+inline Float toFloat(Int a) { return {_mm256_cvtepi32_ps(a.v)}; }
+inline Int asInt(Float a) { return {_mm256_castps_si256(a.v)}; }
+inline Float asFloat(Int a) { return {_mm256_castsi256_ps(a.v)}; }
+inline Float gather(const float *base, Int index) { return {_mm256_i32gather_ps(base, index.v, 4)}; }
+
+#elif SIMD_SSE
+
+constexpr int kLanes = 4;
+#if defined(__SSE4_1__)
+inline const char *backendName() { return "sse4.1"; }
+#else
+inline const char *backendName() { return "sse2"; }
+#endif
+
+struct Mask { __m128 v; };
+struct Int { __m128i v; };
+struct Float { __m128 v; };
+
+inline Float set(float x) { return {_mm_set1_ps(x)}; }
+inline Float load(const float *p) { return {_mm_loadu_ps(p)}; }
+inline void store(float *p, Float a) { _mm_storeu_ps(p, a.v); }
+inline void store(int32_t *p, Int a) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a.v); }
+inline Float iota() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+
+inline Float operator+(Float a, Float b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float operator/(Float a, Float b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float min(Float a, Float b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Float abs(Float a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+inline Float sqrt(Float a) { return {_mm_sqrt_ps(a.v)}; }
+
+inline Mask operator<(Float a, Float b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask operator<=(Float a, Float b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Mask operator>(Float a, Float b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Float select(Mask m, Float a, Float b) {
+#if defined(__SSE4_1__)
+    return {_mm_blendv_ps(b.v, a.v, m.v)};
+#else
+    return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+#endif
+}
+
+inline Int set(int32_t x) { return {_mm_set1_epi32(x)}; }
+inline Int operator+(Int a, Int b) { return {_mm_add_epi32(a.v, b.v)}; }
+inline Int operator-(Int a, Int b) { return {_mm_sub_epi32(a.v, b.v)}; }
+inline Int operator&(Int a, Int b) { return {_mm_and_si128(a.v, b.v)}; }
+inline Int operator|(Int a, Int b) { return {_mm_or_si128(a.v, b.v)}; }
+template <int N> inline Int shiftLeft(Int a) { return {_mm_slli_epi32(a.v, N)}; }
+template <int N> inline Int shiftRight(Int a) { return {_mm_srli_epi32(a.v, N)}; }
+inline Int toInt(Float a) { return {_mm_cvttps_epi32(a.v)}; }
+inline Float toFloat(Int a) { return {_mm_cvtepi32_ps(a.v)}; }
+inline Int asInt(Float a) { return {_mm_castps_si128(a.v)}; }
+inline Float asFloat(Int a) { return {_mm_castsi128_ps(a.v)}; }
+
+inline Float floor(Float a) {
+#if defined(__SSE4_1__)
+    return {_mm_floor_ps(a.v)};
+#else
+    // Truncate, then step down where truncation rounded up (negative inputs).
+    // Inputs here stay far below 2^31.
+    Float t = toFloat(toInt(a));
+    return t - select(a < t, set(1.0f), set(0.0f));
+#endif
+}
+
+inline Float gather(const float *base, Int index) {
+    alignas(16) int32_t i[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(i), index.v);
+    return {_mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]])};
+}
+
+#elif SIMD_NEON
+
+constexpr int kLanes = 4;
+inline const char *backendName() { return "neon"; }
+
+struct Mask { uint32x4_t v; };
+struct Int { int32x4_t v; };
+struct Float { float32x4_t v; };
+
+inline Float set(float x) { return {vdupq_n_f32(x)}; }
+inline Float load(const float *p) { return {vld1q_f32(p)}; }
+inline void store(float *p, Float a) { vst1q_f32(p, a.v); }
+inline void store(int32_t *p, Int a) { vst1q_s32(p, a.v); }
+inline Float iota() {
+    static const float lanes[4] = {0, 1, 2, 3};
+    return {vld1q_f32(lanes)};
+}
+
+inline Float operator+(Float a, Float b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {vmulq_f32(a.v, b.v)}; }
+inline Float operator/(Float a, Float b) { return {vdivq_f32(a.v, b.v)}; }
+inline Float min(Float a, Float b) { return {vminq_f32(a.v, b.v)}; }
+inline Float max(Float a, Float b) { return {vmaxq_f32(a.v, b.v)}; }
+inline Float abs(Float a) { return {vabsq_f32(a.v)}; }
+inline Float floor(Float a) { return {vrndmq_f32(a.v)}; }
+inline Float sqrt(Float a) { return {vsqrtq_f32(a.v)}; }
+
+inline Mask operator<(Float a, Float b) { return {vcltq_f32(a.v, b.v)}; }
+inline Mask operator<=(Float a, Float b) { return {vcleq_f32(a.v, b.v)}; }
+inline Mask operator>(Float a, Float b) { return {vcgtq_f32(a.v, b.v)}; }
+inline Mask operator&(Mask a, Mask b) { return {vandq_u32(a.v, b.v)}; }
+inline Float select(Mask m, Float a, Float b) { return {vbslq_f32(m.v, a.v, b.v)}; }
+
+inline Int set(int32_t x) { return {vdupq_n_s32(x)}; }
+inline Int operator+(Int a, Int b) { return {vaddq_s32(a.v, b.v)}; }
+inline Int operator-(Int a, Int b) { return {vsubq_s32(a.v, b.v)}; }
+inline Int operator&(Int a, Int b) { return {vandq_s32(a.v, b.v)}; }
+inline Int operator|(Int a, Int b) { return {vorrq_s32(a.v, b.v)}; }
+template <int N> inline Int shiftLeft(Int a) { return {vshlq_n_s32(a.v, N)}; }
+template <int N> inline Int shiftRight(Int a) {
+    return {vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a.v), N))};
+}
+inline Int toInt(Float a) { return {vcvtq_s32_f32(a.v)}; }
+inline Float toFloat(Int a) { return {vcvtq_f32_s32(a.v)}; }
+inline Int asInt(Float a) { return {vreinterpretq_s32_f32(a.v)}; }
+inline Float asFloat(Int a) { return {vreinterpretq_f32_s32(a.v)}; }
+
+inline Float gather(const float *base, Int index) {
+    int32_t i[4];
+    vst1q_s32(i, index.v);
+    float values[4] = {base[i[0]], base[i[1]], base[i[2]], base[i[3]]};
+    return {vld1q_f32(values)};
+}
+
+#else
+
+constexpr int kLanes = 1;
+inline const char *backendName() { return "scalar"; }
+
+struct Mask { bool v; };
+struct Int { int32_t v; };
+struct Float { float v; };
+
+inline Float set(float x) { return {x}; }
+inline Float load(const float *p) { return {*p}; }
+inline void store(float *p, Float a) { *p = a.v; }
+inline void store(int32_t *p, Int a) { *p = a.v; }
+inline Float iota() { return {0.0f}; }
+
+inline Float operator+(Float a, Float b) { return {a.v + b.v}; }
+inline Float operator-(Float a, Float b) { return {a.v - b.v}; }
+inline Float operator*(Float a, Float b) { return {a.v * b.v}; }
+inline Float operator/(Float a, Float b) { return {a.v / b.v}; }
+inline Float min(Float a, Float b) { return {b.v < a.v ? b.v : a.v}; }
+inline Float max(Float a, Float b) { return {a.v < b.v ? b.v : a.v}; }
+inline Float abs(Float a) { return {std::fabs(a.v)}; }
+inline Float floor(Float a) { return {std::floor(a.v)}; }
+inline Float sqrt(Float a) { return {std::sqrt(a.v)}; }
+
+inline Mask operator<(Float a, Float b) { return {a.v < b.v}; }
+inline Mask operator<=(Float a, Float b) { return {a.v <= b.v}; }
+inline Mask operator>(Float a, Float b) { return {a.v > b.v}; }
+inline Mask operator&(Mask a, Mask b) { return {a.v && b.v}; }
+inline Float select(Mask m, Float a, Float b) { return m.v ? a : b; }
+
+inline Int set(int32_t x) { return {x}; }
+inline Int operator+(Int a, Int b) { return {a.v + b.v}; }
+inline Int operator-(Int a, Int b) { return {a.v - b.v}; }
+inline Int operator&(Int a, Int b) { return {a.v & b.v}; }
+inline Int operator|(Int a, Int b) { return {a.v | b.v}; }
+template <int N> inline Int shiftLeft(Int a) { return {static_cast<int32_t>(static_cast<uint32_t>(a.v) << N)}; }
+template <int N> inline Int shiftRight(Int a) { return {static_cast<int32_t>(static_cast<uint32_t>(a.v) >> N)}; }
+inline Int toInt(Float a) { return {static_cast<int32_t>(a.v)}; }
+inline Float toFloat(Int a) { return {static_cast<float>(a.v)}; }
+inline Int asInt(Float a) { int32_t i; std::memcpy(&i, &a.v, sizeof(i)); return {i}; }
+inline Float asFloat(Int a) { float f; std::memcpy(&f, &a.v, sizeof(f)); return {f}; }
+inline Float gather(const float *base, Int index) { return {base[index.v]}; }
+
+#endif
+
+// Shared helpers and polynomial approximations (Cephes single precision,
+// ~1e-7 relative error) built on the primitives above.
+
+inline Float operator-(Float a) { return set(0.0f) - a; }
+inline Float clamp(Float a, Float lo, Float hi) { return min(max(a, lo), hi); }
+inline Float fract(Float a) { return a - floor(a); }
+inline Float mix(Float a, Float b, Float t) { return a + (b - a) * t; }
+// GLSL step(edge, x): 0 where x < edge, else 1.
+inline Float step(Float edge, Float x) { return select(x < edge, set(0.0f), set(1.0f)); }
+inline Float smoothstep(Float e0, Float e1, Float x) {
+    Float t = clamp((x - e0) / (e1 - e0), set(0.0f), set(1.0f));
+    return t * t * (set(3.0f) - set(2.0f) * t);
+}
+// GLSL mod: x - y * floor(x / y).
+inline Float mod(Float x, Float y) { return x - y * floor(x / y); }
+
+inline Float exp(Float x) {
+    x = clamp(x, set(-87.0f), set(88.0f));
+    Float fx = floor(x * set(1.44269504088896341f) + set(0.5f));
+    x = x - fx * set(0.693359375f) - fx * set(-2.12194440e-4f);
+    Float z = x * x;
+    Float y = set(1.9875691500e-4f);
+    y = y * x + set(1.3981999507e-3f);
+    y = y * x + set(8.3334519073e-3f);
+    y = y * x + set(4.1665795894e-2f);
+    y = y * x + set(1.6666665459e-1f);
+    y = y * x + set(5.0000001201e-1f);
+    y = y * z + x + set(1.0f);
+    Float scale = asFloat(shiftLeft<23>(toInt(fx) + set(127)));
+    return y * scale;
+}
+
+// Natural log for x > 0.
+inline Float log(Float x) {
+    Int bits = asInt(x);
+    Float e = toFloat((shiftRight<23>(bits) & set(0xff)) - set(126));
+    // Mantissa in [0.5, 1).
+    Float m = asFloat((bits & set(0x007fffff)) | set(0x3f000000));
+    Mask small = m < set(0.707106781186547524f);
+    e = e - select(small, set(1.0f), set(0.0f));
+    m = select(small, m + m, m) - set(1.0f);
+
+    Float z = m * m;
+    Float y = set(7.0376836292e-2f);
+    y = y * m + set(-1.1514610310e-1f);
+    y = y * m + set(1.1676998740e-1f);
+    y = y * m + set(-1.2420140846e-1f);
+    y = y * m + set(1.4249322787e-1f);
+    y = y * m + set(-1.6668057665e-1f);
+    y = y * m + set(2.0000714765e-1f);
+    y = y * m + set(-2.4999993993e-1f);
+    y = y * m + set(3.3333331174e-1f);
+    y = y * m * z;
+    y = y + e * set(-2.12194440e-4f);
+    y = y - z * set(0.5f);
+    return m + y + e * set(0.693359375f);
+}
+
+// x^y for x >= 0, y > 0 (pow(0, y) is 0).
+inline Float pow(Float x, Float y) {
+    Mask zero = x <= set(0.0f);
+    Float r = exp(y * log(max(x, set(1e-30f))));
+    return select(zero, set(0.0f), r);
+}
+
+inline Float atan2(Float y, Float x) {
+    Float ax = abs(x);
+    Float ay = abs(y);
+    Float mx = max(ax, ay);
+    Float mn = min(ax, ay);
+    Float a = mn / max(mx, set(1e-30f));
+    // Reduce to |z| <= tan(pi/8).
+    Mask reduce = a > set(0.4142135623730950f);
+    Float z = select(reduce, (a - set(1.0f)) / (a + set(1.0f)), a);
+    Float base = select(reduce, set(0.78539816339744830962f), set(0.0f));
+    Float z2 = z * z;
+    Float p = set(8.05374449538e-2f);
+    p = p * z2 - set(1.38776856032e-1f);
+    p = p * z2 + set(1.99777106478e-1f);
+    p = p * z2 - set(3.33329491539e-1f);
+    Float r = base + p * z2 * z + z;
+    r = select(ay > ax, set(1.57079632679489661923f) - r, r);
+    r = select(x < set(0.0f), set(3.14159265358979323846f) - r, r);
+    return select(y < set(0.0f), -r, r);
+}
+
+inline void sincos(Float x, Float &s, Float &c) {
+    Mask negative = x < set(0.0f);
+    x = abs(x);
+    Float j = floor(x * set(1.27323954473516f));
+    // Round the octant up to even.
+    j = j + (j - set(2.0f) * floor(j * set(0.5f)));
+    x = ((x - j * set(0.78515625f)) - j * set(2.4187564849853515625e-4f)) - j * set(3.77489497744594108e-8f);
+    Float quadrant = j * set(0.5f) - set(4.0f) * floor(j * set(0.125f));
+
+    Float z = x * x;
+    Float yc = set(2.443315711809948e-5f);
+    yc = yc * z - set(1.388731625493765e-3f);
+    yc = yc * z + set(4.166664568298827e-2f);
+    yc = yc * z * z - z * set(0.5f) + set(1.0f);
+    Float ys = set(-1.9515295891e-4f);
+    ys = ys * z + set(8.3321608736e-3f);
+    ys = ys * z - set(1.6666654611e-1f);
+    ys = ys * z * x + x;
+
+    Mask swap = (quadrant - set(2.0f) * floor(quadrant * set(0.5f))) > set(0.5f);
+    Float s0 = select(swap, yc, ys);
+    Float c0 = select(swap, ys, yc);
+    s0 = select(quadrant > set(1.5f), -s0, s0);
+    s = select(negative, -s0, s0);
+    c = select((quadrant > set(0.5f)) & (quadrant < set(2.5f)), -c0, c0);
+}
+
+} // namespace simd
@@ -0,0 +1,110 @@
+#include "SparkPool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "SimdFloat.h"
+
+namespace {
+constexpr size_t kAlignFloats = 16; // 64 bytes, a multiple of every vector width
+// Sparks per integrate() task; a multiple of kAlignFloats, so every chunk
+// starts on a whole vector.
+constexpr int kChunk = 4096;
+} // namespace
+
+void SparkPool::setCapacity(int newCapacity) {
+    capacity = std::max(0, newCapacity);
+    count = 0;
+    nextReplaced = 0;
+    size_t stride = (static_cast<size_t>(capacity) + kAlignFloats - 1) / kAlignFloats * kAlignFloats;
+    storage.assign(stride * kFieldCount + kAlignFloats, 0.0f);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    uintptr_t alignment = kAlignFloats * sizeof(float);
+    float *base = storage.data() + ((alignment - address % alignment) % alignment) / sizeof(float);
+    for (int f = 0; f < kFieldCount; ++f) {
+        fields[f] = base + stride * f;
+    }
+}
+
+void SparkPool::add(const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &color, float life, float size) {
+    if (capacity == 0) {
+        return;
+    }
+    int i = count;
+    if (count < capacity) {
+        ++count;
+    } else {
+        i = nextReplaced;
+        nextReplaced = (nextReplaced + 1) % capacity;
+    }
+    fields[PosX][i] = pos.x;
+    fields[PosY][i] = pos.y;
+    fields[PrevX][i] = pos.x;
+    fields[PrevY][i] = pos.y;
+    fields[VelX][i] = vel.x;
+    fields[VelY][i] = vel.y;
+    fields[Red][i] = color.r;
+    fields[Green][i] = color.g;
+    fields[Blue][i] = color.b;
+    fields[Age][i] = 0.0f;
+    fields[Life][i] = life;
+    fields[Size][i] = size;
+}
+
+void SparkPool::integrate(float dt, float drag, float gravity, WorkerPool *pool) {
+    int chunks = (count + kChunk - 1) / kChunk;
+    if (pool && chunks > 1) {
+        pool->parallelFor(chunks, 1, [&](int begin, int end) {
+            integrateRange(begin * kChunk, std::min(end * kChunk, count), dt, drag, gravity);
+        });
+    } else {
+        integrateRange(0, count, dt, drag, gravity);
+    }
+    removeDead();
+}
+
+void SparkPool::integrateRange(int begin, int end, float dt, float drag, float gravity) {
+    using simd::Float;
+    Float step = simd::set(dt);
+    Float dragFactor = simd::set(drag);
+    Float fall = simd::set(gravity * dt);
+    float *posX = fields[PosX];
+    float *posY = fields[PosY];
+    float *velX = fields[VelX];
+    float *velY = fields[VelY];
+    float *age = fields[Age];
+    // Lanes past count belong to dead or never-used slots; the arrays are
+    // padded, so they are simply computed and ignored.
+    for (int i = begin; i < end; i += simd::kLanes) {
+        Float x = simd::load(posX + i);
+        Float y = simd::load(posY + i);
+        simd::store(fields[PrevX] + i, x);
+        simd::store(fields[PrevY] + i, y);
+        Float vx = simd::load(velX + i) * dragFactor;
+        Float vy = simd::load(velY + i) * dragFactor + fall;
+        simd::store(velX + i, vx);
+        simd::store(velY + i, vy);
+        simd::store(posX + i, x + vx * step);
+        simd::store(posY + i, y + vy * step);
+        simd::store(age + i, simd::load(age + i) + step);
+    }
+}
+
+void SparkPool::removeDead() {
+    const float *age = fields[Age];
+    const float *life = fields[Life];
+    int i = 0;
+    while (i < count) {
+        if (age[i] < life[i]) {
+            ++i;
+            continue;
+        }
+        --count;
+        for (int f = 0; f < kFieldCount; ++f) {
+            fields[f][i] = fields[f][count];
+        }
+    }
+    if (nextReplaced >= count) {
+        nextReplaced = 0;
+    }
+}
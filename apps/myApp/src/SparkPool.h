@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <vector>
+
+#include "WorkerPool.h"
+
+// Fixed-capacity store for the hand sparks, one array per attribute
+// (structure of arrays), each 64-byte aligned and padded to a whole number
+// of vectors so integrate() runs SimdFloat.h vectors over every live spark
+// without a scalar tail. Live sparks are packed at the front: add() appends,
+// dead sparks are swap-removed, both O(1). When the pool is full a new
+// spark replaces an old one in round-robin slot order.
+//
+// integrate() splits the sparks into fixed-size chunks on the worker pool.
+// Chunks are whole vectors and the removal pass is serial, so the result is
+// bit-identical for any thread count.
+class SparkPool {
+public:
+    enum Field {
+        PosX,
+        PosY,
+        PrevX,
+        PrevY,
+        VelX,
+        VelY,
+        Red,
+        Green,
+        Blue,
+        Age,
+        Life,
+        Size,
+        kFieldCount,
+    };
+
+    // Drops every spark.
+    void setCapacity(int capacity);
+    int getCapacity() const { return capacity; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+
+    void add(const ofVec2f &pos, const ofVec2f &vel, const ofFloatColor &color, float life, float size);
+
+    // Moves every spark one step (prev = pos, drag, gravity, age) and removes
+    // the ones past their life. drag is the velocity factor for this step. A
+    // null pool runs on the calling thread only.
+    void integrate(float dt, float drag, float gravity, WorkerPool *pool = &WorkerPool::shared());
+
+    // The first size() values of a field; valid until the next add(),
+    // integrate() or setCapacity().
+    const float *field(Field f) const { return fields[f]; }
+    ofVec2f getPos(int i) const { return {fields[PosX][i], fields[PosY][i]}; }
+    ofVec2f getPrev(int i) const { return {fields[PrevX][i], fields[PrevY][i]}; }
+    ofFloatColor getColor(int i) const { return {fields[Red][i], fields[Green][i], fields[Blue][i], 1.0f}; }
+    float getAge(int i) const { return fields[Age][i]; }
+    float getLife(int i) const { return fields[Life][i]; }
+    float getSize(int i) const { return fields[Size][i]; }
+
+private:
+    void integrateRange(int begin, int end, float dt, float drag, float gravity);
+    void removeDead();
+
+    std::vector<float> storage;
+    float *fields[kFieldCount] = {};
+    int capacity = 0;
+    int count = 0;
+    int nextReplaced = 0;
+};
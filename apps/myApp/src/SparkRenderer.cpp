@@ -0,0 +1,141 @@
+#include "SparkRenderer.h"
+
+namespace {
+// Per-instance attributes: the SparkPool fields the shader reads (not the
+// velocity). Locations are contiguous after openFrameworks' default
+// attributes, and GL only guarantees 16.
+struct InstanceAttribute {
+    SparkPool::Field field;
+    const char *name;
+};
+const InstanceAttribute kAttributes[] = {
+    {SparkPool::PosX, "posX"},   {SparkPool::PosY, "posY"},   {SparkPool::PrevX, "prevX"},
+    {SparkPool::PrevY, "prevY"}, {SparkPool::Red, "red"},     {SparkPool::Green, "green"},
+    {SparkPool::Blue, "blue"},   {SparkPool::Age, "age"},     {SparkPool::Life, "life"},
+    {SparkPool::Size, "size"},
+};
+constexpr int kAttributeCount = sizeof(kAttributes) / sizeof(kAttributes[0]);
+constexpr int kFirstAttributeLocation = 5;
+static_assert(kFirstAttributeLocation + kAttributeCount - 1 < 16,
+              "instance attribute locations must stay below GL_MAX_VERTEX_ATTRIBS (16)");
+
+// Matches ofApp::sparkAppearance: alpha falls off as t^2 and the radius
+// halves over the spark's life; the streak is max(1, 0.4 * radius) wide.
+const char *kVertexSource = R"(#version 150
+uniform mat4 modelViewProjectionMatrix;
+uniform float opacity;
+uniform int streak;
+
+in vec4 position; // unit quad corner
+in float posX;
+in float posY;
+in float prevX;
+in float prevY;
+in float red;
+in float green;
+in float blue;
+in float age;
+in float life;
+in float size;
+
+out vec4 vColor;
+out vec2 vCorner;
+
+void main() {
+    float t = clamp(1.0 - age / life, 0.0, 1.0);
+    float radius = size * (0.5 + 0.5 * t);
+    vColor = vec4(red, green, blue, t * t * opacity);
+
+    vec2 pos = vec2(posX, posY);
+    vec2 corner = position.xy;
+    vec2 p;
+    if (streak == 0) {
+        p = pos + corner * radius;
+        vCorner = corner;
+    } else {
+        vec2 prev = vec2(prevX, prevY);
+        vec2 d = pos - prev;
+        float len = length(d);
+        vec2 dir = len > 1e-4 ? d / len : vec2(1.0, 0.0);
+        float halfWidth = 0.5 * max(1.0, radius * 0.4);
+        p = mix(prev, pos, corner.x * 0.5 + 0.5) + vec2(-dir.y, dir.x) * corner.y * halfWidth;
+        vCorner = vec2(0.0);
+    }
+    gl_Position = modelViewProjectionMatrix * vec4(p, 0.0, 1.0);
+}
+)";
+
+const char *kFragmentSource = R"(#version 150
+in vec4 vColor;
+in vec2 vCorner;
+out vec4 outputColor;
+
+void main() {
+    if (dot(vCorner, vCorner) > 1.0) {
+        discard;
+    }
+    outputColor = vColor;
+}
+)";
+} // namespace
+
+bool SparkRenderer::setup() {
+    ready = shader.setupShaderFromSource(GL_VERTEX_SHADER, kVertexSource) &&
+            shader.setupShaderFromSource(GL_FRAGMENT_SHADER, kFragmentSource);
+    if (ready) {
+        shader.bindDefaults();
+        for (int a = 0; a < kAttributeCount; ++a) {
+            shader.bindAttribute(kFirstAttributeLocation + a, kAttributes[a].name);
+        }
+        ready = shader.linkProgram();
+    }
+    if (!ready) {
+        ofLogWarning() << "Sparks: failed to compile the instanced spark shader; drawing one spark at a time.";
+        return false;
+    }
+
+    // Triangle strip over the corners of [-1, 1]^2.
+    const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    quad.setVertexData(corners, 2, 4, GL_STATIC_DRAW);
+    capacity = 0;
+    return true;
+}
+
+void SparkRenderer::allocate(int newCapacity) {
+    capacity = newCapacity;
+    GLsizeiptr fieldBytes = static_cast<GLsizeiptr>(capacity) * sizeof(float);
+    attributes.allocate(fieldBytes * SparkPool::kFieldCount, GL_STREAM_DRAW);
+    for (int a = 0; a < kAttributeCount; ++a) {
+        int location = kFirstAttributeLocation + a;
+        quad.setAttributeBuffer(location, attributes, 1, sizeof(float),
+                                static_cast<int>(fieldBytes * kAttributes[a].field));
+        quad.setAttributeDivisor(location, 1);
+    }
+}
+
+int SparkRenderer::draw(const SparkPool &sparks, float opacity) {
+    int count = sparks.size();
+    if (!ready || count == 0) {
+        return 0;
+    }
+    if (sparks.getCapacity() != capacity) {
+        allocate(sparks.getCapacity());
+    }
+
+    // Orphan last frame's data so the upload doesn't wait for the GPU.
+    GLsizeiptr fieldBytes = static_cast<GLsizeiptr>(capacity) * sizeof(float);
+    attributes.setData(fieldBytes * SparkPool::kFieldCount, nullptr, GL_STREAM_DRAW);
+    for (const auto &attribute : kAttributes) {
+        attributes.updateData(fieldBytes * attribute.field, static_cast<GLsizeiptr>(count) * sizeof(float),
+                              sparks.field(attribute.field));
+    }
+
+    shader.begin();
+    shader.setUniform1f("opacity", opacity);
+    shader.setUniform1i("streak", 0);
+    quad.drawInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    shader.setUniform1i("streak", 1);
+    quad.drawInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    shader.end();
+    return 2;
+}
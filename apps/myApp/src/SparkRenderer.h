@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "SparkPool.h"
+
+// Draws a SparkPool in two instanced draws instead of a circle and a line
+// call per spark. The pool's attribute arrays are copied once per frame into
+// one buffer object laid out like the pool (one array per attribute), each
+// array feeding a per-instance vertex attribute. A shared unit quad is
+// expanded in the vertex shader, which also computes the fade and shrink
+// over the spark's life: first as a disc at the spark's position (the
+// head), then as a quad from its previous position (the streak), so streaks
+// keep their width on core profiles where glLineWidth is fixed at 1.
+class SparkRenderer {
+public:
+    // Compiles the shader. Returns false if that fails; the caller should
+    // draw the sparks some other way.
+    bool setup();
+    bool isReady() const { return ready; }
+
+    // Draws into the current target with the current blend mode. Returns
+    // the number of draw calls issued.
+    int draw(const SparkPool &sparks, float opacity);
+
+private:
+    void allocate(int capacity);
+
+    ofShader shader;
+    ofVbo quad;
+    ofBufferObject attributes;
+    int capacity = 0;
+    bool ready = false;
+};
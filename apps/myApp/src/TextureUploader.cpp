@@ -0,0 +1,78 @@
+#include "TextureUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+void TextureUploader::allocate(int width, int height, int channels, int bufferCount) {
+    if (width == this->width && height == this->height && channels == this->channels &&
+        bufferCount == requestedBuffers && texture.isAllocated()) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    this->channels = channels;
+    requestedBuffers = bufferCount;
+    byteCount = static_cast<size_t>(width) * height * channels;
+    nextBuffer = 0;
+    mapped = false;
+
+    texture.allocate(width, height, channels == 4 ? GL_RGBA : GL_RGB);
+    buffers.assign(static_cast<size_t>(std::max(0, bufferCount)), ofBufferObject());
+    for (auto &buffer : buffers) {
+        buffer.allocate(byteCount, nullptr, GL_STREAM_DRAW);
+    }
+    fallback.clear();
+}
+
+void TextureUploader::disablePbo(const char *reason) {
+    ofLogWarning() << "TextureUploader: " << reason << "; falling back to synchronous uploads.";
+    buffers.clear();
+}
+
+unsigned char *TextureUploader::beginWrite() {
+    if (!buffers.empty()) {
+        // Invalidating lets the driver hand out fresh storage instead of
+        // waiting if the GPU is somehow still reading this buffer.
+        void *data = buffers[nextBuffer].mapRange(0, byteCount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (data) {
+            mapped = true;
+            return static_cast<unsigned char *>(data);
+        }
+        disablePbo("cannot map pixel buffer");
+    }
+    if (!fallback.isAllocated()) {
+        fallback.allocate(width, height, channels == 4 ? OF_PIXELS_RGBA : OF_PIXELS_RGB);
+    }
+    return fallback.getData();
+}
+
+void TextureUploader::endWrite() {
+    if (mapped) {
+        ofBufferObject &buffer = buffers[nextBuffer];
+        buffer.unmapRange();
+        mapped = false;
+        texture.loadData(buffer, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE);
+        nextBuffer = (nextBuffer + 1) % buffers.size();
+    } else {
+        texture.loadData(fallback);
+    }
+}
+
+void TextureUploader::upload(const ofPixels &pixels) {
+    int channels = static_cast<int>(pixels.getNumChannels());
+    if (!pixels.isAllocated() || (channels != 3 && channels != 4)) {
+        return;
+    }
+    allocate(static_cast<int>(pixels.getWidth()), static_cast<int>(pixels.getHeight()), channels, requestedBuffers);
+
+    unsigned char *dst = beginWrite();
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    if (pixels.getBytesStride() == rowBytes) {
+        std::memcpy(dst, pixels.getData(), byteCount);
+    } else {
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(dst + y * rowBytes, pixels.getData() + y * pixels.getBytesStride(), rowBytes);
+        }
+    }
+    endWrite();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <vector>
+
+// Streams CPU-produced pixels into a texture. The CPU writes each frame into
+// a mapped pixel buffer object and the texture update is queued from it, so
+// the render thread doesn't block on the copy. Buffers rotate through a
+// ring, so the frame being written never maps a buffer the GPU may still be
+// reading for the one being drawn. With bufferCount 0, or if mapping fails,
+// it falls back to ofTexture::loadData from CPU memory.
+class TextureUploader {
+public:
+    // channels is 3 (RGB) or 4 (RGBA). Reallocates only when something
+    // changed.
+    void allocate(int width, int height, int channels, int bufferCount = 3);
+    bool isAllocated() const { return texture.isAllocated(); }
+
+    // Destination for the next frame: width * height * channels bytes,
+    // rows tightly packed. Every beginWrite() needs an endWrite().
+    unsigned char *beginWrite();
+    // Queues the texture update from what was written.
+    void endWrite();
+    // Allocates to match pixels (keeping the buffer count), copies and
+    // queues the update.
+    void upload(const ofPixels &pixels);
+
+    ofTexture &getTexture() { return texture; }
+    bool isUsingPbo() const { return !buffers.empty(); }
+
+private:
+    void disablePbo(const char *reason);
+
+    ofTexture texture;
+    std::vector<ofBufferObject> buffers;
+    size_t nextBuffer = 0;
+    bool mapped = false;
+    ofPixels fallback;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int requestedBuffers = 3;
+    size_t byteCount = 0;
+};
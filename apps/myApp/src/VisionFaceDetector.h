@@ -2,17 +2,19 @@
 
 #include "ofMain.h"
 
+#include <opencv2/core.hpp>
+
 #include <string>
 #include <vector>
 
 class VisionFaceDetector {
 public:
-    bool setup(float scale = 0.5f);
-    void setScale(float scale);
-    bool detect(const ofPixels &pixels, std::vector<ofRectangle> &outFaces);
+    bool setup();
+    // bgra is a scaled BGRA copy of a frameWidth x frameHeight camera frame;
+    // results are returned in camera coordinates.
+    bool detect(const cv::Mat &bgra, int frameWidth, int frameHeight, std::vector<ofRectangle> &outFaces);
     const std::string &getLastError() const { return lastError; }
 
 private:
-    float scale = 0.5f;
     std::string lastError;
 };
@@ -2,6 +2,8 @@
 
 #include "ofMain.h"
 
+#include <opencv2/core.hpp>
+
 #include <array>
 #include <string>
 #include <vector>
@@ -17,8 +19,7 @@ public:
         Count
     };
 
-    bool setup(float scale = 0.5f, float minConfidence = 0.35f, int maxHands = 2);
-    void setScale(float scale);
+    bool setup(float minConfidence = 0.35f, int maxHands = 2);
     void setMinConfidence(float minConfidence);
     void setMaxHands(int maxHands);
     void setFingerEnabled(Finger finger, bool enabled);
@@ -29,11 +30,12 @@ public:
         float confidence = 0.0f;
     };
 
-    bool detect(const ofPixels &pixels, std::vector<HandPoint> &outPoints);
+    // bgra is a scaled BGRA copy of a frameWidth x frameHeight camera frame;
+    // results are returned in camera coordinates.
+    bool detect(const cv::Mat &bgra, int frameWidth, int frameHeight, std::vector<HandPoint> &outPoints);
     const std::string &getLastError() const { return lastError; }
 
 private:
-    float scale = 0.5f;
     float minConfidence = 0.35f;
     int maxHands = 2;
     std::array<bool, 5> fingerEnabled = {true, true, true, true, true};
@@ -4,21 +4,14 @@
 #import <CoreML/CoreML.h>
 #import <CoreVideo/CoreVideo.h>
 
-#include <opencv2/imgproc.hpp>
-
 #include <algorithm>
 
-bool VisionHandPoseDetector::setup(float scale, float minConfidence, int maxHands) {
-    setScale(scale);
+bool VisionHandPoseDetector::setup(float minConfidence, int maxHands) {
     setMinConfidence(minConfidence);
     setMaxHands(maxHands);
     return true;
 }
 
-void VisionHandPoseDetector::setScale(float scale) {
-    this->scale = std::max(0.1f, std::min(scale, 1.0f));
-}
-
 void VisionHandPoseDetector::setMinConfidence(float minConfidence) {
     this->minConfidence = std::max(0.0f, std::min(minConfidence, 1.0f));
 }
@@ -39,63 +32,34 @@ void VisionHandPoseDetector::setEnabledFingers(const std::array<bool, 5> &enable
     fingerEnabled = enabled;
 }
 
-bool VisionHandPoseDetector::detect(const ofPixels &pixels, std::vector<HandPoint> &outPoints) {
+bool VisionHandPoseDetector::detect(const cv::Mat &bgra, int frameWidth, int frameHeight, std::vector<HandPoint> &outPoints) {
     outPoints.clear();
     lastError.clear();
 
-    if (!pixels.isAllocated()) {
-        lastError = "pixels not allocated";
+    if (bgra.empty() || bgra.type() != CV_8UC4) {
+        lastError = "expected BGRA pixels";
         return false;
     }
 
-    int width = pixels.getWidth();
-    int height = pixels.getHeight();
-    int channels = pixels.getNumChannels();
+    int width = frameWidth;
+    int height = frameHeight;
     if (width <= 0 || height <= 0) {
         lastError = "invalid pixel size";
         return false;
     }
 
-    if (channels != 3 && channels != 4) {
-        lastError = "unsupported pixel format";
-        return false;
-    }
-
-    int targetW = std::max(64, static_cast<int>(width * scale));
-    int targetH = std::max(64, static_cast<int>(height * scale));
-
-    cv::Mat src;
-    if (channels == 3) {
-        src = cv::Mat(height, width, CV_8UC3,
-                      const_cast<unsigned char *>(pixels.getData()),
-                      pixels.getBytesStride());
-    } else {
-        src = cv::Mat(height, width, CV_8UC4,
-                      const_cast<unsigned char *>(pixels.getData()),
-                      pixels.getBytesStride());
-    }
-
-    cv::Mat resized;
-    cv::resize(src, resized, cv::Size(targetW, targetH), 0, 0, cv::INTER_LINEAR);
-
-    cv::Mat bgra;
-    if (channels == 3) {
-        cv::cvtColor(resized, bgra, cv::COLOR_RGB2BGRA);
-    } else {
-        cv::cvtColor(resized, bgra, cv::COLOR_RGBA2BGRA);
-    }
-
-    if (!bgra.isContinuous()) {
-        bgra = bgra.clone();
+    cv::Mat continuous = bgra;
+    if (!continuous.isContinuous()) {
+        continuous = bgra.clone();
     }
 
     CVPixelBufferRef buffer = nullptr;
     CVReturn status = CVPixelBufferCreateWithBytes(kCFAllocatorDefault,
-                                                  bgra.cols,
-                                                  bgra.rows,
+                                                  continuous.cols,
+                                                  continuous.rows,
                                                   kCVPixelFormatType_32BGRA,
-                                                  bgra.data,
-                                                  static_cast<size_t>(bgra.step),
+                                                  continuous.data,
+                                                  static_cast<size_t>(continuous.step),
                                                   nullptr,
                                                   nullptr,
                                                   nullptr,
@@ -118,8 +82,8 @@ bool VisionHandPoseDetector::detect(const ofPixels &pixels, std::vector<HandPoin
             success = false;
         } else {
             NSArray<VNHumanHandPoseObservation *> *results = request.results;
-            float scaleX = static_cast<float>(width) / static_cast<float>(bgra.cols);
-            float scaleY = static_cast<float>(height) / static_cast<float>(bgra.rows);
+            float scaleX = static_cast<float>(width) / static_cast<float>(continuous.cols);
+            float scaleY = static_cast<float>(height) / static_cast<float>(continuous.rows);
             static NSArray<NSString *> *kTipKeys = nil;
             static NSArray<NSString *> *kBaseKeys = nil;
             static dispatch_once_t onceToken;
@@ -161,10 +125,10 @@ bool VisionHandPoseDetector::detect(const ofPixels &pixels, std::vector<HandPoin
                     if (!basePoint || basePoint.confidence < minConfidence * 0.6f) {
                         continue;
                     }
-                    float x = point.location.x * bgra.cols;
-                    float y = (1.0 - point.location.y) * bgra.rows;
-                    float bx = basePoint.location.x * bgra.cols;
-                    float by = (1.0 - basePoint.location.y) * bgra.rows;
+                    float x = point.location.x * continuous.cols;
+                    float y = (1.0 - point.location.y) * continuous.rows;
+                    float bx = basePoint.location.x * continuous.cols;
+                    float by = (1.0 - basePoint.location.y) * continuous.rows;
                     ofVec2f tip(x * scaleX, y * scaleY);
                     ofVec2f base(bx * scaleX, by * scaleY);
                     ofVec2f dir = tip - base;
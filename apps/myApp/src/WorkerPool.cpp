@@ -0,0 +1,99 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace {
+// More bands than threads so uneven bands (e.g. rows with more work) balance.
+constexpr int kBandsPerThread = 4;
+
+thread_local bool insideBand = false;
+}
+
+WorkerPool::WorkerPool(int workerCount) {
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&WorkerPool::runWorker, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+int WorkerPool::defaultWorkerCount() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? static_cast<int>(hardware) - 1 : 0;
+}
+
+WorkerPool &WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::parallelFor(int count, int grain, const std::function<void(int, int)> &fn) {
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(1, grain);
+    int chunks = (count + grain - 1) / grain;
+    if (workers.empty() || chunks <= 1 || insideBand) {
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFn = &fn;
+        jobCount = count;
+        jobBands = std::min(chunks, getConcurrency() * kBandsPerThread);
+        nextBand = 0;
+        pending = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    runBands();
+
+    // Every worker checks in, so the job can't be replaced under a straggler.
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    jobFn = nullptr;
+}
+
+void WorkerPool::runBands() {
+    insideBand = true;
+    for (int band = nextBand.fetch_add(1); band < jobBands; band = nextBand.fetch_add(1)) {
+        int begin = static_cast<int>(static_cast<int64_t>(jobCount) * band / jobBands);
+        int end = static_cast<int>(static_cast<int64_t>(jobCount) * (band + 1) / jobBands);
+        (*jobFn)(begin, end);
+    }
+    insideBand = false;
+}
+
+void WorkerPool::runWorker() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        runBands();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+}
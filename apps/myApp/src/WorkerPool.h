@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops over rows/tiles. The
+// calling thread takes part in every loop, so a pool with N workers runs
+// N + 1 bands at once. Loops from different threads are serialised; a loop
+// started from inside a band runs inline.
+class WorkerPool {
+public:
+    explicit WorkerPool(int workerCount = defaultWorkerCount());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Calls fn(begin, end) over disjoint ranges covering [0, count), each at
+    // least grain long (except the last), and returns when all are done.
+    void parallelFor(int count, int grain, const std::function<void(int, int)> &fn);
+
+    // Threads that run a loop, including the caller.
+    int getConcurrency() const { return static_cast<int>(workers.size()) + 1; }
+
+    // One worker per hardware thread, minus the caller.
+    static int defaultWorkerCount();
+    static WorkerPool &shared();
+
+private:
+    void runWorker();
+    void runBands();
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+
+    const std::function<void(int, int)> *jobFn = nullptr;
+    int jobCount = 0;
+    int jobBands = 0;
+    std::atomic<int> nextBand{0};
+};
@@ -1,5 +1,7 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "ofAppNoWindow.h"
+#include "Benchmarks.h"
 
 #include <cstdlib>
 #include <cerrno>
@@ -20,12 +22,57 @@ bool parseInt(const char *value, int &out) {
     return true;
 }
 
+bool parseFloat(const char *value, float &out) {
+    if (!value) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    float parsed = std::strtof(value, &end);
+    if (errno != 0 || end == value || *end != '\0') {
+        return false;
+    }
+    out = parsed;
+    return true;
+}
+
 AppConfig parseArgs(int argc, char **argv) {
     AppConfig config;
+    bool paceGiven = false;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--bg" && i + 1 < argc) {
             config.bgPath = argv[++i];
+        } else if (arg == "--bg-model-scale" && i + 1 < argc) {
+            int value = 0;
+            if (parseInt(argv[++i], value) && (value == 1 || value == 2 || value == 4)) {
+                config.bgModelScale = value;
+            }
+        } else if (arg == "--bg-model" && i + 1 < argc) {
+            std::string model = argv[++i];
+            if (model == "mog2") {
+                config.bgModel = BackgroundModelType::Mog2;
+            } else if (model == "average") {
+                config.bgModel = BackgroundModelType::Average;
+            }
+        } else if (arg == "--bg-learning-rate" && i + 1 < argc) {
+            float value = 0.0f;
+            if (parseFloat(argv[++i], value) && value >= 0.0f && value <= 1.0f) {
+                config.bgLearningRate = value;
+            }
+        } else if (arg == "--source" && i + 1 < argc) {
+            config.source = argv[++i];
+        } else if (arg == "--pace" && i + 1 < argc) {
+            std::string pace = argv[++i];
+            if (pace == "fast") {
+                config.pacing = FramePacing::Fast;
+                paceGiven = true;
+            } else if (pace == "realtime") {
+                config.pacing = FramePacing::Realtime;
+                paceGiven = true;
+            } else {
+                ofLogWarning() << "Unknown --pace " << pace << ", expected fast or realtime";
+            }
         } else if (arg == "--cam" && i + 1 < argc) {
             int value = 0;
             if (parseInt(argv[++i], value)) {
@@ -46,8 +93,28 @@ AppConfig parseArgs(int argc, char **argv) {
             if (parseInt(argv[++i], value) && value > 0) {
                 config.camFps = value;
             }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            int value = 0;
+            if (parseInt(argv[++i], value)) {
+                config.seed = static_cast<uint32_t>(value);
+            }
+        } else if (arg == "--bench" && i + 1 < argc) {
+            config.benchmark = argv[++i];
+        } else if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            config.outputPath = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            int value = 0;
+            if (parseInt(argv[++i], value) && value >= 0) {
+                config.maxFrames = value;
+            }
         }
     }
+    if (config.headless && !paceGiven) {
+        // Offline renders are not tied to wall-clock time.
+        config.pacing = FramePacing::Fast;
+    }
     return config;
 }
 } // namespace
@@ -55,6 +122,18 @@ AppConfig parseArgs(int argc, char **argv) {
 int main(int argc, char **argv) {
     AppConfig config = parseArgs(argc, argv);
 
+    if (!config.benchmark.empty()) {
+        return runBenchmark(config.benchmark, config);
+    }
+
+    if (config.headless) {
+        auto window = std::make_shared<ofAppNoWindow>();
+        ofSetupOpenGL(window, config.camWidth, config.camHeight, OF_WINDOW);
+        ofRunApp(window, std::make_shared<ofApp>(config));
+        ofRunMainLoop();
+        return 0;
+    }
+
     ofGLWindowSettings settings;
     settings.setSize(config.camWidth, config.camHeight);
     settings.setGLVersion(3, 2);
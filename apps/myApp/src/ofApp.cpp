@@ -1,5 +1,7 @@
 #include "ofApp.h"
+#include "CounterRandom.h"
 #include "KeyShaderSource.h"
+#include "PixelInterleave.h"
 
 #include <opencv2/imgproc.hpp>
 
@@ -15,41 +17,89 @@ constexpr std::array<float, 5> kSaturationModes = {-1.0f, 0.2f, 0.45f, 0.7f, 0.9
 constexpr std::array<float, 3> kKaleidoZoomModes = {0.9f, 0.7f, 0.5f};
 constexpr std::array<float, 4> kTempoPresets = {60.0f, 80.0f, 100.0f, 120.0f};
 constexpr std::array<float, 4> kWetMixPresets = {0.2f, 0.4f, 0.6f, 0.8f};
+// Spark streams count up from 0, per-emit streams from here.
+constexpr uint64_t kSparkEmitStreamBase = 1ull << 63;
+
+FrameSourceSettings sourceSettings(const AppConfig &config) {
+    FrameSourceSettings settings;
+    settings.width = config.camWidth;
+    settings.height = config.camHeight;
+    settings.fps = config.camFps;
+    settings.loop = !config.headless;
+    return settings;
+}
 }
 
 ofApp::ofApp(const AppConfig &config)
 : config(config) {}
 
 void ofApp::setup() {
-    ofSetVerticalSync(true);
-    ofSetFrameRate(config.camFps);
-    ofSetFullscreen(true);
-    setupKeyShader();
+    bool fast = config.pacing == FramePacing::Fast;
+    ofSetVerticalSync(!fast);
+    ofSetFrameRate(fast ? 0 : config.camFps);
+    statUniformCalls = frameStats.addCounter("key uniform calls");
+    statUniformUploads = frameStats.addCounter("key UBO uploads");
+    statEffectPasses = frameStats.addCounter("effect passes");
+    statEffectKpx = frameStats.addCounter("effect kpx shaded");
+    statEffectOutputKpx = frameStats.addCounter("effect kpx at output res");
+    statUpscaleKpx = frameStats.addCounter("upscale kpx");
+    statUploadTime = frameStats.addTimer("texture uploads");
+    statBgDownscaleTime = frameStats.addTimer("bg downscale");
+    statBgModelTime = frameStats.addTimer("bg model");
+    statBgRefineTime = frameStats.addTimer("bg mask refine");
+    statBgUpsampleTime = frameStats.addTimer("bg mask upsample");
+    statMotionTime = frameStats.addTimer("motion");
+    statPaletteTime = frameStats.addTimer("spark palette (worker)");
+    statSparkDrawCalls = frameStats.addCounter("spark draw calls");
+    statSparkDrawCallsSaved = frameStats.addCounter("spark draw calls saved");
+    statMidiEvents = frameStats.addCounter("midi events");
+    statMidiLatency = frameStats.addLatency("midi-to-photon");
+    background.setModelScale(config.bgModelScale);
+    background.setModelType(config.bgModel);
+    background.setLearningRate(config.bgLearningRate);
+    if (!config.headless) {
+        ofSetFullscreen(true);
+        setupKeyShader();
+        sparkRenderer.setup();
+        midi.setBeatClock(&beatClock);
+    }
     midi.setup();
     setupControls();
-    faceDetector.setup(faceDetectScale);
-    handDetector.setup(handDetectScale);
-    helpFont.load("Helvetica", 24, true, true);
-    handDetector.setEnabledFingers(handSparkleFingers);
-
-    listCameras();
-    if (!devices.empty()) {
-        int startIndex = config.camIndex;
-        if (startIndex < 0 || startIndex >= static_cast<int>(devices.size())) {
-            ofLogWarning() << "Camera index " << startIndex << " out of range, using 0.";
-            startIndex = 0;
-        }
-        startCamera(startIndex);
-    } else {
-        ofLogWarning() << "No camera devices detected.";
+    detection.setFaceRate(faceDetectRateHz);
+    detection.setHandRate(handDetectRateHz);
+    detection.setHandFingers(handSparkleFingers);
+    // Headless renders run both on the update thread, one step per frame.
+    detection.setup(!config.headless);
+    if (!config.headless) {
+        palette.setup();
+    }
+    sparks.setCapacity(maxSparkParticles);
+    capture.setVisionScale(visionScale);
+    if (!config.headless) {
+        helpFont.load("Helvetica", 24, true, true);
     }
 
+    startSource();
+
+    if (config.headless) {
+        bgImage.setUseTexture(false);
+    }
     bgLoaded = bgImage.load(config.bgPath);
     if (!bgLoaded) {
         ofLogWarning() << "Background image not found at "
                        << ofToDataPath(config.bgPath, true);
     }
 
+    if (config.headless) {
+        if (!offline.setup(config.camWidth, config.camHeight, config.outputPath)) {
+            ofExit(1);
+            return;
+        }
+        if (bgLoaded) {
+            offline.setBackground(bgImage.getPixels());
+        }
+    }
+
     printSettings();
 }
 
@@ -66,62 +116,117 @@ void main() {
 }
 )";
 
-    shaderReady = keyShader.setupShaderFromSource(GL_VERTEX_SHADER, vertex);
-    shaderReady = shaderReady && keyShader.setupShaderFromSource(GL_FRAGMENT_SHADER, getKeyFragmentShaderSource());
-    if (shaderReady) {
-        keyShader.bindDefaults();
-        shaderReady = keyShader.linkProgram();
-    }
+    effectGraph.setup(vertex);
+    effectGraph.addNode({"warp", "warpNode", KeyFeature::Kaleido | KeyFeature::Woofer, NodeInput::Resample, true});
+    effectGraph.addNode({"key", "keyNode", 0, NodeInput::Pointwise, false});
+    effectGraph.addNode({"stylize", "stylizeNode", 0, NodeInput::Neighbourhood, true});
+    effectGraph.addNode({"colour", "colourNode", 0, NodeInput::Pointwise, true});
+    effectGraph.setProcessingScale(effectScale);
+    effectGraph.setUpscaleSharpness(upscaleSharpness);
+    keyUniforms.setup();
+    if (prewarmKeyShaders) {
+        effectGraph.prewarm({0,
+                            KeyFeature::Kaleido,
+                            KeyFeature::Woofer,
+                            KeyFeature::Halftone,
+                            KeyFeature::Saturation,
+                            KeyFeature::Kaleido | KeyFeature::Woofer});
+    }
+    selectEffectFeatures();
+}
 
-    if (!shaderReady) {
-        ofLogWarning() << "Failed to compile keying shader.";
+void ofApp::selectEffectFeatures() {
+    if (config.headless) {
+        return;
     }
+    effectFeatures = keyEffectFeatures(makeKeyEffectParams(0.0f, 0.0f));
+    // Builds (and compiles) the plan now rather than mid-draw.
+    effectGraph.getPlan(effectFeatures);
 }
 
 void ofApp::update() {
-    grabber.update();
-    if (grabber.isFrameNew()) {
-        updateMotion(grabber.getPixels());
-        if (enableFaceDetect) {
-            faceDetectFrame++;
-            if (faceDetectInterval <= 0 || (faceDetectFrame % faceDetectInterval) == 0) {
-                faceDetector.setScale(faceDetectScale);
-                if (!faceDetector.detect(grabber.getPixels(), faceRects)) {
-                    const std::string &err = faceDetector.getLastError();
-                    if (!err.empty()) {
-                        ofLogWarning() << "Face detect: " << err;
-                    }
-                }
-            }
+    frameStats.endFrame();
+    // The last frame has been swapped to the screen since its MIDI changes
+    // were applied.
+    uint64_t shownMicros = ofGetElapsedTimeMicros();
+    for (uint64_t inputMicros : midiLatencyPending) {
+        frameStats.addSample(statMidiLatency, shownMicros > inputMicros ? shownMicros - inputMicros : 0);
+    }
+    midiLatencyPending.clear();
+
+    // Read before acquiring so a finished source's last frame is never missed.
+    bool sourceFinished = capture.isFinished();
+    FrameRef frame = capture.acquireLatest();
+    bool newFrame = frame && frame->sequence != lastFrameSequence;
+    if (config.headless && !newFrame) {
+        // Offline output advances per camera frame, not per loop iteration.
+        if (sourceFinished || !capture.isRunning()) {
+            finishOffline();
         }
-        if (enableHandSparkles) {
-            handDetectFrame++;
-            if (handDetectInterval <= 0 || (handDetectFrame % handDetectInterval) == 0) {
-                handDetector.setScale(handDetectScale);
-                handDetector.setEnabledFingers(handSparkleFingers);
-                if (!handDetector.detect(grabber.getPixels(), handPoints)) {
-                    const std::string &err = handDetector.getLastError();
-                    if (!err.empty()) {
-                        ofLogWarning() << "Hand detect: " << err;
-                    }
-                }
-            }
+        return;
+    }
+
+    if (newFrame) {
+        lastFrameSequence = frame->sequence;
+        currentFrame = frame;
+        const FramePyramid &pyramid = frame->pyramid();
+        if (!config.headless) {
+            FrameStats::ScopedTimer timer(frameStats, statUploadTime);
+            camUpload.allocate(static_cast<int>(frame->pixels.getWidth()),
+                               static_cast<int>(frame->pixels.getHeight()),
+                               static_cast<int>(frame->pixels.getNumChannels()), uploadBuffers);
+            camUpload.upload(frame->pixels);
         }
-        if (!useShaderKey) {
-            updateComposite();
+        if (pyramid.valid()) {
+            updateMotion(pyramid.grayFull);
+            detection.setFaceEnabled(enableFaceDetect);
+            detection.setFaceRate(faceDetectRateHz);
+            detection.setHandEnabled(enableHandSparkles);
+            detection.setHandRate(handDetectRateHz);
+            detection.setHandFingers(handSparkleFingers);
+            if (config.headless) {
+                detection.detectFrame(frame, offlineTime);
+                palette.processFrame(frame);
+            } else {
+                detection.submitFrame(frame);
+                palette.submitFrame(frame);
+            }
+            if (!useShaderKey) {
+                updateComposite(pyramid);
+            }
         }
     }
+    updateDetections();
+    updateSparkPalette();
 
+    float fps = ofGetFrameRate();
+    float knobDelaySeconds = fps > 1.0f ? midiKnobDelayFrames / fps : 0.0f;
+    float maxDelaySeconds = ControlCurve::kMaxDelayMicros * 1e-6f;
+    midi.setKnobDelayMicros(static_cast<uint64_t>(std::min(knobDelaySeconds, maxDelaySeconds) * 1e6f));
     midi.update();
+    frameStats.add(statMidiEvents, midi.getLastEventCount());
     handleMidiControls();
 
     float dt = ofGetLastFrameTime();
+    if (config.headless) {
+        dt = 1.0f / static_cast<float>(std::max(1, config.camFps));
+        offlineTime += dt;
+    }
     emitHandSparks(dt);
     updateSparkParticles(dt);
-    updateTrail(dt);
+    if (config.headless) {
+        renderOfflineFrame();
+    } else {
+        updateTrail(dt);
+    }
 }
 
 void ofApp::draw() {
+    if (config.headless) {
+        return;
+    }
+
+    ofTexture &camTexture = camUpload.getTexture();
     ofClear(0);
     ofSetColor(255);
 
@@ -134,59 +239,46 @@ void ofApp::draw() {
     }
 
     ofEnableBlendMode(OF_BLENDMODE_ALPHA);
-    if (useShaderKey && shaderReady && grabber.isInitialized() && grabber.getTexture().isAllocated()) {
-        keyShader.begin();
-        keyShader.setUniformTexture("tex0", grabber.getTexture(), 0);
-        keyShader.setUniform2f("texSize", grabber.getWidth(), grabber.getHeight());
-        keyShader.setUniform1f("keyHue", keyHueDeg / 360.0f);
-        keyShader.setUniform1f("keyHueRange", keyHueRangeDeg / 360.0f);
-        keyShader.setUniform1f("keyMinSat", keyMinSat);
-        keyShader.setUniform1f("keyMinVal", keyMinVal);
-        keyShader.setUniform1f("levels", posterizeLevels);
-        keyShader.setUniform1f("edgeStrength", edgeStrength);
-        keyShader.setUniform1f("time", ofGetElapsedTimef());
-        keyShader.setUniform1f("bpm", pulseBpm);
-        keyShader.setUniform1f("pulseAmount", pulseAmount);
-        keyShader.setUniform1f("pulseColorize", pulseColorize);
-        keyShader.setUniform1f("pulseHueMode", static_cast<float>(pulseHueMode));
-        keyShader.setUniform1f("pulseHueShift", pulseHueShiftDeg);
-        keyShader.setUniform1f("pulseAttack", pulseAttack);
-        keyShader.setUniform1f("pulseDecay", pulseDecay);
-        keyShader.setUniform1f("pulseHueBoost", pulseHueBoost);
-        keyShader.setUniform1f("wooferOn", enableWoofer ? 1.0f : 0.0f);
-        keyShader.setUniform1f("wooferStrength", wooferStrength);
-        keyShader.setUniform1f("wooferFalloff", wooferFalloff);
-        keyShader.setUniform1f("satOn", enableSaturation ? 1.0f : 0.0f);
-        keyShader.setUniform1f("satScale", saturationScale);
-        keyShader.setUniform1f("kaleidoOn", enableKaleido ? 1.0f : 0.0f);
-        keyShader.setUniform1f("kaleidoSegments", kaleidoSegments);
-        keyShader.setUniform1f("kaleidoSpin", kaleidoSpin);
-        keyShader.setUniform1f("kaleidoZoom", kaleidoZoom);
-        keyShader.setUniform1f("halftoneOn", enableHalftone ? 1.0f : 0.0f);
-        keyShader.setUniform1f("halftoneScale", halftoneScale);
-        keyShader.setUniform1f("halftoneEdge", halftoneEdge);
-        keyShader.setUniform1f("wetMix", wetMix);
-        drawTextureCover(grabber.getTexture(), ofGetWidth(), ofGetHeight(), true);
-        keyShader.end();
-    } else if (compositeReady) {
-        drawTextureCover(rgbaTexture, ofGetWidth(), ofGetHeight(), true);
+    bool keyed = false;
+    if (useShaderKey && currentFrame && camTexture.isAllocated()) {
+        KeyEffectParams params = makeKeyEffectParams(camTexture.getWidth(), camTexture.getHeight());
+        if (keyUniforms.update(makeKeyUniformBlock(params))) {
+            frameStats.add(statUniformUploads);
+        }
+        uint64_t outputPixels = static_cast<uint64_t>(ofGetWidth()) * ofGetHeight();
+        keyed = effectGraph.render(effectFeatures, camTexture, params.time, params.beat, outputPixels, [&](ofTexture &tex) {
+            drawTextureCover(tex, ofGetWidth(), ofGetHeight(), true);
+        });
+        frameStats.add(statUniformCalls, effectGraph.getLastUniformCalls());
+        frameStats.add(statEffectPasses, effectGraph.getLastPassCount());
+        frameStats.add(statEffectKpx, effectGraph.getLastEffectPixels() / 1000);
+        // What the same passes would shade if they all ran at output size.
+        frameStats.add(statEffectOutputKpx, effectGraph.getLastPassCount() * outputPixels / 1000);
+        frameStats.add(statUpscaleKpx, effectGraph.getLastUpscalePixels() / 1000);
+    }
+    if (!keyed && compositeReady) {
+        drawTextureCover(compositeUpload.getTexture(), ofGetWidth(), ofGetHeight(), true);
     }
 
     if (enableHandSparkles) {
         drawTrail();
     }
 
+    if (showStats) {
+        drawStatsOverlay();
+    }
+
     if (showHelpOverlay) {
         drawHelpOverlay();
     }
 
-    if (showFaceDebug && !faceRects.empty() && grabber.isInitialized()) {
+    if (showFaceDebug && !faceRects.empty() && camTexture.isAllocated()) {
         ofPushStyle();
         ofNoFill();
         ofSetColor(0, 255, 255);
         ofSetLineWidth(2.0f);
-        float camW = grabber.getWidth();
-        float camH = grabber.getHeight();
+        float camW = camTexture.getWidth();
+        float camH = camTexture.getHeight();
         for (const auto &rect : faceRects) {
             ofVec2f tl = mapCameraToScreen({rect.x, rect.y}, camW, camH, true);
             ofVec2f br = mapCameraToScreen({rect.x + rect.width, rect.y + rect.height}, camW, camH, true);
@@ -199,12 +291,12 @@ void ofApp::draw() {
         ofPopStyle();
     }
 
-    if (showHandDebug && !handPoints.empty() && grabber.isInitialized()) {
+    if (showHandDebug && !handPoints.empty() && camTexture.isAllocated()) {
         ofPushStyle();
         ofSetColor(255, 0, 255);
         ofFill();
-        float camW = grabber.getWidth();
-        float camH = grabber.getHeight();
+        float camW = camTexture.getWidth();
+        float camH = camTexture.getHeight();
         for (const auto &pt : handPoints) {
             ofVec2f pos = mapCameraToScreen(pt.tip, camW, camH, true);
             ofDrawCircle(pos, 6.0f);
@@ -212,20 +304,72 @@ void ofApp::draw() {
         ofPopStyle();
     }
 
-    float beatsPerSecond = pulseBpm / 60.0f;
-    if (beatsPerSecond > 0.0f) {
-        float beatTime = ofGetElapsedTimef() * beatsPerSecond;
-        float beatPhase = beatTime - std::floor(beatTime);
-        float flashBeats = beatFlashSeconds * beatsPerSecond;
-        if (beatPhase < flashBeats) {
-            int beatIndex = static_cast<int>(std::floor(beatTime)) % 4;
-            float radius = (beatIndex == 0) ? beatDownbeatRadius : beatDotRadius;
-            ofPushStyle();
-            ofSetColor(0);
-            ofDrawCircle(20.0f, 20.0f, radius);
-            ofPopStyle();
-        }
+    float beatRadius = beatDotRadiusAt(currentBeat());
+    if (beatRadius > 0.0f) {
+        ofPushStyle();
+        ofSetColor(0);
+        ofDrawCircle(20.0f, 20.0f, beatRadius);
+        ofPopStyle();
+    }
+}
+
+float ofApp::appTime() const {
+    return config.headless ? offlineTime : ofGetElapsedTimef();
+}
+
+// appTime() in double precision, on the same clock as MIDI event times.
+double ofApp::beatClockTime() const {
+    return config.headless ? offlineTime : ofGetElapsedTimeMicros() * 1e-6;
+}
+
+float ofApp::beatDotRadiusAt(double beat) const {
+    float beatsPerSecond = beatClock.getBpm() / 60.0f;
+    if (beatsPerSecond <= 0.0f) {
+        return 0.0f;
+    }
+    float beatPhase = static_cast<float>(beat - std::floor(beat));
+    float flashBeats = beatFlashSeconds * beatsPerSecond;
+    if (beatPhase >= flashBeats) {
+        return 0.0f;
     }
+    int beatIndex = static_cast<int>(std::floor(beat)) % 4;
+    return (beatIndex == 0) ? beatDownbeatRadius : beatDotRadius;
+}
+
+KeyEffectParams ofApp::makeKeyEffectParams(float texW, float texH) const {
+    KeyEffectParams params;
+    params.texWidth = texW;
+    params.texHeight = texH;
+    params.keyHue = keyHueDeg / 360.0f;
+    params.keyHueRange = keyHueRangeDeg / 360.0f;
+    params.keyMinSat = keyMinSat;
+    params.keyMinVal = keyMinVal;
+    params.levels = posterizeLevels;
+    params.edgeStrength = edgeStrength;
+    params.time = appTime();
+    // Only the phase is used; wrapping keeps it exact in a float.
+    params.beat = static_cast<float>(std::fmod(currentBeat(), 1024.0));
+    params.pulseAmount = pulseAmount;
+    params.pulseColorize = pulseColorize;
+    params.pulseHueMode = static_cast<float>(pulseHueMode);
+    params.pulseHueShift = pulseHueShiftDeg;
+    params.pulseAttack = pulseAttack;
+    params.pulseDecay = pulseDecay;
+    params.pulseHueBoost = pulseHueBoost;
+    params.wooferOn = enableWoofer;
+    params.wooferStrength = wooferStrength;
+    params.wooferFalloff = wooferFalloff;
+    params.satOn = enableSaturation;
+    params.satScale = saturationScale;
+    params.kaleidoOn = enableKaleido;
+    params.kaleidoSegments = kaleidoSegments;
+    params.kaleidoSpin = kaleidoSpin;
+    params.kaleidoZoom = kaleidoZoom;
+    params.halftoneOn = enableHalftone;
+    params.halftoneScale = halftoneScale;
+    params.halftoneEdge = halftoneEdge;
+    params.wetMix = wetMix;
+    return params;
 }
 
 void ofApp::keyPressed(ofKeyEventArgs &event) {
@@ -273,6 +417,17 @@ void ofApp::keyPressed(int key) {
         useShaderKey = false;
         resetBackgroundSubtractor();
         printSettings();
+    } else if (key == 'i') {
+        showStats = !showStats;
+    } else if (key == 'u') {
+        static const std::array<float, 4> kEffectScales = {0.0f, 1.0f, 0.75f, 0.5f};
+        auto current = std::find(kEffectScales.begin(), kEffectScales.end(), effectScale);
+        size_t next = current == kEffectScales.end()
+                          ? 0
+                          : (static_cast<size_t>(current - kEffectScales.begin()) + 1) % kEffectScales.size();
+        effectScale = kEffectScales[next];
+        effectGraph.setProcessingScale(effectScale);
+        printSettings();
     } else if (key == 'p') {
         midi.cyclePort();
     } else if (key == 'o') {
@@ -286,9 +441,28 @@ void ofApp::keyPressed(int key) {
     } else if (key == 'e') {
         enableMorph = !enableMorph;
         printSettings();
+    } else if (key == 'm') {
+        static const std::array<int, 3> kModelScales = {1, 2, 4};
+        auto current = std::find(kModelScales.begin(), kModelScales.end(), background.getModelScale());
+        size_t next = current == kModelScales.end()
+                          ? 0
+                          : (static_cast<size_t>(current - kModelScales.begin()) + 1) % kModelScales.size();
+        background.setModelScale(kModelScales[next]);
+        mask.release();
+        printSettings();
+    } else if (key == 'a') {
+        background.setModelType(background.getModelType() == BackgroundModelType::Mog2
+                                    ? BackgroundModelType::Average
+                                    : BackgroundModelType::Mog2);
+        mask.release();
+        printSettings();
+    } else if (key == 'h') {
+        background.setFrozen(!background.isFrozen());
+        printSettings();
     } else if (key == 'b') {
         wooferModeIndex = (wooferModeIndex + 1) % static_cast<int>(kWooferModes.size());
         enableWoofer = kWooferModes[static_cast<size_t>(wooferModeIndex)] != 0;
+        selectEffectFeatures();
         printSettings();
     } else if (key == 's') {
         detectShadows = !detectShadows;
@@ -320,14 +494,40 @@ void ofApp::keyReleased(int key) {
 }
 
 void ofApp::exit() {
-    if (grabber.isInitialized()) {
-        grabber.close();
-    }
+    offline.close();
+    detection.close();
+    palette.close();
+    currentFrame.reset();
+    capture.stop();
     midi.close();
 }
 
+void ofApp::startSource() {
+    if (config.source != "cam") {
+        auto source = createFrameSource(config.source, sourceSettings(config));
+        if (!source) {
+            ofLogWarning() << "Unknown frame source \"" << config.source << "\".";
+        } else if (!capture.start(std::move(source), config.pacing, config.camFps)) {
+            ofLogWarning() << "Failed to start frame source " << config.source;
+        }
+        return;
+    }
+
+    listCameras();
+    if (!devices.empty()) {
+        int startIndex = config.camIndex;
+        if (startIndex < 0 || startIndex >= static_cast<int>(devices.size())) {
+            ofLogWarning() << "Camera index " << startIndex << " out of range, using 0.";
+            startIndex = 0;
+        }
+        startCamera(startIndex);
+    } else {
+        ofLogWarning() << "No camera devices detected.";
+    }
+}
+
 void ofApp::listCameras() {
-    devices = grabber.listDevices();
+    devices = WebcamSource::listDevices();
     ofLogNotice() << "Available cameras:";
     for (size_t i = 0; i < devices.size(); ++i) {
         const auto &device = devices[i];
@@ -348,15 +548,10 @@ void ofApp::startCamera(int index) {
     }
     currentDevice = index;
 
-    if (grabber.isInitialized()) {
-        grabber.close();
-    }
-
-    grabber.setDeviceID(devices[currentDevice].id);
-    grabber.setDesiredFrameRate(config.camFps);
-    grabber.setPixelFormat(OF_PIXELS_RGB);
-
-    if (!grabber.setup(config.camWidth, config.camHeight)) {
+    FrameSourceSettings settings = sourceSettings(config);
+    settings.camDeviceId = devices[currentDevice].id;
+    auto source = createFrameSource("cam", settings);
+    if (!capture.start(std::move(source), config.pacing, config.camFps)) {
         ofLogWarning() << "Failed to start camera " << currentDevice;
     } else {
         ofLogNotice() << "Using camera [" << currentDevice << "] "
@@ -368,98 +563,38 @@ void ofApp::startCamera(int index) {
 }
 
 void ofApp::resetBackgroundSubtractor() {
-    bgSub = cv::createBackgroundSubtractorMOG2();
-    if (bgSub) {
-        bgSub->setDetectShadows(detectShadows);
-    }
+    background.reset(backgroundMaskSettings());
     mask.release();
 }
 
-void ofApp::updateComposite() {
-    if (!grabber.isInitialized()) {
-        return;
-    }
+BackgroundMaskSettings ofApp::backgroundMaskSettings() const {
+    BackgroundMaskSettings settings;
+    settings.threshold = maskThreshold;
+    settings.morph = enableMorph;
+    settings.blur = enableBlur;
+    settings.detectShadows = detectShadows;
+    return settings;
+}
 
-    ofPixels &camPixels = grabber.getPixels();
-    if (!camPixels.isAllocated()) {
+void ofApp::updateComposite(const FramePyramid &pyramid) {
+    const cv::Mat &frame = pyramid.rgb;
+    if (!background.apply(frame, backgroundMaskSettings(), mask)) {
         return;
     }
+    frameStats.add(statBgDownscaleTime, background.getLastDownscaleMicros());
+    frameStats.add(statBgModelTime, background.getLastModelMicros());
+    frameStats.add(statBgRefineTime, background.getLastRefineMicros());
+    frameStats.add(statBgUpsampleTime, background.getLastUpsampleMicros());
 
-    if (!bgSub) {
-        resetBackgroundSubtractor();
-    }
-
-    cv::Mat frame;
-    cv::Mat frameConverted;
-    if (camPixels.getNumChannels() == 3) {
-        frame = cv::Mat(camPixels.getHeight(),
-                        camPixels.getWidth(),
-                        CV_8UC3,
-                        camPixels.getData(),
-                        camPixels.getBytesStride());
-    } else if (camPixels.getNumChannels() == 4) {
-        cv::Mat rgba(camPixels.getHeight(),
-                     camPixels.getWidth(),
-                     CV_8UC4,
-                     camPixels.getData(),
-                     camPixels.getBytesStride());
-        cv::cvtColor(rgba, frameConverted, cv::COLOR_RGBA2RGB);
-        frame = frameConverted;
+    if (config.headless) {
+        interleaveRgbMask(frame, mask, rgbaPixels);
     } else {
-        ofLogWarning() << "Unsupported camera pixel format ("
-                       << camPixels.getNumChannels() << " channels).";
-        return;
-    }
-
-    bgSub->apply(frame, mask);
-
-    if (mask.empty()) {
-        return;
-    }
-
-    cv::threshold(mask, mask, maskThreshold, 255, cv::THRESH_BINARY);
-
-    if (enableMorph) {
-        cv::erode(mask, mask, cv::Mat(), cv::Point(-1, -1), 1);
-        cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
-    }
-
-    if (enableBlur) {
-        cv::medianBlur(mask, mask, 5);
-        cv::threshold(mask, mask, maskThreshold, 255, cv::THRESH_BINARY);
-    }
-
-    int w = camPixels.getWidth();
-    int h = camPixels.getHeight();
-    if (rgbaPixels.getWidth() != w || rgbaPixels.getHeight() != h) {
-        rgbaPixels.allocate(w, h, OF_PIXELS_RGBA);
-        rgbaTexture.allocate(w, h, GL_RGBA);
-    }
-
-    const unsigned char *srcBase = frame.data;
-    size_t srcStep = frame.step;
-    cv::Mat maskContinuous = mask;
-    if (!maskContinuous.isContinuous()) {
-        maskContinuous = mask.clone();
-    }
-    const unsigned char *maskPtr = maskContinuous.data;
-    unsigned char *dst = rgbaPixels.getData();
-
-    for (int y = 0; y < h; ++y) {
-        const unsigned char *src = srcBase + (srcStep * y);
-        const unsigned char *maskRow = maskPtr + (w * y);
-        unsigned char *dstRow = dst + (w * 4 * y);
-        for (int x = 0; x < w; ++x) {
-            int srcIndex = x * 3;
-            int dstIndex = x * 4;
-            dstRow[dstIndex + 0] = src[srcIndex + 0];
-            dstRow[dstIndex + 1] = src[srcIndex + 1];
-            dstRow[dstIndex + 2] = src[srcIndex + 2];
-            dstRow[dstIndex + 3] = maskRow[x];
-        }
+        // Packed straight into the mapped upload buffer.
+        FrameStats::ScopedTimer timer(frameStats, statUploadTime);
+        compositeUpload.allocate(pyramid.width, pyramid.height, 4, uploadBuffers);
+        interleaveRgbMask(frame, mask, compositeUpload.beginWrite());
+        compositeUpload.endWrite();
     }
-
-    rgbaTexture.loadData(rgbaPixels);
     compositeReady = true;
 }
 
@@ -484,6 +619,7 @@ void ofApp::drawTextureCover(ofTexture &tex, float dstW, float dstH, bool mirror
 
 void ofApp::setupControls() {
     controls.clear();
+    controlByMidiHandle.clear();
 
     auto addControl = [&](ControlSpec control) {
         if (!control.presets.empty()) {
@@ -492,7 +628,7 @@ void ofApp::setupControls() {
             control.value = ofLerp(control.knobMin, control.knobMax, 0.5f);
         }
 
-        if (control.id == "saturation" && control.value < 0.0f) {
+        if (control.kind == ControlKind::Saturation && control.value < 0.0f) {
             control.enabled = false;
             control.value = 1.0f;
         } else if (control.hasOff) {
@@ -501,11 +637,16 @@ void ofApp::setupControls() {
             control.enabled = true;
         }
 
+        control.midiHandle = midi.registerControl(control.id);
+        if (control.midiHandle >= static_cast<int>(controlByMidiHandle.size())) {
+            controlByMidiHandle.resize(control.midiHandle + 1, -1);
+        }
+        controlByMidiHandle[control.midiHandle] = static_cast<int>(controls.size());
         controls.push_back(control);
-        midi.registerControl(control.id);
     };
 
     addControl({
+        ControlKind::Kaleido,
         "kaleido",
         'k',
         'K',
@@ -517,6 +658,7 @@ void ofApp::setupControls() {
     });
 
     addControl({
+        ControlKind::KaleidoZoom,
         "kaleidoZoom",
         'z',
         'Z',
@@ -528,6 +670,7 @@ void ofApp::setupControls() {
     });
 
     addControl({
+        ControlKind::Halftone,
         "halftone",
         'd',
         'D',
@@ -539,6 +682,7 @@ void ofApp::setupControls() {
     });
 
     addControl({
+        ControlKind::Tempo,
         "tempo",
         't',
         'T',
@@ -550,6 +694,7 @@ void ofApp::setupControls() {
     });
 
     addControl({
+        ControlKind::Saturation,
         "saturation",
         'v',
         'V',
@@ -561,6 +706,7 @@ void ofApp::setupControls() {
     });
 
     addControl({
+        ControlKind::WetMix,
         "wetMix",
         'w',
         'W',
@@ -578,74 +724,96 @@ void ofApp::setupControls() {
 
 void ofApp::handleMidiControls() {
     bool changed = false;
-    float value01 = 0.0f;
-    for (auto &control : controls) {
-        bool muteActive = midi.isMuteActive(control.id);
-        if (muteActive) {
-            bool startedMute = false;
-            if (!control.muteHeld) {
-                control.muteHeld = true;
-                control.preMuteValue = control.value;
-                control.preMuteEnabled = control.enabled;
-                startedMute = true;
-            }
-            float minVal = std::min(control.knobMin, control.knobMax);
-            control.value = minVal;
-            if (control.id == "saturation") {
-                control.enabled = true;
-            } else if (control.hasOff) {
-                control.enabled = control.value > 0.5f;
-            } else {
-                control.enabled = true;
-            }
-            applyControl(control);
-            if (startedMute) {
-                changed = true;
-            }
-            continue;
+    midi.forEachDirtyControl([&](int handle) {
+        int index = handle < static_cast<int>(controlByMidiHandle.size()) ? controlByMidiHandle[handle] : -1;
+        if (index < 0) {
+            return;
         }
-
-        if (control.muteHeld) {
-            control.muteHeld = false;
-            control.value = control.preMuteValue;
-            control.enabled = control.preMuteEnabled;
+        if (updateControlFromMidi(controls[index])) {
             changed = true;
         }
-
-        if (midi.consumeOscPadHit(control.id)) {
-            control.oscEnabled = !control.oscEnabled;
-            changed = true;
+        if (!config.headless && midi.getEventMicros(handle) > 0) {
+            midiLatencyPending.push_back(midi.getEventMicros(handle));
         }
-        if (midi.consumeOscKnobValue(control.id, value01)) {
-            control.oscSpeed01 = ofClamp(value01, 0.0f, 1.0f);
-            changed = true;
+    });
+    // A held mute overrides the keyboard, and oscillators move with the
+    // beat, so those are re-applied every frame.
+    for (auto &control : controls) {
+        if (control.muteHeld) {
+            updateControlFromMidi(control);
+        } else if (control.oscEnabled) {
+            applyControl(control);
         }
+    }
 
-        if (midi.consumePadHit(control.id)) {
-            cycleControlPreset(control);
-            changed = true;
+    if (changed) {
+        printSettings();
+    }
+}
+
+// Applies a control's pending MIDI pad, knob and mute state. Returns true if
+// the settings changed in a way worth logging.
+bool ofApp::updateControlFromMidi(ControlSpec &control) {
+    if (midi.isMuteActive(control.midiHandle)) {
+        bool startedMute = false;
+        if (!control.muteHeld) {
+            control.muteHeld = true;
+            control.preMuteValue = control.value;
+            control.preMuteEnabled = control.enabled;
+            startedMute = true;
         }
-        if (midi.consumeKnobValue(control.id, value01)) {
-            float clamped = ofClamp(value01, 0.0f, 1.0f);
-            control.value = ofLerp(control.knobMin, control.knobMax, clamped);
-            if (control.id == "saturation") {
-                control.enabled = true;
-            } else if (control.hasOff) {
-                float minVal = std::min(control.knobMin, control.knobMax);
-                float maxVal = std::max(control.knobMin, control.knobMax);
-                float eps = std::max(0.01f, (maxVal - minVal) * 0.01f);
-                control.enabled = control.value > minVal + eps;
-            } else {
-                control.enabled = true;
-            }
-            changed = true;
+        float minVal = std::min(control.knobMin, control.knobMax);
+        control.value = minVal;
+        if (control.kind == ControlKind::Saturation) {
+            control.enabled = true;
+        } else if (control.hasOff) {
+            control.enabled = control.value > 0.5f;
+        } else {
+            control.enabled = true;
         }
         applyControl(control);
+        return startedMute;
     }
 
-    if (changed) {
-        printSettings();
+    bool changed = false;
+    if (control.muteHeld) {
+        control.muteHeld = false;
+        control.value = control.preMuteValue;
+        control.enabled = control.preMuteEnabled;
+        changed = true;
+    }
+
+    float value01 = 0.0f;
+    if (midi.consumeOscPadHit(control.midiHandle)) {
+        control.oscEnabled = !control.oscEnabled;
+        changed = true;
+    }
+    if (midi.consumeOscKnobValue(control.midiHandle, value01)) {
+        control.oscSpeed01 = ofClamp(value01, 0.0f, 1.0f);
+        changed = true;
+    }
+
+    if (midi.consumePadHit(control.midiHandle)) {
+        cycleControlPreset(control);
+        changed = true;
+    }
+    if (midi.consumeKnobValue(control.midiHandle, value01)) {
+        float clamped = ofClamp(value01, 0.0f, 1.0f);
+        control.value = ofLerp(control.knobMin, control.knobMax, clamped);
+        if (control.kind == ControlKind::Saturation) {
+            control.enabled = true;
+        } else if (control.hasOff) {
+            float minVal = std::min(control.knobMin, control.knobMax);
+            float maxVal = std::max(control.knobMin, control.knobMax);
+            float eps = std::max(0.01f, (maxVal - minVal) * 0.01f);
+            control.enabled = control.value > minVal + eps;
+        } else {
+            control.enabled = true;
+        }
+        changed = true;
     }
+    applyControl(control);
+    return changed;
 }
 
 bool ofApp::handleControlKey(int key,
@@ -681,20 +849,20 @@ bool ofApp::handleControlKey(int key,
     }
     for (auto &control : controls) {
         if (cmdDown && altDown && (key == control.key || key == control.learnKey)) {
-            midi.beginLearnOsc(control.id);
+            midi.beginLearnOsc(control.midiHandle);
             return true;
         }
         if (ctrlDown && shiftDown && (cmdDown || altDown) &&
             (key == control.key || key == control.learnKey)) {
-            midi.beginLearnOsc(control.id);
+            midi.beginLearnOsc(control.midiHandle);
             return true;
         }
         if (cmdDown && shiftDown && (key == control.key || key == control.learnKey)) {
-            midi.beginLearnMute(control.id);
+            midi.beginLearnMute(control.midiHandle);
             return true;
         }
         if (shiftDown && (key == control.key || key == control.learnKey)) {
-            midi.beginLearn(control.id);
+            midi.beginLearn(control.midiHandle);
             return true;
         }
     }
@@ -733,7 +901,7 @@ void ofApp::cycleControlPreset(ControlSpec &control) {
     }
     control.presetIndex = (control.presetIndex + 1) % static_cast<int>(control.presets.size());
     float value = control.presets[control.presetIndex];
-    if (control.id == "saturation" && value < 0.0f) {
+    if (control.kind == ControlKind::Saturation && value < 0.0f) {
         control.enabled = false;
         control.value = 1.0f;
         return;
@@ -748,8 +916,9 @@ void ofApp::cycleControlPreset(ControlSpec &control) {
 
 void ofApp::applyControl(const ControlSpec &control) {
     float value = resolveControlValue(control);
-    if (control.id == "kaleido") {
-        kaleidoSegments = value;
+    switch (control.kind) {
+    case ControlKind::Kaleido: {
+        setKeyParam(kaleidoSegments, value);
         enableKaleido = control.enabled;
         float minVal = std::min(control.knobMin, control.knobMax);
         float maxVal = std::max(control.knobMin, control.knobMax);
@@ -762,32 +931,41 @@ void ofApp::applyControl(const ControlSpec &control) {
         }
         if (newState != 0 && newState != kaleidoExtremeState) {
             kaleidoSpinFlip = !kaleidoSpinFlip;
-            kaleidoSpin = kaleidoSpinBase * (kaleidoSpinFlip ? -1.0f : 1.0f);
+            setKeyParam(kaleidoSpin, kaleidoSpinBase * (kaleidoSpinFlip ? -1.0f : 1.0f));
         }
         kaleidoExtremeState = newState;
-        return;
-    }
-    if (control.id == "kaleidoZoom") {
-        kaleidoZoom = value;
-        return;
-    }
-    if (control.id == "halftone") {
-        halftoneScale = value;
+        selectEffectFeatures();
+        break;
+    }
+    case ControlKind::KaleidoZoom:
+        setKeyParam(kaleidoZoom, value);
+        break;
+    case ControlKind::Halftone:
+        setKeyParam(halftoneScale, value);
         enableHalftone = control.enabled;
-        return;
-    }
-    if (control.id == "tempo") {
+        selectEffectFeatures();
+        break;
+    case ControlKind::Tempo:
         pulseBpm = value;
-        return;
-    }
-    if (control.id == "saturation") {
-        saturationScale = value;
+        beatClock.setTempo(value, beatClockTime());
+        break;
+    case ControlKind::Saturation:
+        setKeyParam(saturationScale, value);
         enableSaturation = control.enabled;
-        return;
+        selectEffectFeatures();
+        break;
+    case ControlKind::WetMix:
+        setKeyParam(wetMix, value);
+        break;
     }
-    if (control.id == "wetMix") {
-        wetMix = value;
-        return;
+}
+
+// Oscillating controls are applied every frame; only real changes mark the
+// key uniform block for upload.
+void ofApp::setKeyParam(float &field, float value) {
+    if (field != value) {
+        field = value;
+        keyUniforms.markDirty();
     }
 }
 
@@ -796,7 +974,7 @@ float ofApp::resolveControlValue(const ControlSpec &control) const {
         return control.value;
     }
 
-    float bpm = pulseBpm;
+    float bpm = beatClock.getBpm();
     if (bpm <= 0.0f) {
         return control.value;
     }
@@ -812,67 +990,55 @@ float ofApp::resolveControlValue(const ControlSpec &control) const {
         return control.value;
     }
 
-    float beatTime = ofGetElapsedTimef() * (bpm / 60.0f);
-    float phase = std::fmod(beatTime / beatsPerCycle, 1.0f);
+    double beatTime = currentBeat();
+    float phase = static_cast<float>(std::fmod(beatTime / beatsPerCycle, 1.0));
     float lfo = 0.5f - 0.5f * std::cos(phase * TWO_PI);
     return ofLerp(control.knobMin, control.knobMax, lfo);
 }
 
-void ofApp::updateMotion(const ofPixels &camPixels) {
-    if (!camPixels.isAllocated()) {
+void ofApp::updateMotion(const cv::Mat &gray) {
+    if (!motion.update(gray)) {
         return;
     }
+    frameStats.add(statMotionTime, motion.getLastMicros());
+    motionLevel = motion.getLevel();
+}
 
-    cv::Mat frame;
-    cv::Mat frameConverted;
-    if (camPixels.getNumChannels() == 3) {
-        frame = cv::Mat(camPixels.getHeight(),
-                        camPixels.getWidth(),
-                        CV_8UC3,
-                        const_cast<unsigned char *>(camPixels.getData()),
-                        camPixels.getBytesStride());
-    } else if (camPixels.getNumChannels() == 4) {
-        cv::Mat rgba(camPixels.getHeight(),
-                     camPixels.getWidth(),
-                     CV_8UC4,
-                     const_cast<unsigned char *>(camPixels.getData()),
-                     camPixels.getBytesStride());
-        cv::cvtColor(rgba, frameConverted, cv::COLOR_RGBA2RGB);
-        frame = frameConverted;
-    } else {
+void ofApp::updateSparkPalette() {
+    if (!palette.consume(sparkPalette)) {
         return;
     }
-
-    cv::Mat gray;
-    cv::cvtColor(frame, gray, cv::COLOR_RGB2GRAY);
-
-    if (prevGray.empty() || prevGray.size() != gray.size()) {
-        prevGray = gray.clone();
-        motionLevel = 0.0f;
-        int px = camPixels.getWidth() / 2;
-        int py = camPixels.getHeight() / 2;
-        ofColor sample = camPixels.getColor(px, py);
+    frameStats.add(statPaletteTime, sparkPalette.micros);
+    sparkColors.resize(sparkPalette.colors.size());
+    for (size_t i = 0; i < sparkColors.size(); ++i) {
+        const ofColor &sample = sparkPalette.colors[i];
         float hue = sample.getHue() / 255.0f;
         float sat = ofClamp((sample.getSaturation() / 255.0f) * 1.2f, 0.6f, 1.0f);
         float bri = ofClamp((sample.getBrightness() / 255.0f) * 1.2f, 0.6f, 1.0f);
-        motionColor = ofFloatColor::fromHsb(hue, sat, bri, 1.0f);
-        return;
+        sparkColors[i] = ofFloatColor::fromHsb(hue, sat, bri, 1.0f);
     }
+}
 
-    cv::Mat diff;
-    cv::absdiff(gray, prevGray, diff);
-    cv::Scalar meanDiff = cv::mean(diff);
-    motionLevel = static_cast<float>(meanDiff[0] / 255.0);
-
-    int px = camPixels.getWidth() / 2;
-    int py = camPixels.getHeight() / 2;
-    ofColor sample = camPixels.getColor(px, py);
-    float hue = sample.getHue() / 255.0f;
-    float sat = ofClamp((sample.getSaturation() / 255.0f) * 1.2f, 0.6f, 1.0f);
-    float bri = ofClamp((sample.getBrightness() / 255.0f) * 1.2f, 0.6f, 1.0f);
-    motionColor = ofFloatColor::fromHsb(hue, sat, bri, 1.0f);
+void ofApp::updateDetections() {
+    DetectionScheduler::FaceResult faceResult;
+    if (detection.consumeFaces(faceResult)) {
+        if (!faceResult.error.empty()) {
+            ofLogWarning() << "Face detect: " << faceResult.error;
+        } else {
+            faceRects = std::move(faceResult.faces);
+            faceRectsTime = faceResult.frameTime;
+        }
+    }
 
-    prevGray = gray.clone();
+    DetectionScheduler::HandResult handResult;
+    if (detection.consumeHands(handResult)) {
+        if (!handResult.error.empty()) {
+            ofLogWarning() << "Hand detect: " << handResult.error;
+        } else {
+            handPoints = std::move(handResult.points);
+            handPointsTime = handResult.frameTime;
+        }
+    }
 }
 
 void ofApp::updateTrail(float dt) {
@@ -901,32 +1067,96 @@ void ofApp::updateTrail(float dt) {
     ofSetColor(0, 0, 0, static_cast<int>(trailFade * 255.0f));
     ofDrawRectangle(0, 0, width, height);
 
-    if (enableHandSparkles && !sparkParticles.empty()) {
+    if (enableHandSparkles && !sparks.empty()) {
         ofEnableBlendMode(OF_BLENDMODE_ADD);
-        for (const auto &particle : sparkParticles) {
-            float t = ofClamp(1.0f - (particle.age / particle.life), 0.0f, 1.0f);
-            float alpha = t * t * handSparkleOpacity;
-            ofFloatColor c = particle.color;
-            c.a = alpha;
-            ofSetColor(c);
-            float size = particle.size * (0.5f + 0.5f * t);
-            ofDrawCircle(particle.pos, size);
-            ofSetLineWidth(std::max(1.0f, size * 0.4f));
-            ofDrawLine(particle.prev, particle.pos);
+        // One circle and one line per spark unbatched.
+        int unbatchedCalls = 2 * sparks.size();
+        int calls = 0;
+        if (batchSparks && sparkRenderer.isReady()) {
+            calls = sparkRenderer.draw(sparks, handSparkleOpacity);
+        } else {
+            for (int i = 0; i < sparks.size(); ++i) {
+                float alpha = 0.0f;
+                float size = 0.0f;
+                sparkAppearance(i, alpha, size);
+                ofFloatColor c = sparks.getColor(i);
+                c.a = alpha;
+                ofSetColor(c);
+                ofVec2f pos = sparks.getPos(i);
+                ofDrawCircle(pos, size);
+                ofSetLineWidth(std::max(1.0f, size * 0.4f));
+                ofDrawLine(sparks.getPrev(i), pos);
+            }
+            calls = unbatchedCalls;
         }
+        frameStats.add(statSparkDrawCalls, calls);
+        frameStats.add(statSparkDrawCallsSaved, unbatchedCalls - calls);
     }
 
     ofPopStyle();
     trailFbo.end();
 }
 
+void ofApp::sparkAppearance(int spark, float &alpha, float &size) const {
+    float t = ofClamp(1.0f - (sparks.getAge(spark) / sparks.getLife(spark)), 0.0f, 1.0f);
+    alpha = t * t * handSparkleOpacity;
+    size = sparks.getSize(spark) * (0.5f + 0.5f * t);
+}
+
+void ofApp::renderOfflineFrame() {
+    offline.beginFrame();
+
+    if (useShaderKey && currentFrame && currentFrame->pyramid().valid()) {
+        const FramePyramid &pyramid = currentFrame->pyramid();
+        KeyEffectParams params = makeKeyEffectParams(pyramid.width, pyramid.height);
+        keyEffectCpu.render(pyramid.rgb, params, keyedPixels);
+        offline.drawCover(keyedPixels, true);
+    } else if (!useShaderKey && compositeReady) {
+        offline.drawCover(rgbaPixels, true);
+    }
+
+    if (enableHandSparkles) {
+        // Same 8-bit quantised fade as the translucent rectangle in updateTrail.
+        offline.fadeTrail(static_cast<int>(trailFade * 255.0f) / 255.0f);
+        for (int i = 0; i < sparks.size(); ++i) {
+            float alpha = 0.0f;
+            float size = 0.0f;
+            sparkAppearance(i, alpha, size);
+            ofFloatColor c = sparks.getColor(i);
+            c.a = alpha;
+            offline.addSpark(sparks.getPos(i), sparks.getPrev(i), c, size);
+        }
+        offline.compositeTrail();
+    }
+
+    float beatRadius = beatDotRadiusAt(currentBeat());
+    if (beatRadius > 0.0f) {
+        offline.drawDisc(20.0f, 20.0f, beatRadius, ofFloatColor(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+
+    offline.writeFrame();
+    if (config.maxFrames > 0 && offline.getFramesWritten() >= static_cast<uint64_t>(config.maxFrames)) {
+        finishOffline();
+    }
+}
+
+void ofApp::finishOffline() {
+    if (offlineFinished) {
+        return;
+    }
+    offlineFinished = true;
+    ofLogNotice() << "Offline: wrote " << offline.getFramesWritten() << " frames to " << config.outputPath;
+    offline.close();
+    ofExit(0);
+}
+
 void ofApp::emitHandSparks(float dt) {
-    if (!enableHandSparkles || handPoints.empty() || !grabber.isInitialized()) {
+    if (!enableHandSparkles || handPoints.empty() || !currentFrame) {
         return;
     }
 
-    float camW = grabber.getWidth();
-    float camH = grabber.getHeight();
+    float camW = currentFrame->pixels.getWidth();
+    float camH = currentFrame->pixels.getHeight();
     float sizeScale = handSparkleSize / 18.0f;
 
     for (const auto &hand : handPoints) {
@@ -938,63 +1168,46 @@ void ofApp::emitHandSparks(float dt) {
         }
         dir.normalize();
 
-        float emit = sparkEmitRate * dt;
+        float activity = ofClamp(motion.sample(hand.tip.x, hand.tip.y) / sparkMotionFullScale, 0.0f, 1.0f);
+        float emit = sparkEmitRate * (1.0f + sparkMotionEmit * activity) * dt;
         int count = static_cast<int>(emit);
-        if (ofRandom(1.0f) < (emit - static_cast<float>(count))) {
+        CounterRandom emitRandom(config.seed, kSparkEmitStreamBase + sparkEmitStreams++);
+        if (emitRandom.next() < (emit - static_cast<float>(count))) {
             count += 1;
         }
 
         for (int i = 0; i < count; ++i) {
-            if (sparkParticles.size() >= static_cast<size_t>(maxSparkParticles)) {
-                sparkParticles.erase(sparkParticles.begin());
-            }
-
-            float angle = std::atan2(dir.y, dir.x) + ofRandom(-sparkSpread, sparkSpread);
-            float speed = sparkSpeed * ofRandom(0.4f, 1.0f);
+            CounterRandom random(config.seed, sparkStreams++);
+            float angle = std::atan2(dir.y, dir.x) + random.range(-sparkSpread, sparkSpread);
+            float speed = sparkSpeed * random.range(0.4f, 1.0f);
             ofVec2f vel(std::cos(angle), std::sin(angle));
             vel *= speed;
-            vel += ofVec2f(ofRandom(-sparkJitter, sparkJitter),
-                           ofRandom(-sparkJitter, sparkJitter)) * 0.1f;
-
-            ofFloatColor c = motionColor;
+            vel += ofVec2f(random.range(-sparkJitter, sparkJitter),
+                           random.range(-sparkJitter, sparkJitter)) * 0.1f;
+
+            // A colour from the camera image around the fingertip.
+            ofFloatColor c(1.0f, 1.0f, 1.0f, 1.0f);
+            int colorIndex = sparkPalette.pick(hand.tip.x / camW, hand.tip.y / camH, random.next());
+            if (colorIndex >= 0 && colorIndex < static_cast<int>(sparkColors.size())) {
+                c = sparkColors[colorIndex];
+            }
             c = c.getLerped(ofFloatColor(1.0f, 0.8f, 0.4f), 0.4f);
-            float brightness = ofRandom(0.6f, 1.0f);
+            float brightness = random.range(0.6f, 1.0f);
             c.r *= brightness;
             c.g *= brightness;
             c.b *= brightness;
 
-            SparkParticle particle;
-            particle.pos = tipScreen;
-            particle.prev = tipScreen;
-            particle.vel = vel;
-            particle.color = c;
-            particle.life = sparkLife * ofRandom(0.6f, 1.2f);
-            particle.size = ofRandom(1.5f, 4.5f) * sizeScale;
-            sparkParticles.push_back(particle);
+            float life = sparkLife * random.range(0.6f, 1.2f);
+            sparks.add(tipScreen, vel, c, life, random.range(1.5f, 4.5f) * sizeScale);
         }
     }
 }
 
 void ofApp::updateSparkParticles(float dt) {
-    if (sparkParticles.empty()) {
+    if (sparks.empty()) {
         return;
     }
-
-    float drag = std::pow(sparkDrag, dt * 60.0f);
-    for (auto &particle : sparkParticles) {
-        particle.prev = particle.pos;
-        particle.age += dt;
-        particle.vel *= drag;
-        particle.vel.y += sparkGravity * dt;
-        particle.pos += particle.vel * dt;
-    }
-
-    sparkParticles.erase(std::remove_if(sparkParticles.begin(),
-                                        sparkParticles.end(),
-                                        [](const SparkParticle &p) {
-                                            return p.age >= p.life;
-                                        }),
-                         sparkParticles.end());
+    sparks.integrate(dt, std::pow(sparkDrag, dt * 60.0f), sparkGravity);
 }
 
 void ofApp::drawTrail() {
@@ -1043,21 +1256,64 @@ void ofApp::printSettings() {
                       << " halftone=" << (enableHalftone ? "on" : "off")
                       << " dots=" << halftoneScale
                       << " wet=" << wetMix;
+        if (!config.headless) {
+            ofLogNotice() << "Effect graph: features=" << describeKeyFeatures(effectFeatures)
+                          << " plan=" << effectGraph.describePlan(effectFeatures)
+                          << " programs=" << effectGraph.getCompiledCount()
+                          << " fbos=" << effectGraph.getPooledFboCount();
+            ofLogNotice() << "Effect resolution: "
+                          << (effectScale > 0.0f ? ofToString(effectScale, 2) + "x camera" : std::string("output"))
+                          << " sharpen=" << upscaleSharpness;
+        }
     } else {
         ofLogNotice() << "BG: threshold=" << maskThreshold
                       << " morph=" << (enableMorph ? "on" : "off")
                       << " blur=" << (enableBlur ? "on" : "off")
-                      << " shadows=" << (detectShadows ? "on" : "off");
+                      << " shadows=" << (detectShadows ? "on" : "off")
+                      << " model=" << describeBackgroundModel(background.getModelType())
+                      << " at 1/" << background.getModelScale()
+                      << " rate=" << (background.getLearningRate() > 0.0f ? ofToString(background.getLearningRate(), 4)
+                                                                         : std::string("auto"))
+                      << (background.isFrozen() ? " frozen" : "")
+                      << " tiles=" << background.getTileCount();
+    }
+    if (!config.headless) {
+        ofLogNotice() << "Uploads: buffers=" << uploadBuffers
+                      << " camPbo=" << (camUpload.isUsingPbo() ? "on" : "off")
+                      << " compositePbo=" << (compositeUpload.isUsingPbo() ? "on" : "off");
     }
 
     ofLogNotice() << "PulseHue: mode=" << pulseHueMode
                   << " shift=" << pulseHueShiftDeg
-                  << " bpm=" << pulseBpm;
+                  << " bpm=" << beatClock.getBpm();
+    if (beatClock.isFollowingClock(beatClockTime())) {
+        ofLogNotice() << "Beat: MIDI clock " << (beatClock.isTransportRunning() ? "playing" : "stopped")
+                      << " jitter=" << beatClock.getJitterMillis() << "ms"
+                      << " (tempo control " << pulseBpm << " ignored)";
+    }
     ofLogNotice() << "Woofer: " << (enableWoofer ? "on" : "off")
                   << " strength=" << wooferStrength
                   << " falloff=" << wooferFalloff;
+    float now = appTime();
+    ofLogNotice() << "Vision: face=" << (enableFaceDetect ? "on" : "off")
+                  << " rate=" << faceDetectRateHz
+                  << " age=" << (now - faceRectsTime)
+                  << " hands=" << (enableHandSparkles ? "on" : "off")
+                  << " rate=" << handDetectRateHz
+                  << " age=" << (now - handPointsTime);
+    ofLogNotice() << "Capture: frames=" << capture.getCapturedCount()
+                  << " dropped=" << capture.getDroppedCount()
+                  << " overruns=" << capture.getOverrunCount()
+                  << " appFps=" << ofGetFrameRate();
+    ofLogNotice() << "MIDI: dropped=" << midi.getDroppedEventCount()
+                  << " coalesced=" << midi.getCoalescedEventCount()
+                  << " latency p50/p95/p99=" << frameStats.getPercentile(statMidiLatency, 0.5) / 1000.0
+                  << "/" << frameStats.getPercentile(statMidiLatency, 0.95) / 1000.0
+                  << "/" << frameStats.getPercentile(statMidiLatency, 0.99) / 1000.0 << "ms"
+                  << " (" << frameStats.getSampleCount(statMidiLatency) << " changes)";
     ofLogNotice() << "Sparkles: " << (enableHandSparkles ? "on" : "off")
-                  << " particles=" << sparkParticles.size()
+                  << " particles=" << sparks.size()
+                  << " seed=" << config.seed
                   << " motion=" << motionLevel;
 }
 
@@ -1080,12 +1336,17 @@ void ofApp::drawHelpOverlay() {
         "",
         "System:",
         "  f  Fullscreen",
+        "  i  Frame stats",
+        "  u  Effect resolution",
         "  r  Reset background model",
         "  p  Cycle MIDI input ports",
         "  o  MIDI test output",
         "  + / -  Mask threshold (bg-sub)",
         "  e  Morph (bg-sub)",
         "  s  Shadow detection (bg-sub)",
+        "  m  Background model resolution (bg-sub)",
+        "  a  Background model: MOG2 / running average (bg-sub)",
+        "  h  Freeze background (bg-sub)",
         "  [ / ]  Camera prev/next",
         "  Esc  Quit",
         "",
@@ -1129,3 +1390,30 @@ void ofApp::drawHelpOverlay() {
     }
     ofPopStyle();
 }
+
+void ofApp::drawStatsOverlay() {
+    std::vector<std::string> lines = frameStats.describe();
+    lines.insert(lines.begin(), "fps: " + ofToString(ofGetFrameRate(), 1));
+    uint64_t outputKpx = frameStats.getLast(statEffectOutputKpx);
+    if (outputKpx > 0) {
+        double shaded = static_cast<double>(frameStats.getLast(statEffectKpx)) / outputKpx;
+        lines.push_back("effect fill saved: " + ofToString((1.0 - shaded) * 100.0, 0) + "%");
+    }
+
+    float lineHeight = 16.0f;
+    float boxW = 320.0f;
+    float boxH = lineHeight * lines.size() + 16.0f;
+    float x = ofGetWidth() - boxW - 20.0f;
+    float y = 20.0f;
+
+    ofPushStyle();
+    ofSetColor(0, 0, 0, 180);
+    ofDrawRectangle(x, y, boxW, boxH);
+    ofSetColor(255);
+    float textY = y + lineHeight + 4.0f;
+    for (const auto &line : lines) {
+        ofDrawBitmapString(line, x + 10.0f, textY);
+        textY += lineHeight;
+    }
+    ofPopStyle();
+}
@@ -3,22 +3,45 @@
 #include "ofMain.h"
 
 #include <opencv2/core.hpp>
-#include <opencv2/video/background_segm.hpp>
 
 #include <array>
 #include <string>
 #include <vector>
 
+#include "BackgroundSegmenter.h"
+#include "CaptureThread.h"
+#include "DetectionScheduler.h"
+#include "EffectGraph.h"
+#include "FrameRing.h"
+#include "FrameStats.h"
+#include "KeyEffectCpu.h"
+#include "KeyUniformBuffer.h"
+#include "BeatClock.h"
 #include "MidiControl.h"
-#include "VisionFaceDetector.h"
+#include "MotionField.h"
+#include "OfflineRenderer.h"
+#include "PaletteExtractor.h"
+#include "SparkPool.h"
+#include "SparkRenderer.h"
+#include "TextureUploader.h"
 #include "VisionHandPoseDetector.h"
 
 struct AppConfig {
     std::string bgPath = "bg.jpg";
+    std::string source = "cam";
+    FramePacing pacing = FramePacing::Realtime;
     int camIndex = 0;
     int camWidth = 1280;
     int camHeight = 720;
     int camFps = 30;
+    bool headless = false;
+    std::string outputPath = "offline";
+    int maxFrames = 0;
+    int bgModelScale = 1; // bg-sub background model at 1/n of the camera size (1, 2 or 4)
+    BackgroundModelType bgModel = BackgroundModelType::Mog2;
+    float bgLearningRate = 0.0f; // 0 = the model's default
+    uint32_t seed = 1; // spark randomness; the same seed and input give the same sparks
+    std::string benchmark; // run this benchmark (see Benchmarks.h) instead of the app
 };
 
 class ofApp : public ofBaseApp {
@@ -34,11 +57,15 @@ public:
     void exit() override;
 
 private:
+    void startSource();
     void listCameras();
     void startCamera(int index);
     void resetBackgroundSubtractor();
-    void updateComposite();
-    void updateMotion(const ofPixels &camPixels);
+    BackgroundMaskSettings backgroundMaskSettings() const;
+    void updateComposite(const FramePyramid &pyramid);
+    void updateMotion(const cv::Mat &gray);
+    void updateSparkPalette();
+    void updateDetections();
     void updateTrail(float dt);
     void drawTrail();
     ofVec2f mapCameraToScreen(const ofVec2f &camPos, float camW, float camH, bool mirrorX);
@@ -53,8 +80,26 @@ private:
                           bool altDown,
                           bool ctrlDown);
     void drawHelpOverlay();
+    void drawStatsOverlay();
+    float appTime() const;
+    double beatClockTime() const;
+    double currentBeat() const { return beatClock.beatAt(beatClockTime()); }
+    float beatDotRadiusAt(double beat) const;
+    KeyEffectParams makeKeyEffectParams(float texW, float texH) const;
+    void renderOfflineFrame();
+    void finishOffline();
+
+    enum class ControlKind {
+        Kaleido,
+        KaleidoZoom,
+        Halftone,
+        Tempo,
+        Saturation,
+        WetMix
+    };
 
     struct ControlSpec {
+        ControlKind kind = ControlKind::Kaleido;
         std::string id;
         char key = 0;
         char learnKey = 0;
@@ -70,25 +115,34 @@ private:
         bool preMuteEnabled = true;
         bool oscEnabled = false;
         float oscSpeed01 = 0.0f;
+        int midiHandle = -1;
     };
 
     ControlSpec *findControlByKey(char key);
     ControlSpec *findControlById(const std::string &id);
     void cycleControlPreset(ControlSpec &control);
+    bool updateControlFromMidi(ControlSpec &control);
     void applyControl(const ControlSpec &control);
+    void selectEffectFeatures();
+    void setKeyParam(float &field, float value);
     float resolveControlValue(const ControlSpec &control) const;
+
     void emitHandSparks(float dt);
     void updateSparkParticles(float dt);
 
     AppConfig config;
 
-    ofVideoGrabber grabber;
+    CaptureThread capture;
+    FrameRef currentFrame;
+    uint64_t lastFrameSequence = 0;
+    TextureUploader camUpload;
     std::vector<ofVideoDevice> devices;
     int currentDevice = 0;
 
     MidiControl midi;
+    BeatClock beatClock;
 
-    cv::Ptr<cv::BackgroundSubtractorMOG2> bgSub;
+    BackgroundSegmenter background;
     cv::Mat mask;
 
     bool enableMorph = true;
@@ -99,12 +153,17 @@ private:
     ofImage bgImage;
     bool bgLoaded = false;
 
-    ofPixels rgbaPixels;
-    ofTexture rgbaTexture;
+    ofPixels rgbaPixels; // headless only; the window streams into compositeUpload
+    TextureUploader compositeUpload;
+    int uploadBuffers = 3; // PBO ring per streamed texture; 0 = synchronous loadData
     bool compositeReady = false;
 
-    ofShader keyShader;
-    bool shaderReady = false;
+    EffectGraph effectGraph;
+    uint32_t effectFeatures = 0; // KeyFeature mask the graph renders with
+    float effectScale = 1.0f;    // processing resolution relative to the camera; 0 = output size
+    float upscaleSharpness = 0.4f;
+    KeyUniformBuffer keyUniforms;
+    bool prewarmKeyShaders = true;
     bool useShaderKey = true;
     float keyHueDeg = 120.0f;
     float keyHueRangeDeg = 60.0f;
@@ -112,7 +171,7 @@ private:
     float keyMinVal = 0.2f;
     float posterizeLevels = 6.0f;
     float edgeStrength = 1.1f;
-    float pulseBpm = 60.0f;
+    float pulseBpm = 60.0f; // tempo control; MIDI clock overrides it while present
     float pulseAmount = 0.0f;
     float pulseColorize = 0.0f;
     float pulseHueShiftDeg = 18.0f;
@@ -142,45 +201,71 @@ private:
     bool enableSaturation = false;
     float saturationScale = 1.0f;
     std::vector<ControlSpec> controls;
+    std::vector<int> controlByMidiHandle; // index into controls, -1 for none
+    float midiKnobDelayFrames = 1.0f;      // knob playout delay; 0 = apply the latest value at once
+    std::vector<uint64_t> midiLatencyPending; // input times of MIDI changes in the frame being shown
     float wetMix = 0.6f;
     float beatFlashSeconds = 0.12f;
     float beatDotRadius = 10.0f;
     float beatDownbeatRadius = 20.0f;
 
+    OfflineRenderer offline;
+    KeyEffectCpu keyEffectCpu;
+    ofPixels keyedPixels;
+    float offlineTime = 0.0f;
+    bool offlineFinished = false;
+
     ofFbo trailFbo;
     float trailFade = 0.04f;
     float motionLevel = 0.0f;
-    ofFloatColor motionColor = ofFloatColor(1.0f, 1.0f, 1.0f, 1.0f);
-    cv::Mat prevGray;
+    MotionField motion;
+    PaletteExtractor palette;
+    PaletteExtractor::Palette sparkPalette;
+    std::vector<ofFloatColor> sparkColors; // sparkPalette, saturated and brightened
 
-    VisionFaceDetector faceDetector;
+    float visionScale = 0.5f;
+    DetectionScheduler detection;
     std::vector<ofRectangle> faceRects;
+    float faceRectsTime = 0.0f;
     bool enableFaceDetect = true;
     bool showFaceDebug = true;
-    int faceDetectFrame = 0;
-    int faceDetectInterval = 3;
-    float faceDetectScale = 0.5f;
-
-    struct SparkParticle {
-        ofVec2f pos;
-        ofVec2f prev;
-        ofVec2f vel;
-        ofFloatColor color;
-        float age = 0.0f;
-        float life = 1.0f;
-        float size = 2.0f;
-    };
+    float faceDetectRateHz = 10.0f;
+
+    void sparkAppearance(int spark, float &alpha, float &size) const;
 
-    VisionHandPoseDetector handDetector;
     std::vector<VisionHandPoseDetector::HandPoint> handPoints;
-    std::vector<SparkParticle> sparkParticles;
+    float handPointsTime = 0.0f;
+    SparkPool sparks;
+    // Random streams drawn so far: one per hand per emit, one per spark.
+    uint64_t sparkEmitStreams = 0;
+    uint64_t sparkStreams = 0;
+    SparkRenderer sparkRenderer;
+    // Instanced spark drawing; false draws a circle and a line per spark.
+    bool batchSparks = true;
     bool enableHandSparkles = true;
     bool showHandDebug = false;
     bool showHelpOverlay = false;
+    bool showStats = false;
+    FrameStats frameStats;
+    FrameStats::Id statUniformCalls = 0;
+    FrameStats::Id statUniformUploads = 0;
+    FrameStats::Id statEffectPasses = 0;
+    FrameStats::Id statEffectKpx = 0;
+    FrameStats::Id statEffectOutputKpx = 0;
+    FrameStats::Id statUpscaleKpx = 0;
+    FrameStats::Id statUploadTime = 0;
+    FrameStats::Id statBgDownscaleTime = 0;
+    FrameStats::Id statBgModelTime = 0;
+    FrameStats::Id statBgRefineTime = 0;
+    FrameStats::Id statBgUpsampleTime = 0;
+    FrameStats::Id statMotionTime = 0;
+    FrameStats::Id statPaletteTime = 0;
+    FrameStats::Id statSparkDrawCalls = 0;
+    FrameStats::Id statSparkDrawCallsSaved = 0;
+    FrameStats::Id statMidiEvents = 0;
+    FrameStats::Id statMidiLatency = 0;
     ofTrueTypeFont helpFont;
-    int handDetectFrame = 0;
-    int handDetectInterval = 2;
-    float handDetectScale = 0.5f;
+    float handDetectRateHz = 15.0f;
     float handSparkleSize = 18.0f;
     float handSparkleOpacity = 0.85f;
     std::array<bool, 5> handSparkleFingers = {false, true, true, false, false};
@@ -192,5 +277,9 @@ private:
     float sparkDrag = 0.93f;
     float sparkGravity = 220.0f;
     float sparkJitter = 40.0f;
-    int maxSparkParticles = 2400;
+    // Extra emission at a fingertip whose motion cell reaches
+    // sparkMotionFullScale (mean luma change, 0-1).
+    float sparkMotionEmit = 2.0f;
+    float sparkMotionFullScale = 0.08f;
+    int maxSparkParticles = 50000;
 };